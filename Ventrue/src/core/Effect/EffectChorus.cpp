@@ -1,81 +1,104 @@
 ﻿#include"EffectChorus.h"
+#include <stk\Stk.h>
 
 namespace ventrue
 {
-	EffectChorus::EffectChorus()
+	EffectChorus::EffectChorus(float baseDelay)
 	{
-		leftChannelChorus = new Chorus(2000);
-		rightChannelChorus = new Chorus(2000);
-		outFrames = new StkFrames();
+		baseLength = baseDelay;
+		int maxDelay = (int)(baseDelay * 1.414f) + 2;
+		leftDelayLine = new FloatDelayLine(maxDelay);
+		rightDelayLine = new FloatDelayLine(maxDelay);
 
-		outFrames->resize(1, 2, 0);
+		sampleRate = (float)stk::Stk::sampleRate();
+		SetModFrequency(0.2f);
 	}
 
 	EffectChorus::~EffectChorus()
 	{
-		DEL(leftChannelChorus);
-		DEL(rightChannelChorus);
-		DEL(outFrames);
+		DEL(leftDelayLine);
+		DEL(rightDelayLine);
 	}
 
 	//! Set modulation depth in range 0.0 - 1.0.
 	void EffectChorus::SetModDepth(float depth)
 	{
-		leftChannelChorus->setModDepth(depth);
-		rightChannelChorus->setModDepth(depth);
+		if (depth < 0 || depth > 1)
+			return;
+
+		modDepth = depth;
 	}
 
 	void EffectChorus::SetModFrequency(float frequency)
 	{
-		leftChannelChorus->setModFrequency(frequency);
-		rightChannelChorus->setModFrequency(frequency);
+		modFrequency = frequency;
+		lfoRate = modFrequency / sampleRate;
+	}
+
+	//设置采样率，按新的采样率重新计算lfo相位增量
+	void EffectChorus::SetSampleRate(float sampleRate)
+	{
+		if (sampleRate <= 0)
+			return;
+
+		this->sampleRate = sampleRate;
+		lfoRate = modFrequency / sampleRate;
 	}
 
 	void EffectChorus::SetEffectMix(float mix)
 	{
-		leftChannelChorus->setEffectMix(mix);
-		rightChannelChorus->setEffectMix(mix);
+		effectMix = mix;
 	}
 
 	float EffectChorus::GetEffectMix()
 	{
-		return leftChannelChorus->getEffectMix();
+		return effectMix;
 	}
 
-	void EffectChorus::Tick(float inputL, float inputR)
+	void EffectChorus::Clear()
 	{
-		leftChannelChorus->tick(inputL);
-		rightChannelChorus->tick(inputR);
+		leftDelayLine->Clear();
+		rightDelayLine->Clear();
 	}
 
-	const StkFrames& EffectChorus::LastFrame()
+	//计算一个块的延迟值，块内对lfo线性插值
+	void EffectChorus::ComputeBlockDelays(int count)
 	{
-		const StkFrames& leftFrames = leftChannelChorus->lastFrame();
-		const StkFrames& rightFrames = rightChannelChorus->lastFrame();
+		float len = baseLength * 0.707f;
+		float startDelay = len * (1 + modDepth * (float)sin(2 * M_PI * lfoPhase));
+
+		lfoPhase += lfoRate * count;
+		lfoPhase -= floor(lfoPhase);
+
+		float endDelay = len * (1 + modDepth * (float)sin(2 * M_PI * lfoPhase));
+		float step = (endDelay - startDelay) / count;
+		float maxDelay = leftDelayLine->GetMaxDelay();
 
-		(*outFrames)[0] = leftFrames[0];
-		(*outFrames)[1] = rightFrames[0];
-		return *outFrames;
+		for (int i = 0; i < count; i++)
+		{
+			float delay = startDelay + step * i;
+			delays[i] = delay < maxDelay ? delay : maxDelay;
+		}
 	}
 
-	void EffectChorus::Clear()
+	//处理一个声道的块
+	void EffectChorus::ProcessChannel(FloatDelayLine* delayLine, float* samples, int count)
 	{
-		leftChannelChorus->clear();
-		rightChannelChorus->clear();
-	}
+		delayLine->Process(samples, wetBuf, delays, count);
 
+		float mix = effectMix;
+		for (int i = 0; i < count; i++)
+			samples[i] += mix * (wetBuf[i] - samples[i]);
+	}
 
 	void EffectChorus::EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount)
 	{
-		const StkFrames* frames;
-		for (int i = 0; i < channelSampleCount; i++)
+		for (int i = 0; i < channelSampleCount; i += FloatDelayLine::BLOCK_SIZE)
 		{
-			Tick(leftChannelSamples[i], rightChannelSamples[i]);
-			frames = &LastFrame();
-			leftChannelSamples[i] = (float)(*frames)[0];
-			rightChannelSamples[i] = (float)(*frames)[1];
+			int count = min(FloatDelayLine::BLOCK_SIZE, channelSampleCount - i);
+			ComputeBlockDelays(count);
+			ProcessChannel(leftDelayLine, leftChannelSamples + i, count);
+			ProcessChannel(rightDelayLine, rightChannelSamples + i, count);
 		}
 	}
-
-
 }
@@ -1,16 +1,17 @@
 ﻿#ifndef _EffectChorus_h_
 #define _EffectChorus_h_
 
-#include <stk\Chorus.h>
 #include"VentrueEffect.h"
-using namespace stk;
+#include"FloatDelayLine.h"
 
 namespace ventrue
 {
+	//和声效果(浮点块处理)
+	//每个声道与stk Chorus的第一路输出相同: 延迟为baseDelay * 0.707 * (1 + modDepth * lfo)
 	class DLL_CLASS EffectChorus : public VentrueEffect
 	{
 	public:
-		EffectChorus();
+		EffectChorus(float baseDelay = 2000);
 		~EffectChorus();
 
 		void Clear();
@@ -22,18 +23,38 @@ namespace ventrue
 		//! Set modulation frequency.
 		void SetModFrequency(float frequency);
 
+		//设置采样率，按新的采样率重新计算lfo相位增量
+		void SetSampleRate(float sampleRate);
+
 		void SetEffectMix(float mix);
 
 		void EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount);
 
 	private:
-		void Tick(float inputL, float inputR);
-		const StkFrames& LastFrame();
+		//计算一个块的延迟值，块内对lfo线性插值
+		void ComputeBlockDelays(int count);
+
+		//处理一个声道的块
+		void ProcessChannel(FloatDelayLine* delayLine, float* samples, int count);
 
 	private:
-		Chorus* leftChannelChorus;
-		Chorus* rightChannelChorus;
-		StkFrames* outFrames;
+		FloatDelayLine* leftDelayLine;
+		FloatDelayLine* rightDelayLine;
+
+		float baseLength;
+		float modDepth = 0.05f;
+		float effectMix = 0.5f;
+
+		float modFrequency = 0.2f;
+		float sampleRate = 44100;
+
+		//lfo相位[0, 1)
+		double lfoPhase = 0;
+		//lfo每个样本的相位增量
+		double lfoRate = 0;
+
+		float delays[FloatDelayLine::BLOCK_SIZE];
+		float wetBuf[FloatDelayLine::BLOCK_SIZE];
 	};
 }
 
@@ -141,6 +141,24 @@ namespace ventrue
 	}
 
 
+	//设置增益计算间隔(样本数)
+	void EffectCompressorCmd::SetGainInterval(int sampleCount)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetGainInterval;
+		task->valuei[0] = sampleCount;
+		ventrue->PostTask(task);
+	}
+
+	//设置增益计算间隔(样本数)
+	void EffectCompressorCmd::_SetGainInterval(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectCompressor& compressor = *(EffectCompressor*)(effectTask->effect);
+		compressor.SetGainInterval(effectTask->valuei[0]);
+	}
+
+
 	//计算系数
 	void EffectCompressorCmd::CalculateCoefficients()
 	{
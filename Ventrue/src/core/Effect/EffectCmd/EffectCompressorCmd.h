@@ -40,6 +40,9 @@ namespace ventrue
 		//设置是否自动增益补偿
 		void SetAutoMakeupGain(bool isAuto);
 
+		//设置增益计算间隔(样本数)
+		void SetGainInterval(int sampleCount);
+
 		//计算系数
 		void CalculateCoefficients();
 
@@ -69,6 +72,9 @@ namespace ventrue
 		//设置是否自动增益补偿
 		static void _SetAutoMakeupGain(Task* task);
 
+		//设置增益计算间隔(样本数)
+		static void _SetGainInterval(Task* task);
+
 		//计算系数
 		static void _CalculateCoefficients(Task* task);
 	};
@@ -0,0 +1,66 @@
+﻿#include"EffectFreeVerbCmd.h"
+
+namespace ventrue
+{
+	void EffectFreeVerbCmd::SetRoomSize(float value)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetRoomSize;
+		task->valuef[0] = value;
+		ventrue->PostTask(task);
+	}
+
+	void EffectFreeVerbCmd::_SetRoomSize(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectFreeVerb& reverb = *(EffectFreeVerb*)(effectTask->effect);
+		reverb.SetRoomSize(effectTask->valuef[0]);
+	}
+
+	void EffectFreeVerbCmd::SetWidth(float value)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetWidth;
+		task->valuef[0] = value;
+		ventrue->PostTask(task);
+	}
+
+	void EffectFreeVerbCmd::_SetWidth(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectFreeVerb& reverb = *(EffectFreeVerb*)(effectTask->effect);
+		reverb.SetWidth(effectTask->valuef[0]);
+	}
+
+	void EffectFreeVerbCmd::SetDamping(float value)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetDamping;
+		task->valuef[0] = value;
+		ventrue->PostTask(task);
+	}
+
+	void EffectFreeVerbCmd::_SetDamping(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectFreeVerb& reverb = *(EffectFreeVerb*)(effectTask->effect);
+		reverb.SetDamping(effectTask->valuef[0]);
+	}
+
+
+	void EffectFreeVerbCmd::SetEffectMix(float value)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetEffectMix;
+		task->valuef[0] = value;
+		ventrue->PostTask(task);
+	}
+
+	void EffectFreeVerbCmd::_SetEffectMix(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectFreeVerb& reverb = *(EffectFreeVerb*)(effectTask->effect);
+		reverb.SetEffectMix(effectTask->valuef[0]);
+	}
+
+}
@@ -0,0 +1,41 @@
+﻿#include"EffectParametricEqCmd.h"
+
+namespace ventrue
+{
+	//设置频带是否启用
+	void EffectParametricEqCmd::SetBandEnable(int bandIdx, bool isEnable)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetBandEnable;
+		task->valuei[0] = bandIdx;
+		task->valuebl[0] = isEnable;
+		ventrue->PostTask(task);
+	}
+
+	void EffectParametricEqCmd::_SetBandEnable(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectParametricEq& eq = *(EffectParametricEq*)(effectTask->effect);
+		eq.SetBandEnable(effectTask->valuei[0], effectTask->valuebl[0]);
+	}
+
+	//设置频带参数
+	void EffectParametricEqCmd::SetBand(int bandIdx, float freq, float q, float gainDB)
+	{
+		EffectTask* task = new EffectTask(effect);
+		task->processCallBack = _SetBand;
+		task->valuei[0] = bandIdx;
+		task->valuef[0] = freq;
+		task->valuef[1] = q;
+		task->valuef[2] = gainDB;
+		ventrue->PostTask(task);
+	}
+
+	void EffectParametricEqCmd::_SetBand(Task* task)
+	{
+		EffectTask* effectTask = (EffectTask*)task;
+		EffectParametricEq& eq = *(EffectParametricEq*)(effectTask->effect);
+		eq.SetBand(effectTask->valuei[0], effectTask->valuef[0], effectTask->valuef[1], effectTask->valuef[2]);
+	}
+
+}
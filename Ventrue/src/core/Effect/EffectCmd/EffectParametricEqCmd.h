@@ -0,0 +1,30 @@
+﻿#ifndef _EffectParametricEqCmd_h_
+#define _EffectParametricEqCmd_h_
+
+#include"Effect/EffectParametricEq.h"
+#include"EffectCmd.h"
+
+namespace ventrue
+{
+	class DLL_CLASS EffectParametricEqCmd :public EffectCmd
+	{
+	public:
+		EffectParametricEqCmd(Ventrue* ventrue, VentrueEffect* effect)
+			:EffectCmd(ventrue, effect)
+		{
+
+		}
+
+		//设置频带是否启用
+		void SetBandEnable(int bandIdx, bool isEnable);
+
+		//设置频带参数
+		void SetBand(int bandIdx, float freq, float q, float gainDB);
+
+	private:
+		static void _SetBandEnable(Task* task);
+		static void _SetBand(Task* task);
+	};
+}
+
+#endif
@@ -2,95 +2,222 @@
 
 namespace ventrue
 {
+	//dB值转换为log2值的系数: 20*log10(x) = log2(x) * 20 / log2(10)
+	static const float LOG2_TO_DB = 6.02059991f;
+	static const float DB_TO_LOG2 = 1 / LOG2_TO_DB;
+
+	//快速近似log2(x)，x需大于0
+	static inline float FastLog2(float x)
+	{
+		union { float f; uint32_t i; } vx = { x };
+		union { uint32_t i; float f; } mx = { (vx.i & 0x007FFFFF) | 0x3f000000 };
+		float y = (float)vx.i * 1.1920928955078125e-7f;
+		return y - 124.22551499f - 1.498030302f * mx.f - 1.72587999f / (0.3520887068f + mx.f);
+	}
+
+	//快速近似2^p(与scutils::FastPow2相同，写成没有分支的内联形式)
+	static inline float FastExp2(float p)
+	{
+		float clipp = p < -126 ? -126.0f : p;
+		float offset = clipp < 0 ? 1.0f : 0.0f;
+		int w = (int)clipp;
+		float z = clipp - w + offset;
+		union { uint32_t i; float f; } v;
+		v.i = (uint32_t)(int)((1 << 23) * (clipp + 121.2740575f
+			+ 27.7280233f / (4.84252568f - z)
+			- 1.49012907f * z));
+		return v.f;
+	}
+
 	EffectCompressor::EffectCompressor()
 	{
-		leftCompressor = new Compressor();
-		rightCompressor = new Compressor();
+		CalculateCoefficients();
 	}
 
 	EffectCompressor::~EffectCompressor()
 	{
-		DEL(leftCompressor);
-		DEL(rightCompressor);
 	}
 
 	void EffectCompressor::Clear()
 	{
-		leftCompressor->Clear();
-		rightCompressor->Clear();
+		gs = 0;
+		lastGain = FastExp2(makeupGain * DB_TO_LOG2);
 	}
 
 	//设置采样频率
 	void EffectCompressor::SetSampleFreq(float freq)
 	{
-		leftCompressor->SetSampleFreq(freq);
-		rightCompressor->SetSampleFreq(freq);
+		sampleFreq = freq;
+		CalculateCoefficients();
 	}
 
 	//设置Attack时长
 	void EffectCompressor::SetAttackSec(float sec)
 	{
-		leftCompressor->SetAttackSec(sec);
-		rightCompressor->SetAttackSec(sec);
+		attackSecLen = sec;
+		CalculateCoefficients();
 	}
 
 	//设置Release时长
 	void EffectCompressor::SetReleaseSec(float sec)
 	{
-		leftCompressor->SetReleaseSec(sec);
-		rightCompressor->SetReleaseSec(sec);
+		releaseSecLen = sec;
+		CalculateCoefficients();
 	}
 
 	//设置比值
 	void EffectCompressor::SetRadio(float radio)
 	{
-		leftCompressor->SetRadio(radio);
-		rightCompressor->SetRadio(radio);
+		this->radio = radio;
+		CalculateCoefficients();
 	}
 
 	//设置门限
 	void EffectCompressor::SetThreshold(float threshold)
 	{
-		leftCompressor->SetThreshold(threshold);
-		rightCompressor->SetThreshold(threshold);
+		if (threshold > 0)
+			threshold = 0;
 
+		this->threshold = threshold;
+		CalculateCoefficients();
 	}
 
 	//设置拐点的软硬
 	void EffectCompressor::SetKneeWidth(float width)
 	{
-		leftCompressor->SetKneeWidth(width);
-		rightCompressor->SetKneeWidth(width);
+		kneeWidth = width;
 	}
 
 	//设置增益补偿
 	void EffectCompressor::SetMakeupGain(float gain)
 	{
-		leftCompressor->SetMakeupGain(gain);
-		rightCompressor->SetMakeupGain(gain);
+		makeupGain = gain;
 	}
 
 	//设置是否自动增益补偿
 	void EffectCompressor::SetAutoMakeupGain(bool isAuto)
 	{
-		leftCompressor->SetAutoMakeupGain(isAuto);
-		rightCompressor->SetAutoMakeupGain(isAuto);
+		isAutoMakeupGain = isAuto;
+		CalculateCoefficients();
+	}
+
+	//设置增益计算间隔(样本数)
+	void EffectCompressor::SetGainInterval(int sampleCount)
+	{
+		if (sampleCount < 1) sampleCount = 1;
+		else if (sampleCount > BLOCK_SIZE) sampleCount = BLOCK_SIZE;
+
+		gainInterval = sampleCount;
+		CalculateCoefficients();
 	}
 
 	//计算系数
 	void EffectCompressor::CalculateCoefficients()
 	{
-		leftCompressor->CalculateCoefficients();
-		rightCompressor->CalculateCoefficients();
+		attackCoffe = exp(-logf(9) / (attackSecLen * sampleFreq));
+		releaseCoffe = exp(-logf(9) / (releaseSecLen * sampleFreq));
+
+		//间隔内连续平滑gainInterval次等价于系数的gainInterval次方
+		attackCoffeN = pow(attackCoffe, gainInterval);
+		releaseCoffeN = pow(releaseCoffe, gainInterval);
+
+		if (isAutoMakeupGain)
+		{
+			makeupGain = -threshold + threshold / radio;
+		}
 	}
 
+	//计算增益(dB)
+	//使用选择代替分支，以便循环可以被向量化
+	inline float EffectCompressor::ComputeGain(float xdB)
+	{
+		float halfWidth = kneeWidth * 0.5f;
+		float d = xdB - threshold + halfWidth;
+		float knee = kneeWidth != 0 ? (1 / radio - 1) * d * d / (2 * kneeWidth) : 0;
+		float over = threshold + (xdB - threshold) / radio - xdB;
+
+		float gc = xdB > threshold - halfWidth ? knee : 0;
+		return xdB >= threshold + halfWidth ? over : gc;
+	}
 
 	void EffectCompressor::EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount)
 	{
-		for (int i = 0; i < channelSampleCount; i++)
+		for (int i = 0; i < channelSampleCount; i += BLOCK_SIZE)
+		{
+			int count = min(BLOCK_SIZE, channelSampleCount - i);
+			if (gainInterval == 1)
+				ProcessSampleRate(leftChannelSamples + i, rightChannelSamples + i, count);
+			else
+				ProcessControlRate(leftChannelSamples + i, rightChannelSamples + i, count);
+		}
+	}
+
+	//逐样本计算增益
+	void EffectCompressor::ProcessSampleRate(float* left, float* right, int count)
+	{
+		//立体声联动电平检测，并计算增益
+		for (int i = 0; i < count; i++)
+		{
+			float x = max(abs(left[i]), abs(right[i]));
+			float xdB = max(FastLog2(x) * LOG2_TO_DB, -140.0f);
+			buf[i] = ComputeGain(xdB);
+		}
+
+		//增益平滑
+		float g = gs;
+		for (int i = 0; i < count; i++)
+		{
+			float gc = buf[i];
+			float k = gc < g ? attackCoffe : releaseCoffe;
+			g = gc + k * (g - gc);
+			buf[i] = g;
+		}
+		gs = g;
+
+		//dB增益转换为线性增益，并应用到两个声道
+		for (int i = 0; i < count; i++)
+		{
+			float glin = FastExp2((makeupGain + buf[i]) * DB_TO_LOG2);
+			left[i] *= glin;
+			right[i] *= glin;
+		}
+
+		lastGain = FastExp2((makeupGain + gs) * DB_TO_LOG2);
+	}
+
+	//以控制速率计算增益
+	void EffectCompressor::ProcessControlRate(float* left, float* right, int count)
+	{
+		for (int i = 0; i < count; i += gainInterval)
 		{
-			leftChannelSamples[i] = leftCompressor->Tick(leftChannelSamples[i]);
-			rightChannelSamples[i] = rightCompressor->Tick(rightChannelSamples[i]);
+			int n = min(gainInterval, count - i);
+			float* l = left + i;
+			float* r = right + i;
+
+			//间隔内的峰值电平
+			float x = 0;
+			for (int j = 0; j < n; j++)
+				x = max(x, max(abs(l[j]), abs(r[j])));
+
+			float xdB = max(FastLog2(x) * LOG2_TO_DB, -140.0f);
+			float gc = ComputeGain(xdB);
+
+			float k;
+			if (n == gainInterval) k = gc < gs ? attackCoffeN : releaseCoffeN;
+			else k = pow(gc < gs ? attackCoffe : releaseCoffe, n);
+			gs = gc + k * (gs - gc);
+
+			//线性增益在间隔内插值
+			float gain = FastExp2((makeupGain + gs) * DB_TO_LOG2);
+			float step = (gain - lastGain) / n;
+			for (int j = 0; j < n; j++)
+			{
+				float glin = lastGain + step * (j + 1);
+				l[j] *= glin;
+				r[j] *= glin;
+			}
+
+			lastGain = gain;
 		}
 	}
 }
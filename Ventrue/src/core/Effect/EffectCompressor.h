@@ -1,12 +1,19 @@
 ﻿#ifndef _EffectCompressor_h_
 #define _EffectCompressor_h_
 
-#include "dsignal/Compressor.h"
 #include"VentrueEffect.h"
-using namespace dsignal;
 
 namespace ventrue
 {
+	/*
+	* 音频压缩器(浮点块处理)
+	* 算法与dsignal::Compressor相同(参见dsignal/Compressor.h中的说明)，区别在于:
+	* 1.左右声道使用同一个检测电平(取两个声道的最大绝对值)，计算出的增益同时作用于两个声道
+	* 2.dB值与线性值之间的转换使用快速近似的log2/exp2
+	* 3.按块处理: 电平检测，增益计算，增益应用都是没有分支的循环，
+	*   只有增益平滑的一阶递归滤波器是逐样本的
+	* 4.可以设置增益计算间隔，以控制速率计算增益，间隔内的线性增益使用线性插值
+	*/
 	class DLL_CLASS EffectCompressor : public VentrueEffect
 	{
 	public:
@@ -39,14 +46,67 @@ namespace ventrue
 		//设置是否自动增益补偿
 		void SetAutoMakeupGain(bool isAuto);
 
+		//设置增益计算间隔(样本数)
+		//为1时逐样本计算增益，大于1时每个间隔计算一次增益，间隔内线性插值
+		void SetGainInterval(int sampleCount);
+
 		//计算系数
 		void CalculateCoefficients();
 
 		void EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount);
 
 	private:
-		Compressor* leftCompressor;
-		Compressor* rightCompressor;
+		//计算增益(dB)
+		inline float ComputeGain(float xdB);
+
+		//逐样本计算增益
+		void ProcessSampleRate(float* left, float* right, int count);
+
+		//以控制速率计算增益
+		void ProcessControlRate(float* left, float* right, int count);
+
+	private:
+		//每次处理的最大样本数量
+		static const int BLOCK_SIZE = 256;
+
+		//采样频率
+		float sampleFreq = 44100;
+
+		//启动时长
+		float attackSecLen = 0.002f;
+
+		//释放时长
+		float releaseSecLen = 0.01f;
+
+		//门限
+		float threshold = -10;
+
+		//拐点宽度
+		float kneeWidth = 3;
+
+		//压缩比
+		float radio = 6;
+
+		//是否自动增益补偿
+		bool isAutoMakeupGain = false;
+		//输出增益补偿
+		float makeupGain = 0;
+
+		//增益计算间隔
+		int gainInterval = 1;
+
+		float attackCoffe = 0;
+		float releaseCoffe = 0;
+		//控制速率下的平滑系数
+		float attackCoffeN = 0;
+		float releaseCoffeN = 0;
+
+		//平滑后的增益(dB)
+		float gs = 0;
+		//上一次应用的线性增益
+		float lastGain = 1;
+
+		float buf[BLOCK_SIZE];
 	};
 
 }
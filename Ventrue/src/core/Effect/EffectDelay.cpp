@@ -4,8 +4,8 @@ namespace ventrue
 {
 	EffectDelay::EffectDelay()
 	{
-		delayLeftChannel = new DelayL();
-		delayRightChannel = new DelayL();
+		delayLeftChannel = new FloatDelayLine();
+		delayRightChannel = new FloatDelayLine();
 
 		SetDelay(221);
 	}
@@ -18,25 +18,35 @@ namespace ventrue
 
 	void EffectDelay::SetDelay(float delay)
 	{
-		delayLeftChannel->setDelay(delay);
-		delayRightChannel->setDelay(delay);
+		//与stk DelayL相同，超出范围的值被忽略
+		if (delay < 0 || delay > delayLeftChannel->GetMaxDelay())
+			return;
+
+		this->delay = delay;
 	}
 
+	//延迟一个声道的样本
+	void EffectDelay::ProcessChannel(FloatDelayLine* delayLine, float* samples, int channelSampleCount)
+	{
+		for (int i = 0; i < channelSampleCount; i += FloatDelayLine::BLOCK_SIZE)
+		{
+			int count = min(FloatDelayLine::BLOCK_SIZE, channelSampleCount - i);
+			delayLine->Process(samples + i, outBuf, delay, count);
+			memcpy(samples + i, outBuf, count * sizeof(float));
+		}
+	}
 
 	void EffectDelay::EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount)
 	{
-		for (int i = 0; i < channelSampleCount; i++)
-		{
-			if (delayChannel == DelayChannel::LeftChannel) {
-				leftChannelSamples[i] = delayLeftChannel->tick(leftChannelSamples[i]);
-			}
-			else if (delayChannel == DelayChannel::RightChannel) {
-				rightChannelSamples[i] = delayRightChannel->tick(rightChannelSamples[i]);
-			}
-			else {
-				leftChannelSamples[i] = delayLeftChannel->tick(leftChannelSamples[i]);
-				rightChannelSamples[i] = delayRightChannel->tick(rightChannelSamples[i]);
-			}
+		if (delayChannel == DelayChannel::LeftChannel) {
+			ProcessChannel(delayLeftChannel, leftChannelSamples, channelSampleCount);
+		}
+		else if (delayChannel == DelayChannel::RightChannel) {
+			ProcessChannel(delayRightChannel, rightChannelSamples, channelSampleCount);
+		}
+		else {
+			ProcessChannel(delayLeftChannel, leftChannelSamples, channelSampleCount);
+			ProcessChannel(delayRightChannel, rightChannelSamples, channelSampleCount);
 		}
 	}
 }
@@ -1,9 +1,8 @@
 ﻿#ifndef _EffectDelay_h_
 #define _EffectDelay_h_
 
-#include <stk\DelayL.h>
 #include"VentrueEffect.h"
-using namespace stk;
+#include"FloatDelayLine.h"
 
 namespace ventrue
 {
@@ -14,6 +13,7 @@ namespace ventrue
 		AllChannel
 	};
 
+	//延迟效果(浮点块处理)
 	class DLL_CLASS EffectDelay : public VentrueEffect
 	{
 	public:
@@ -30,10 +30,16 @@ namespace ventrue
 	private:
 		void EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount);
 
+		//延迟一个声道的样本
+		void ProcessChannel(FloatDelayLine* delayLine, float* samples, int count);
+
 	private:
-		DelayL* delayLeftChannel;
-		DelayL* delayRightChannel;
+		FloatDelayLine* delayLeftChannel;
+		FloatDelayLine* delayRightChannel;
 		DelayChannel delayChannel = DelayChannel::RightChannel;
+		float delay = 0;
+
+		float outBuf[FloatDelayLine::BLOCK_SIZE];
 	};
 }
 #endif
@@ -5,6 +5,8 @@ namespace ventrue
 	EffectEqualizer::EffectEqualizer()
 	{
 		eq = new GraphEqualizer();
+		for (int i = 0; i < eq->GetBandCount(); i++)
+			UpdateBand(i);
 	}
 
 	EffectEqualizer::~EffectEqualizer()
@@ -18,18 +20,52 @@ namespace ventrue
 		return eq->GetFilters();
 	}
 
+	void EffectEqualizer::Clear()
+	{
+		for (int i = 0; i < eq->GetBandCount(); i++)
+			bands[i].Clear();
+	}
+
+	void EffectEqualizer::SetSampleRate(float sampleRate)
+	{
+		eq->SetSampleRate(sampleRate);
+		for (int i = 0; i < eq->GetBandCount(); i++)
+			UpdateBand(i);
+	}
 
 	void EffectEqualizer::SetFreqBandGain(int bandIdx, float gainDB)
 	{
+		if (bandIdx < 0 || bandIdx >= eq->GetBandCount() ||
+			eq->GetFreqBandGain(bandIdx) == gainDB)
+			return;
+
 		eq->SetFreqBandGain(bandIdx, gainDB);
+		UpdateBand(bandIdx);
+	}
+
+	//从GraphEqualizer中更新频带的浮点系数
+	void EffectEqualizer::UpdateBand(int bandIdx)
+	{
+		double coeff[6];
+		eq->GetBandCoefficient(bandIdx, coeff);
+
+		bands[bandIdx].SetCoefficient(coeff);
+		bands[bandIdx].SetActive(eq->GetFreqBandGain(bandIdx) != 0);
 	}
 
 	void EffectEqualizer::EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount)
 	{
-		for (int i = 0; i < channelSampleCount; i++)
+		EqBiquad* activeBands[MAX_EQ_BIQUAD_COUNT];
+		int activeCount = 0;
+		for (int i = 0; i < eq->GetBandCount(); i++)
 		{
-			leftChannelSamples[i] = eq->Filtering(leftChannelSamples[i]);
-			rightChannelSamples[i] = eq->Filtering(rightChannelSamples[i]);
+			if (bands[i].isActive)
+				activeBands[activeCount++] = &bands[i];
 		}
+
+		if (activeCount == 0)
+			return;
+
+		ProcessEqBiquads(activeBands, activeCount, leftChannelSamples, rightChannelSamples, channelSampleCount);
 	}
 }
@@ -3,12 +3,16 @@
 
 #include "dsignal/GraphEqualizer.h"
 #include"VentrueEffect.h"
+#include"EqBiquad.h"
 using namespace dsignal;
 
 namespace ventrue
 {
 	/**
 	* 均衡器
+	* 频带的参数和系数由GraphEqualizer计算(只在参数改变时重新计算)，
+	* 处理时使用浮点转置直接II型级联，左右声道在同一个SIMD寄存器中并行处理，
+	* 增益为0db的频带自动跳过
 	*/
 	class DLL_CLASS EffectEqualizer : public VentrueEffect
 	{
@@ -16,13 +20,19 @@ namespace ventrue
 		EffectEqualizer();
 		~EffectEqualizer();
 
+		void Clear();
 		void SetSampleRate(float sampleRate);
 		void SetFreqBandGain(int bandIdx, float gainDB);
 		void EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount);
 		vector<dsignal::Filter*> GetFilters();
 
+	private:
+		//从GraphEqualizer中更新频带的浮点系数
+		void UpdateBand(int bandIdx);
+
 	private:
 		GraphEqualizer* eq;
+		EqBiquad bands[31];
 	};
 }
 
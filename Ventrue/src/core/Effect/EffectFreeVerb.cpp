@@ -0,0 +1,292 @@
+﻿#include"EffectFreeVerb.h"
+#include <stk\Stk.h>
+
+namespace ventrue
+{
+	static const float FIXED_GAIN = 0.015f;
+	static const float SCALE_WET = 3;
+	static const float SCALE_DRY = 2;
+	static const float SCALE_DAMP = 0.4f;
+	static const float SCALE_ROOM = 0.28f;
+	static const float OFFSET_ROOM = 0.7f;
+	static const float ALLPASS_FEEDBACK = 0.5f;
+	static const int STEREO_SPREAD = 23;
+
+	//44100Hz时的延迟长度
+	static const int COMB_LENGTHS[] = { 1617, 1557, 1491, 1422, 1356, 1277, 1188, 1116 };
+	static const int ALLPASS_LENGTHS[] = { 225, 556, 441, 341 };
+
+	EffectFreeVerb::EffectFreeVerb()
+	{
+		roomSizeMem = 0.75f * SCALE_ROOM + OFFSET_ROOM;
+		dampMem = 0.25f * SCALE_DAMP;
+
+		SetSampleRate((float)stk::Stk::sampleRate());
+		Update();
+	}
+
+	EffectFreeVerb::~EffectFreeVerb()
+	{
+		FreeDelayLines();
+	}
+
+	//设置采样率，按采样率重新分配并清空延迟线
+	void EffectFreeVerb::SetSampleRate(float sampleRate)
+	{
+		if (sampleRate <= 0 || sampleRate == this->sampleRate)
+			return;
+
+		this->sampleRate = sampleRate;
+		FreeDelayLines();
+
+		double fsScale = sampleRate / 44100.0;
+		for (int i = 0; i < COMB_COUNT; i++)
+		{
+			int len = (int)floor(fsScale * COMB_LENGTHS[i]);
+			InitDelayLine(combL[i], len);
+			InitDelayLine(combR[i], len + STEREO_SPREAD);
+		}
+
+		for (int i = 0; i < ALLPASS_COUNT; i++)
+		{
+			int len = (int)floor(fsScale * ALLPASS_LENGTHS[i]);
+			InitDelayLine(allpassL[i], len);
+			InitDelayLine(allpassR[i], len + STEREO_SPREAD);
+		}
+	}
+
+	void EffectFreeVerb::FreeDelayLines()
+	{
+		for (int i = 0; i < COMB_COUNT; i++)
+		{
+			free(combL[i].buf);
+			free(combR[i].buf);
+			combL[i].buf = combR[i].buf = nullptr;
+		}
+
+		for (int i = 0; i < ALLPASS_COUNT; i++)
+		{
+			free(allpassL[i].buf);
+			free(allpassR[i].buf);
+			allpassL[i].buf = allpassR[i].buf = nullptr;
+		}
+	}
+
+	void EffectFreeVerb::InitDelayLine(DelayLine& line, int size)
+	{
+		if (size < 1)
+			size = 1;
+
+		line.size = size;
+		line.pos = 0;
+		line.filterStore = 0;
+		line.buf = (float*)calloc(size, sizeof(float));
+	}
+
+	//! Set the room size (comb filter feedback gain) parameter [0,1].
+	void EffectFreeVerb::SetRoomSize(float value)
+	{
+		roomSizeMem = value * SCALE_ROOM + OFFSET_ROOM;
+		Update();
+	}
+
+	//! Set the width (left-right mixing) parameter [0,1].
+	void EffectFreeVerb::SetWidth(float value)
+	{
+		width = value;
+		Update();
+	}
+
+	//! Set the damping parameter [0=low damping, 1=higher damping].
+	void EffectFreeVerb::SetDamping(float value)
+	{
+		dampMem = value * SCALE_DAMP;
+		Update();
+	}
+
+	//! Set the effect mix [0 = mostly dry, 1 = mostly wet].
+	void EffectFreeVerb::SetEffectMix(float mix)
+	{
+		effectMix = mix;
+		Update();
+	}
+
+	float EffectFreeVerb::GetEffectMix()
+	{
+		return effectMix;
+	}
+
+	//! Set the mode [frozen = 1, unfrozen = 0].
+	void EffectFreeVerb::SetMode(bool isFrozen)
+	{
+		this->isFrozen = isFrozen;
+		Update();
+	}
+
+	//与stk FreeVerb::update()的计算相同
+	void EffectFreeVerb::Update()
+	{
+		float wet = SCALE_WET * effectMix;
+		dry = SCALE_DRY * (1 - effectMix);
+
+		wet /= (wet + dry);
+		dry /= (wet + dry);
+
+		wet1 = wet * (width / 2 + 0.5f);
+		wet2 = wet * (1 - width) / 2;
+
+		if (isFrozen)
+		{
+			roomSize = 1;
+			damp = 0;
+			gain = 0;
+		}
+		else
+		{
+			roomSize = roomSizeMem;
+			damp = dampMem;
+			gain = FIXED_GAIN;
+		}
+	}
+
+	void EffectFreeVerb::Clear()
+	{
+		for (int i = 0; i < COMB_COUNT; i++)
+		{
+			memset(combL[i].buf, 0, combL[i].size * sizeof(float));
+			memset(combR[i].buf, 0, combR[i].size * sizeof(float));
+			combL[i].filterStore = 0;
+			combR[i].filterStore = 0;
+		}
+
+		for (int i = 0; i < ALLPASS_COUNT; i++)
+		{
+			memset(allpassL[i].buf, 0, allpassL[i].size * sizeof(float));
+			memset(allpassR[i].buf, 0, allpassR[i].size * sizeof(float));
+		}
+	}
+
+	void EffectFreeVerb::EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount)
+	{
+		for (int i = 0; i < channelSampleCount; i += BLOCK_SIZE)
+		{
+			int count = min(BLOCK_SIZE, channelSampleCount - i);
+			ProcessBlock(leftChannelSamples + i, rightChannelSamples + i, count);
+		}
+	}
+
+	void EffectFreeVerb::ProcessBlock(float* leftChannelSamples, float* rightChannelSamples, int count)
+	{
+		float* input = inputBuf;
+		float* outL = outBufL;
+		float* outR = outBufR;
+
+		for (int i = 0; i < count; i++)
+		{
+			input[i] = (leftChannelSamples[i] + rightChannelSamples[i]) * gain;
+		}
+
+		//并联的梳状滤波器
+		ProcessCombs(combL, input, outL, count, roomSize, damp);
+		ProcessCombs(combR, input, outR, count, roomSize, damp);
+
+		//串联的全通滤波器
+		for (int i = 0; i < ALLPASS_COUNT; i++)
+		{
+			ProcessAllpass(allpassL[i], outL, count);
+			ProcessAllpass(allpassR[i], outR, count);
+		}
+
+		//混合输出
+		float w1 = wet1, w2 = wet2, d = dry;
+		for (int i = 0; i < count; i++)
+		{
+			float l = outL[i] * w1 + outR[i] * w2 + leftChannelSamples[i] * d;
+			float r = outR[i] * w1 + outL[i] * w2 + rightChannelSamples[i] * d;
+			leftChannelSamples[i] = l;
+			rightChannelSamples[i] = r;
+		}
+	}
+
+	//并联的低通反馈梳状滤波，结果写入output
+	//每个梳状滤波器延迟线的读写位置相同，分段处理时每段不跨越任何一个环形缓存的末尾，
+	//段内8个相互独立的滤波器在同一循环中处理，减少低通滤波递归带来的等待
+	void EffectFreeVerb::ProcessCombs(DelayLine* combs, const float* input, float* output, int count, float feedback, float damp)
+	{
+		float damp1 = damp;
+		float damp2 = 1 - damp;
+		float* bufs[COMB_COUNT];
+		float stores[COMB_COUNT];
+
+		for (int i = 0; i < count;)
+		{
+			int len = count - i;
+			for (int k = 0; k < COMB_COUNT; k++)
+			{
+				len = min(len, combs[k].size - combs[k].pos);
+				bufs[k] = combs[k].buf + combs[k].pos;
+				stores[k] = combs[k].filterStore;
+			}
+
+			const float* in = input + i;
+			float* out = output + i;
+			for (int j = 0; j < len; j++)
+			{
+				float x = in[j];
+				float sum = 0;
+				for (int k = 0; k < COMB_COUNT; k++)
+				{
+					stores[k] = bufs[k][j] * damp2 + stores[k] * damp1;
+					float yn = x + stores[k] * feedback;
+					bufs[k][j] = yn;
+					sum += yn;
+				}
+				out[j] = sum;
+			}
+
+			for (int k = 0; k < COMB_COUNT; k++)
+			{
+				//防止非规格化浮点数
+				if (fabsf(stores[k]) < 1e-20f)
+					stores[k] = 0;
+
+				combs[k].filterStore = stores[k];
+				combs[k].pos += len;
+				if (combs[k].pos >= combs[k].size)
+					combs[k].pos = 0;
+			}
+
+			i += len;
+		}
+	}
+
+	//全通滤波(在samples上原地处理)
+	//每个样本只依赖延迟线中的旧值，内层循环可以向量化
+	void EffectFreeVerb::ProcessAllpass(DelayLine& allpass, float* samples, int count)
+	{
+		const float g = ALLPASS_FEEDBACK;
+		int pos = allpass.pos;
+
+		for (int i = 0; i < count;)
+		{
+			int len = min(count - i, allpass.size - pos);
+			float* buf = allpass.buf + pos;
+			float* x = samples + i;
+
+			for (int j = 0; j < len; j++)
+			{
+				float vm = buf[j];
+				float vn = x[j] + g * vm;
+				buf[j] = vn;
+				x[j] = (1 + g) * vm - vn;
+			}
+
+			i += len;
+			pos += len;
+			if (pos >= allpass.size)
+				pos = 0;
+		}
+
+		allpass.pos = pos;
+	}
+}
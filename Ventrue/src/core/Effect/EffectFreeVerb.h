@@ -0,0 +1,93 @@
+﻿#ifndef _EffectFreeVerb_h_
+#define _EffectFreeVerb_h_
+
+#include"VentrueEffect.h"
+
+namespace ventrue
+{
+	//Freeverb混响的浮点块处理实现
+	//与stk FreeVerb的结构和参数相同(每声道8个梳状滤波器和4个全通滤波器)，
+	//按块处理样本，没有逐样本的虚函数调用
+	class DLL_CLASS EffectFreeVerb : public VentrueEffect
+	{
+	public:
+		EffectFreeVerb();
+		~EffectFreeVerb();
+
+		void Clear();
+		float GetEffectMix();
+
+		//设置采样率，按采样率重新分配并清空延迟线
+		void SetSampleRate(float sampleRate);
+
+		//! Set the room size (comb filter feedback gain) parameter [0,1].
+		void SetRoomSize(float value);
+
+		//! Set the width (left-right mixing) parameter [0,1].
+		void SetWidth(float value);
+
+		//! Set the damping parameter [0=low damping, 1=higher damping].
+		void SetDamping(float value);
+
+		//! Set the effect mix [0 = mostly dry, 1 = mostly wet].
+		void SetEffectMix(float mix);
+
+		//! Set the mode [frozen = 1, unfrozen = 0].
+		void SetMode(bool isFrozen);
+
+		void EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount);
+
+	private:
+		static const int COMB_COUNT = 8;
+		static const int ALLPASS_COUNT = 4;
+		static const int BLOCK_SIZE = 256;
+
+		//环形缓存实现的延迟线
+		struct DelayLine
+		{
+			float* buf = nullptr;
+			int size = 0;
+			int pos = 0;
+			//梳状滤波器中低通滤波的状态
+			float filterStore = 0;
+		};
+
+		void Update();
+		void ProcessBlock(float* leftChannelSamples, float* rightChannelSamples, int count);
+
+		//并联的低通反馈梳状滤波，结果写入output
+		static void ProcessCombs(DelayLine* combs, const float* input, float* output, int count, float feedback, float damp);
+
+		//全通滤波(在samples上原地处理)
+		static void ProcessAllpass(DelayLine& allpass, float* samples, int count);
+
+		static void InitDelayLine(DelayLine& line, int size);
+		void FreeDelayLines();
+
+	private:
+		DelayLine combL[COMB_COUNT];
+		DelayLine combR[COMB_COUNT];
+		DelayLine allpassL[ALLPASS_COUNT];
+		DelayLine allpassR[ALLPASS_COUNT];
+
+		float sampleRate = 0;
+		float effectMix = 0.75f;
+		float roomSizeMem;
+		float dampMem;
+		float width = 1;
+		bool isFrozen = false;
+
+		float roomSize = 0;
+		float damp = 0;
+		float gain = 0;
+		float wet1 = 0;
+		float wet2 = 0;
+		float dry = 0;
+
+		float inputBuf[BLOCK_SIZE];
+		float outBufL[BLOCK_SIZE];
+		float outBufR[BLOCK_SIZE];
+	};
+}
+
+#endif
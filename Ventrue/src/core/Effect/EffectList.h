@@ -4,7 +4,9 @@
 #include"scutils/Utils.h"
 #include "VentrueEffect.h"
 #include"EffectEqualizer.h"
+#include"EffectParametricEq.h"
 #include"EffectReverb.h"
+#include"EffectFreeVerb.h"
 #include"EffectChorus.h"
 #include"EffectDelay.h"
 
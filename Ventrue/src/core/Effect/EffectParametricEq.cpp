@@ -0,0 +1,95 @@
+﻿#include"EffectParametricEq.h"
+
+namespace ventrue
+{
+	EffectParametricEq::EffectParametricEq()
+	{
+		eq = new ParameterEqualizer();
+		for (int i = 0; i < eq->GetFilterCount(); i++)
+		{
+			eq->Enable(i, false);
+			UpdateBand(i);
+		}
+	}
+
+	EffectParametricEq::~EffectParametricEq()
+	{
+		DEL(eq);
+	}
+
+	vector<dsignal::Filter*> EffectParametricEq::GetFilters()
+	{
+		vector<dsignal::Filter*> filters;
+		for (int i = 0; i < eq->GetFilterCount(); i++)
+			filters.push_back(eq->GetFilter(i));
+
+		return filters;
+	}
+
+	void EffectParametricEq::Clear()
+	{
+		for (int i = 0; i < eq->GetFilterCount(); i++)
+			bands[i].Clear();
+	}
+
+	void EffectParametricEq::SetSampleRate(float sampleRate)
+	{
+		eq->SetSampleRate(sampleRate);
+		for (int i = 0; i < eq->GetFilterCount(); i++)
+			UpdateBand(i);
+	}
+
+	//设置频带是否启用
+	void EffectParametricEq::SetBandEnable(int bandIdx, bool isEnable)
+	{
+		if (bandIdx < 0 || bandIdx >= eq->GetFilterCount())
+			return;
+
+		eq->Enable(bandIdx, isEnable);
+		UpdateBand(bandIdx);
+	}
+
+	//设置频带参数
+	void EffectParametricEq::SetBand(int bandIdx, float freq, float q, float gainDB)
+	{
+		if (bandIdx < 0 || bandIdx >= eq->GetFilterCount())
+			return;
+
+		eq->SetFilter(bandIdx, freq, q, gainDB);
+		UpdateBand(bandIdx);
+	}
+
+	//从ParameterEqualizer中更新频带的浮点系数
+	void EffectParametricEq::UpdateBand(int bandIdx)
+	{
+		CascadeBiquad* filter = eq->GetFilter(bandIdx);
+
+		double coeff[6];
+		filter->GetNumAndDenCoefficient(coeff);
+		bands[bandIdx].SetCoefficient(coeff);
+
+		//增益为0db的尖峰和架型滤波器不改变信号
+		bool isFlat = filter->gainDB == 0 &&
+			(filter->rbjFilterType == RBJFilterType::PeakingEQ ||
+				filter->rbjFilterType == RBJFilterType::LowShelf ||
+				filter->rbjFilterType == RBJFilterType::HighShelf);
+
+		bands[bandIdx].SetActive(eq->IsEnable(bandIdx) && !isFlat);
+	}
+
+	void EffectParametricEq::EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount)
+	{
+		EqBiquad* activeBands[9];
+		int activeCount = 0;
+		for (int i = 0; i < eq->GetFilterCount(); i++)
+		{
+			if (bands[i].isActive)
+				activeBands[activeCount++] = &bands[i];
+		}
+
+		if (activeCount == 0)
+			return;
+
+		ProcessEqBiquads(activeBands, activeCount, leftChannelSamples, rightChannelSamples, channelSampleCount);
+	}
+}
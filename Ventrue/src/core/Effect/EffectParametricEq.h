@@ -0,0 +1,54 @@
+﻿#ifndef _EffectParametricEq_h_
+#define _EffectParametricEq_h_
+
+#include "dsignal/ParameterEqualizer.h"
+#include"VentrueEffect.h"
+#include"EqBiquad.h"
+using namespace dsignal;
+
+namespace ventrue
+{
+	/**
+	* 参数均衡器
+	* 频带: 0:高通, 1:低架, 2-6:尖峰, 7:高架, 8:低通
+	* 频带的系数由ParameterEqualizer计算(只在参数改变时重新计算)，
+	* 处理时只有启用且起作用的频带参与浮点级联处理，
+	* 增益为0db的尖峰和架型频带自动跳过
+	* 默认所有频带都不启用
+	*/
+	class DLL_CLASS EffectParametricEq : public VentrueEffect
+	{
+	public:
+		EffectParametricEq();
+		~EffectParametricEq();
+
+		void Clear();
+		void SetSampleRate(float sampleRate);
+
+		//设置频带是否启用
+		void SetBandEnable(int bandIdx, bool isEnable);
+
+		//设置频带参数
+		//freq:频率(单位:HZ), q:Q值, gainDB:增益(单位:db，仅用于尖峰和架型频带)
+		void SetBand(int bandIdx, float freq, float q, float gainDB);
+
+		int GetBandCount()
+		{
+			return eq->GetFilterCount();
+		}
+
+		vector<dsignal::Filter*> GetFilters();
+
+		void EffectProcess(float* leftChannelSamples, float* rightChannelSamples, int channelSampleCount);
+
+	private:
+		//从ParameterEqualizer中更新频带的浮点系数
+		void UpdateBand(int bandIdx);
+
+	private:
+		ParameterEqualizer* eq;
+		EqBiquad bands[9];
+	};
+}
+
+#endif
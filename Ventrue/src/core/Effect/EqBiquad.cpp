@@ -0,0 +1,150 @@
+﻿#include"EqBiquad.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EQ_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EQ_USE_NEON
+#endif
+
+namespace ventrue
+{
+	//设置系数(b0, b1, b2, a0, a1, a2)，并按a0归一化
+	void EqBiquad::SetCoefficient(double coeff[6])
+	{
+		b0 = (float)(coeff[0] / coeff[3]);
+		b1 = (float)(coeff[1] / coeff[3]);
+		b2 = (float)(coeff[2] / coeff[3]);
+		a1 = (float)(coeff[4] / coeff[3]);
+		a2 = (float)(coeff[5] / coeff[3]);
+	}
+
+	//设置是否参与处理，重新启用时从零状态开始
+	void EqBiquad::SetActive(bool isActive)
+	{
+		if (isActive && !this->isActive)
+			Clear();
+
+		this->isActive = isActive;
+	}
+
+	void EqBiquad::Clear()
+	{
+		z1[0] = z1[1] = 0;
+		z2[0] = z2[1] = 0;
+	}
+
+	//左右声道依次通过级联的频带
+	void ProcessEqBiquads(EqBiquad** bands, int bandCount, float* left, float* right, int count)
+	{
+		if (bandCount > MAX_EQ_BIQUAD_COUNT)
+			bandCount = MAX_EQ_BIQUAD_COUNT;
+
+		//左右声道的样本放入同一个寄存器的两个通道，
+		//每个样本依次通过所有启用的频带，状态在整个块内保存在寄存器中
+		//y = b0*x + z1; z1 = b1*x - a1*y + z2; z2 = b2*x - a2*y
+#if defined(EQ_USE_SSE2)
+		__m128 b0[MAX_EQ_BIQUAD_COUNT], b1[MAX_EQ_BIQUAD_COUNT], b2[MAX_EQ_BIQUAD_COUNT];
+		__m128 a1[MAX_EQ_BIQUAD_COUNT], a2[MAX_EQ_BIQUAD_COUNT];
+		__m128 z1[MAX_EQ_BIQUAD_COUNT], z2[MAX_EQ_BIQUAD_COUNT];
+		for (int j = 0; j < bandCount; j++)
+		{
+			EqBiquad& band = *bands[j];
+			b0[j] = _mm_set1_ps(band.b0);
+			b1[j] = _mm_set1_ps(band.b1);
+			b2[j] = _mm_set1_ps(band.b2);
+			a1[j] = _mm_set1_ps(band.a1);
+			a2[j] = _mm_set1_ps(band.a2);
+			z1[j] = _mm_setr_ps(band.z1[0], band.z1[1], 0, 0);
+			z2[j] = _mm_setr_ps(band.z2[0], band.z2[1], 0, 0);
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			__m128 x = _mm_setr_ps(left[i], right[i], 0, 0);
+			for (int j = 0; j < bandCount; j++)
+			{
+				__m128 y = _mm_add_ps(_mm_mul_ps(b0[j], x), z1[j]);
+				z1[j] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[j], x), _mm_mul_ps(a1[j], y)), z2[j]);
+				z2[j] = _mm_sub_ps(_mm_mul_ps(b2[j], x), _mm_mul_ps(a2[j], y));
+				x = y;
+			}
+
+			left[i] = _mm_cvtss_f32(x);
+			right[i] = _mm_cvtss_f32(_mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1)));
+		}
+
+		float state[4];
+		for (int j = 0; j < bandCount; j++)
+		{
+			EqBiquad& band = *bands[j];
+			_mm_storeu_ps(state, z1[j]);
+			band.z1[0] = state[0];
+			band.z1[1] = state[1];
+			_mm_storeu_ps(state, z2[j]);
+			band.z2[0] = state[0];
+			band.z2[1] = state[1];
+		}
+
+#elif defined(EQ_USE_NEON)
+		float32x2_t b0[MAX_EQ_BIQUAD_COUNT], b1[MAX_EQ_BIQUAD_COUNT], b2[MAX_EQ_BIQUAD_COUNT];
+		float32x2_t a1[MAX_EQ_BIQUAD_COUNT], a2[MAX_EQ_BIQUAD_COUNT];
+		float32x2_t z1[MAX_EQ_BIQUAD_COUNT], z2[MAX_EQ_BIQUAD_COUNT];
+		for (int j = 0; j < bandCount; j++)
+		{
+			EqBiquad& band = *bands[j];
+			b0[j] = vdup_n_f32(band.b0);
+			b1[j] = vdup_n_f32(band.b1);
+			b2[j] = vdup_n_f32(band.b2);
+			a1[j] = vdup_n_f32(band.a1);
+			a2[j] = vdup_n_f32(band.a2);
+			z1[j] = vld1_f32(band.z1);
+			z2[j] = vld1_f32(band.z2);
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			float32x2_t x = vset_lane_f32(right[i], vdup_n_f32(left[i]), 1);
+			for (int j = 0; j < bandCount; j++)
+			{
+				float32x2_t y = vmla_f32(z1[j], b0[j], x);
+				z1[j] = vmls_f32(vmla_f32(z2[j], b1[j], x), a1[j], y);
+				z2[j] = vmls_f32(vmul_f32(b2[j], x), a2[j], y);
+				x = y;
+			}
+
+			left[i] = vget_lane_f32(x, 0);
+			right[i] = vget_lane_f32(x, 1);
+		}
+
+		for (int j = 0; j < bandCount; j++)
+		{
+			vst1_f32(bands[j]->z1, z1[j]);
+			vst1_f32(bands[j]->z2, z2[j]);
+		}
+
+#else
+		for (int i = 0; i < count; i++)
+		{
+			float xl = left[i];
+			float xr = right[i];
+			for (int j = 0; j < bandCount; j++)
+			{
+				EqBiquad& band = *bands[j];
+				float yl = band.b0 * xl + band.z1[0];
+				float yr = band.b0 * xr + band.z1[1];
+				band.z1[0] = band.b1 * xl - band.a1 * yl + band.z2[0];
+				band.z1[1] = band.b1 * xr - band.a1 * yr + band.z2[1];
+				band.z2[0] = band.b2 * xl - band.a2 * yl;
+				band.z2[1] = band.b2 * xr - band.a2 * yr;
+				xl = yl;
+				xr = yr;
+			}
+
+			left[i] = xl;
+			right[i] = xr;
+		}
+#endif
+	}
+}
@@ -0,0 +1,39 @@
+﻿#ifndef _EqBiquad_h_
+#define _EqBiquad_h_
+
+#include"scutils/Utils.h"
+using namespace scutils;
+
+namespace ventrue
+{
+	//一次级联处理的最大频带数量
+	#define MAX_EQ_BIQUAD_COUNT 31
+
+	//均衡器频带的浮点双二阶滤波器(转置直接II型)
+	struct EqBiquad
+	{
+		float b0 = 1, b1 = 0, b2 = 0;
+		float a1 = 0, a2 = 0;
+
+		//左右声道的状态
+		float z1[2] = { 0, 0 };
+		float z2[2] = { 0, 0 };
+
+		//不起作用的频带不参与处理
+		bool isActive = false;
+
+		//设置系数(b0, b1, b2, a0, a1, a2)，并按a0归一化
+		void SetCoefficient(double coeff[6]);
+
+		//设置是否参与处理，重新启用时从零状态开始
+		void SetActive(bool isActive);
+
+		void Clear();
+	};
+
+	//左右声道依次通过级联的频带(最多MAX_EQ_BIQUAD_COUNT个)
+	//左右声道的样本放入同一个SIMD寄存器中并行处理
+	void ProcessEqBiquads(EqBiquad** bands, int bandCount, float* left, float* right, int count);
+}
+
+#endif
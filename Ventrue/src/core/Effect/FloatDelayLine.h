@@ -0,0 +1,94 @@
+﻿#ifndef _FloatDelayLine_h_
+#define _FloatDelayLine_h_
+
+#include "scutils/Utils.h"
+using namespace scutils;
+
+namespace ventrue
+{
+	//浮点环形缓存延迟线，支持按块写入和线性插值的分数延迟读取
+	//与stk DelayL的延迟定义相同: 延迟为0时读取的是当前写入的样本
+	class FloatDelayLine
+	{
+	public:
+		//每次处理的最大样本数量
+		static const int BLOCK_SIZE = 64;
+
+		FloatDelayLine(int maxDelay = 4095)
+		{
+			size = 1;
+			while (size < maxDelay + BLOCK_SIZE + 2)
+				size <<= 1;
+
+			mask = size - 1;
+			this->maxDelay = (float)maxDelay;
+			buf = (float*)calloc(size, sizeof(float));
+		}
+
+		~FloatDelayLine()
+		{
+			free(buf);
+		}
+
+		inline float GetMaxDelay()
+		{
+			return maxDelay;
+		}
+
+		void Clear()
+		{
+			memset(buf, 0, size * sizeof(float));
+		}
+
+		//写入count(不超过BLOCK_SIZE)个样本，并按每个样本的延迟读取输出
+		//delays中的延迟值需在[0, maxDelay]范围内
+		inline void Process(const float* input, float* output, const float* delays, int count)
+		{
+			for (int i = 0; i < count; i++)
+				buf[(writePos + i) & mask] = input[i];
+
+			//读取位置在写入位置之前，整块写入后再读取不会改变结果
+			//延迟拆分为整数和小数部分，避免大位置值损失小数精度
+			//循环中没有分支，读取地址由掩码计算
+			for (int i = 0; i < count; i++)
+			{
+				int intDelay = (int)delays[i];
+				float alpha = 1 - (delays[i] - intDelay);
+				int idx = writePos + i - intDelay;
+				float a = buf[(idx - 1) & mask];
+				float b = buf[idx & mask];
+				output[i] = a + (b - a) * alpha;
+			}
+
+			writePos = (writePos + count) & mask;
+		}
+
+		//写入count(不超过BLOCK_SIZE)个样本，并以固定延迟读取输出
+		inline void Process(const float* input, float* output, float delay, int count)
+		{
+			for (int i = 0; i < count; i++)
+				buf[(writePos + i) & mask] = input[i];
+
+			int intDelay = (int)delay;
+			float alpha = 1 - (delay - intDelay);
+			int idx = writePos - intDelay;
+			for (int i = 0; i < count; i++)
+			{
+				float a = buf[(idx + i - 1) & mask];
+				float b = buf[(idx + i) & mask];
+				output[i] = a + (b - a) * alpha;
+			}
+
+			writePos = (writePos + count) & mask;
+		}
+
+	private:
+		float* buf = nullptr;
+		int size = 0;
+		int mask = 0;
+		int writePos = 0;
+		float maxDelay = 0;
+	};
+}
+
+#endif
@@ -10,6 +10,7 @@ namespace ventrue
 	class DLL_CLASS VentrueEffect
 	{
 	public:
+		virtual ~VentrueEffect() {}
 
 		//设置是否开启效果
 		void SetEnable(bool isEnable)
@@ -1,56 +1,149 @@
 ﻿#include"MidiFile.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <queue>
 #include"MidiTrack.h"
 #include"MidiEvent.h"
+#include"MidiTrackStream.h"
+#include"scutils/ParallelJobs.h"
 
 namespace ventrue
 {
 	MidiFile::MidiFile()
 	{
-		midiReader = new ByteStream();
 		midiWriter = new ByteStream();
+		packedDataArena = new vector<byte>();
 
 		isLittleEndianSystem = JudgeLittleOrBigEndianSystem();
 	}
 
 	MidiFile::~MidiFile()
 	{
-		DEL(midiReader);
 		DEL(midiWriter);
+		FreePackedEvents();
+		DEL(packedDataArena);
+
+		for (int i = 0; i < midiTrackList.size(); i++)
+			DEL(midiTrackList[i]);
+
+		for (int i = 0; i < trackStreams.size(); i++)
+			DEL(trackStreams[i]);
+
+		DEL(streamFile);
 	}
 
 	// 解析文件到可识别数据结构
 	void MidiFile::Parse(string filePath)
 	{
-		std::ifstream t;
-		try
+		//文件只映射一次，各轨道块直接从映射内存中解析
+		MappedFile file;
+		if (!file.Open(filePath))
 		{
-			size_t length = 0;
-			t.open(filePath, ios::in | ios::binary);
-			t.seekg(0, std::ios::end);
-			length = t.tellg();
-			t.seekg(0, std::ios::beg);
-
-			char* buffer = new char[length];
-			t.read(buffer, length);
-			t.close();
-			midiReader->write(buffer, length);
-			delete[] buffer;
-			ParseCore();
+			cout << filePath << "文件打开出错!" << endl;
+			return;
 		}
-		catch (exception e)
+
+		ParseCore(file.GetData(), file.GetSize());
+		BuildPackedEvents();
+	}
+
+	// 以流式方式打开文件
+	bool MidiFile::OpenStream(string filePath)
+	{
+		streamFile = new MappedFile();
+		if (!streamFile->Open(filePath))
 		{
-			t.close();
 			cout << filePath << "文件打开出错!" << endl;
-			string error(e.what());
-			cout << "错误原因:" << error << endl;
+			return false;
 		}
 
-		midiReader->clear();
+		const byte* data = streamFile->GetData();
+		size_t size = streamFile->GetSize();
+
+		MidiChunkReader headerReader;
+		headerReader.data = data;
+		headerReader.size = size;
+
+		bool isSuccess;
+		try {
+			isSuccess = ParseHeaderChunk(headerReader);
+		}
+		catch (exception) {
+			isSuccess = false;
+		}
+
+		if (!isSuccess)
+			return false;
+
+		//数据不完整时保留已定位的轨道块
+		vector<MidiChunkReader> trackReaders;
+		isSuccess = LocateTrackChunks(data, size, headerReader.pos, trackReaders);
+
+		for (int i = 0; i < trackReaders.size(); i++)
+			trackStreams.push_back(new MidiTrackStream(this, trackReaders[i].data, trackReaders[i].size));
+
+		return isSuccess;
+	}
+
+	//合并时的事件序列游标
+	struct MergeCursor
+	{
+		list<MidiEvent*>* eventList;
+		list<MidiEvent*>::iterator it;
+		//只取该通道的事件(-1: 取所有事件)
+		int channel;
+		//合并顺序，tick相同时后合并的序列排在前面
+		int rank;
+
+		//移动到下一个需要合并的事件
+		inline void SkipUnmatched()
+		{
+			if (channel < 0)
+				return;
+
+			while (it != eventList->end() && (*it)->channel != channel)
+				it++;
+		}
+	};
+
+	struct MergeCursorCompare
+	{
+		inline bool operator()(const MergeCursor& a, const MergeCursor& b)
+		{
+			uint32_t tickA = (*a.it)->startTick;
+			uint32_t tickB = (*b.it)->startTick;
+			if (tickA != tickB)
+				return tickA > tickB;
+			return a.rank < b.rank;
+		}
+	};
+
+	//查找第一个NoteOn或ProgramChange事件
+	//channel >= 0时只查找该通道的事件，excludeMask中的通道不参与查找
+	static MidiEvent* FindFirstProgramEvent(list<MidiEvent*>* eventList, int channel, uint16_t excludeMask)
+	{
+		list<MidiEvent*>::iterator it = eventList->begin();
+		for (; it != eventList->end(); it++)
+		{
+			MidiEvent* ev = *it;
+			if (ev->type != MidiEventType::NoteOn && ev->type != MidiEventType::ProgramChange)
+				continue;
+
+			if ((channel >= 0 && ev->channel != channel) ||
+				(excludeMask & (1 << ev->channel)))
+				continue;
+
+			return ev;
+		}
+
+		return nullptr;
 	}
 
 	//合并轨道通道
+	//把后面轨道中与前面轨道相同通道的事件合并到前面轨道中
+	//每个轨道先确定所有要合并进来的通道事件序列，再对这些已按tick排好序的序列做一次k路堆合并
+	//tick相同时，后合并的序列排在前面，原轨道的事件排在最后
 	void MidiFile::MergeTrackChannels()
 	{
 		MidiEventList* eventListAtChannelA;
@@ -58,7 +151,10 @@ namespace ventrue
 		list<MidiEvent*>* eventListA;
 		list<MidiEvent*>* eventListB;
 
-		for (int i = 0; i < midiTrackList.size() - 1; i++)
+		vector<MergeCursor> sources;
+		vector<uint16_t> mergedMasks(midiTrackList.size(), 0);
+
+		for (int i = 0; i < (int)midiTrackList.size() - 1; i++)
 		{
 			eventListAtChannelA = midiTrackList[i]->GetEventListAtChannel();
 			eventListA = midiTrackList[i]->GetEventList();
@@ -78,10 +174,17 @@ namespace ventrue
 			if (isEmptyChannelA)
 				continue;
 
+			//确定需要合并到轨道A中的通道事件序列
+			sources.clear();
+			MidiEvent* firstEvA = nullptr;
+			if (mergeMode == AutoMerge)
+				firstEvA = FindFirstProgramEvent(eventListA, -1, 0);
+
 			for (int j = i + 1; j < midiTrackList.size(); j++)
 			{
 				eventListAtChannelB = midiTrackList[j]->GetEventListAtChannel();
 				eventListB = midiTrackList[j]->GetEventList();
+				mergedMasks[j] = 0;
 
 				for (int n = 0; n < 16; n++)
 				{
@@ -89,42 +192,77 @@ namespace ventrue
 						eventListAtChannelB[n].size() == 0)
 						continue;
 
-					if (mergeMode == AutoMerge &&
-						!CanMergeTrackChannels(eventListA, eventListB))
-						continue;
-
-					//
-					list<MidiEvent*>::iterator itA = eventListA->begin();
-					list<MidiEvent*>::iterator itB = eventListB->begin();
-					MidiEvent* evB;
-					for (; itB != eventListB->end(); )
+					if (mergeMode == AutoMerge)
 					{
-						evB = *itB;
-						if (evB->channel != n) {
-							itB++;
+						MidiEvent* firstEvB = FindFirstProgramEvent(eventListB, -1, mergedMasks[j]);
+						if (!CanMergeTrackChannels(firstEvA, firstEvB))
 							continue;
-						}
-
-						for (; itA != eventListA->end(); itA++)
-						{
-							if (evB->startTick <= (*itA)->startTick)
-							{
-								eventListA->insert(itA, evB);
-								break;
-							}
-						}
-
-						if (itA == eventListA->end())
-						{
-							eventListA->push_back(evB);
-						}
-
-						itB = eventListB->erase(itB);
+
+						//合并后轨道A的第一个NoteOn或ProgramChange事件
+						MidiEvent* firstEv = FindFirstProgramEvent(eventListB, n, 0);
+						if (firstEv != nullptr &&
+							(firstEvA == nullptr || firstEv->startTick <= firstEvA->startTick))
+							firstEvA = firstEv;
 					}
 
+					MergeCursor cursor;
+					cursor.eventList = eventListB;
+					cursor.it = eventListB->begin();
+					cursor.channel = n;
+					cursor.rank = (int)sources.size() + 1;
+					sources.push_back(cursor);
+
+					mergedMasks[j] |= 1 << n;
 					eventListAtChannelB[n].clear();
 				}
 			}
+
+			if (sources.empty())
+				continue;
+
+			//k路堆合并，事件节点直接从原列表移动到合并列表中
+			priority_queue<MergeCursor, vector<MergeCursor>, MergeCursorCompare> heap;
+
+			MergeCursor cursorA;
+			cursorA.eventList = eventListA;
+			cursorA.it = eventListA->begin();
+			cursorA.channel = -1;
+			cursorA.rank = 0;
+			heap.push(cursorA);
+
+			for (int k = 0; k < sources.size(); k++)
+			{
+				sources[k].SkipUnmatched();
+				if (sources[k].it != sources[k].eventList->end())
+					heap.push(sources[k]);
+			}
+
+			list<MidiEvent*> mergedList;
+			while (!heap.empty())
+			{
+				MergeCursor cursor = heap.top();
+				heap.pop();
+
+				list<MidiEvent*>::iterator cur = cursor.it++;
+				cursor.SkipUnmatched();
+				mergedList.splice(mergedList.end(), *cursor.eventList, cur);
+
+				if (cursor.it != cursor.eventList->end())
+					heap.push(cursor);
+			}
+
+			eventListA->swap(mergedList);
+
+			//重建轨道A的通道分类事件列表
+			for (int n = 0; n < 16; n++)
+				eventListAtChannelA[n].clear();
+
+			list<MidiEvent*>::iterator it = eventListA->begin();
+			for (; it != eventListA->end(); it++)
+			{
+				if ((*it)->channel >= 0)
+					eventListAtChannelA[(*it)->channel].push_back(*it);
+			}
 		}
 
 		//
@@ -148,38 +286,11 @@ namespace ventrue
 			midiTrackList.push_back(tmp[i]);
 	}
 
-	bool MidiFile::CanMergeTrackChannels(list<MidiEvent*>* eventListA, list<MidiEvent*>* eventListB)
+	//轨道A和轨道B中只有一个在第一个NoteOn之前设置了乐器时，可以合并
+	bool MidiFile::CanMergeTrackChannels(MidiEvent* firstEvA, MidiEvent* firstEvB)
 	{
-		list<MidiEvent*>::iterator itA = eventListA->begin();
-		MidiEvent* evA;
-		bool isHavProgramChangeA = false;
-		for (; itA != eventListA->end(); itA++)
-		{
-			evA = *itA;
-			if (evA->type == MidiEventType::NoteOn)
-				break;
-
-			if (evA->type == MidiEventType::ProgramChange) {
-				isHavProgramChangeA = true;
-				break;
-			}
-
-		}
-
-		list<MidiEvent*>::iterator itB = eventListB->begin();
-		MidiEvent* evB;
-		bool isHavProgramChangeB = false;
-		for (; itB != eventListB->end(); itB++)
-		{
-			evB = *itB;
-			if (evB->type == MidiEventType::NoteOn)
-				break;
-
-			if (evB->type == MidiEventType::ProgramChange) {
-				isHavProgramChangeB = true;
-				break;
-			}
-		}
+		bool isHavProgramChangeA = (firstEvA != nullptr && firstEvA->type == MidiEventType::ProgramChange);
+		bool isHavProgramChangeB = (firstEvB != nullptr && firstEvB->type == MidiEventType::ProgramChange);
 
 		if ((isHavProgramChangeA && isHavProgramChangeB) ||
 			(!isHavProgramChangeA && !isHavProgramChangeB))
@@ -195,146 +306,581 @@ namespace ventrue
 		trackCount++;
 	}
 
+	//扫描所有轨道的库选择和乐器更换事件，获取每个通道发声时使用的乐器
+	void MidiFile::ScanProgramUses(vector<MidiProgramUse>& uses)
+	{
+		unordered_set<int64_t> useSet;
+		for (int i = 0; i < midiTrackList.size(); i++)
+		{
+			int bankMSB[16] = { 0 };
+			int bankLSB[16] = { 0 };
+			MidiProgramUse chUses[16];
+			for (int ch = 0; ch < 16; ch++)
+				chUses[ch].channel = ch;
+
+			bankMSB[9] = 128;
+			chUses[9].bankSelectMSB = 128;
+
+			MidiPackedEvent* events = midiTrackList[i]->GetPackedEvents();
+			uint32_t count = midiTrackList[i]->GetPackedEventCount();
+			for (uint32_t j = 0; j < count; j++)
+			{
+				MidiPackedEvent& ev = events[j];
+				int ch = ev.channel;
+
+				switch (ev.GetType())
+				{
+				case MidiEventType::Controller:
+				{
+					MidiControllerType ctrlType = (MidiControllerType)ev.data1;
+					if (ctrlType == MidiControllerType::BankSelectMSB) {
+						bankMSB[ch] = ev.data2;
+						bankLSB[ch] = 0;
+					}
+					else if (ctrlType == MidiControllerType::BankSelectLSB) {
+						bankLSB[ch] = ev.data2;
+					}
+				}
+				break;
+
+				case MidiEventType::ProgramChange:
+					chUses[ch].bankSelectMSB = bankMSB[ch];
+					chUses[ch].bankSelectLSB = bankLSB[ch];
+					chUses[ch].programNum = ev.data1;
+					break;
+
+				case MidiEventType::NoteOn:
+				{
+					MidiProgramUse& use = chUses[ch];
+					int64_t key = (int64_t)ch << 32 | use.bankSelectMSB << 16 | use.bankSelectLSB << 8 | use.programNum;
+					if (useSet.insert(key).second)
+						uses.push_back(use);
+				}
+				break;
+
+				default:
+					break;
+				}
+			}
+		}
+	}
+
 	//解析内核
-	bool MidiFile::ParseCore()
+	bool MidiFile::ParseCore(const byte* data, size_t size)
 	{
-		bool isSuccess = ParseHeaderChunk();
+		MidiChunkReader headerReader;
+		headerReader.data = data;
+		headerReader.size = size;
+
+		bool isSuccess;
+		try {
+			isSuccess = ParseHeaderChunk(headerReader);
+		}
+		catch (exception) {
+			isSuccess = false;
+		}
+
 		if (!isSuccess)
 			return false;
 
-		for (int i = 0; i < trackCount; i++)
+		vector<MidiChunkReader> trackReaders;
+		isSuccess = LocateTrackChunks(data, size, headerReader.pos, trackReaders);
+
+		//各轨道块相互独立，并行解析
+		vector<MidiTrack*> tracks(trackReaders.size(), nullptr);
+		vector<int> rets(trackReaders.size(), 0);
+		if (trackReaders.size() > 1)
 		{
-			lastParseEventNum = 0;
-			lastParseEventChannel = 0;
-			curtParseTickCount = 0;
+			ParallelJobs jobs((int)min(trackReaders.size(), (size_t)ScUtils_GetCPUCount()));
+			jobs.Start(trackReaders.size(), [&](size_t i) {
+				tracks[i] = ParseTrackChuck(trackReaders[i], rets[i]);
+				});
+			jobs.Wait();
+		}
+		else if (trackReaders.size() == 1)
+		{
+			tracks[0] = ParseTrackChuck(trackReaders[0], rets[0]);
+		}
 
-			int ret = ParseTrackChuck();
-			if (ret == -1)
-				return false;
+		for (int i = 0; i < tracks.size(); i++)
+		{
+			if (rets[i] == -1)
+				isSuccess = false;
+
+			if (tracks[i]->GetEventCount() != 0)
+				midiTrackList.push_back(tracks[i]);
+			else
+				delete tracks[i];
 		}
 
+		if (!isSuccess)
+			return false;
+
 		if (mergeMode == AutoMerge || mergeMode == AlwaysMerge)
 			MergeTrackChannels();
 
 		return true;
 	}
 
+	//根据紧凑事件中的速度事件生成速度表
+	void MidiFile::BuildTempoMap(int trackIdx, vector<MidiTempoPoint>& tempoMap)
+	{
+		vector<pair<uint32_t, float>> tempos;
+		for (int i = 0; i < midiTrackList.size(); i++)
+		{
+			if (trackIdx >= 0 && i != trackIdx)
+				continue;
+
+			MidiPackedEvent* events = midiTrackList[i]->GetPackedEvents();
+			uint32_t eventCount = midiTrackList[i]->GetPackedEventCount();
+			for (uint32_t j = 0; j < eventCount; j++)
+			{
+				if (events[j].GetType() == MidiEventType::Tempo)
+					tempos.push_back(make_pair(events[j].startTick, (float)events[j].ext));
+			}
+		}
+
+		//相同tick的速度事件保持轨道顺序
+		stable_sort(tempos.begin(), tempos.end(),
+			[](const pair<uint32_t, float>& a, const pair<uint32_t, float>& b) {
+				return a.first < b.first;
+			});
+
+		tempoMap.clear();
+		tempoMap.push_back({ 0, 0, 4.166f / 1000.0 });
+
+		float tickForQuarterNote = GetTickForQuarterNote();
+		for (int i = 0; i < tempos.size(); i++)
+		{
+			MidiTempoPoint& prev = tempoMap.back();
+			MidiTempoPoint tempo;
+			tempo.tick = tempos[i].first;
+			tempo.sec = prev.sec + ((double)tempo.tick - prev.tick) * prev.secPerTick;
+			tempo.secPerTick = (float)(tempos[i].second / tickForQuarterNote * 0.001f) / 1000.0;
+			tempoMap.push_back(tempo);
+		}
+	}
+
+	//根据块头中的长度定位所有轨道块
+	//pos: 第一个轨道块的位置
+	bool MidiFile::LocateTrackChunks(const byte* data, size_t size, size_t pos, vector<MidiChunkReader>& trackReaders)
+	{
+		for (int i = 0; i < trackCount; i++)
+		{
+			if (pos + 8 > size || memcmp(data + pos, "MTrk", 4) != 0)
+				return false;
+
+			uint32_t trackLen = (uint32_t)data[pos + 4] << 24 | (uint32_t)data[pos + 5] << 16 | (uint32_t)data[pos + 6] << 8 | data[pos + 7];
+			pos += 8;
+
+			MidiChunkReader reader;
+			reader.data = data + pos;
+			reader.size = min((size_t)trackLen, size - pos);
+			pos += reader.size;
+
+			if (reader.size != 0)
+				trackReaders.push_back(reader);
+		}
+
+		return true;
+	}
+
+	//根据所有轨道的事件对象生成紧凑事件
+	void MidiFile::BuildPackedEvents()
+	{
+		//事件对象已释放时，保留现有的紧凑事件
+		if (packedEventArena != nullptr && packedEventObjArena == nullptr)
+			return;
+
+		FreePackedEvents();
+		packedDataArena->clear();
+
+		size_t totalCount = 0;
+		for (int i = 0; i < midiTrackList.size(); i++)
+			totalCount += midiTrackList[i]->GetEventList()->size();
+
+		if (totalCount == 0)
+			return;
+
+		packedEventArena = (MidiPackedEvent*)malloc(totalCount * sizeof(MidiPackedEvent));
+		packedEventObjArena = (MidiEvent**)malloc(totalCount * sizeof(MidiEvent*));
+
+		size_t pos = 0;
+		unordered_map<MidiEvent*, uint32_t> noteOnIdxMap;
+		for (int i = 0; i < midiTrackList.size(); i++)
+		{
+			list<MidiEvent*>* eventList = midiTrackList[i]->GetEventList();
+			MidiPackedEvent* events = packedEventArena + pos;
+			MidiEvent** eventObjs = packedEventObjArena + pos;
+			uint32_t idx = 0;
+			noteOnIdxMap.clear();
+
+			list<MidiEvent*>::iterator it = eventList->begin();
+			for (; it != eventList->end(); it++, idx++)
+			{
+				MidiEvent* ev = *it;
+				MidiPackedEvent& pev = events[idx];
+				pev.startTick = ev->startTick;
+				pev.type = (int8_t)ev->type;
+				pev.channel = ev->channel >= 0 ? (uint8_t)ev->channel : 0xff;
+				pev.data1 = 0;
+				pev.data2 = 0;
+				pev.ext = 0;
+				eventObjs[idx] = ev;
+
+				switch (ev->type)
+				{
+				case MidiEventType::NoteOn:
+				{
+					NoteOnEvent* noteOnEv = (NoteOnEvent*)ev;
+					pev.data1 = (uint8_t)noteOnEv->note;
+					pev.data2 = (uint8_t)noteOnEv->velocity;
+					pev.ext = MIDI_PACKED_NO_LINK;
+					if (noteOnEv->noteOffEvent != nullptr)
+						noteOnIdxMap[noteOnEv] = idx;
+				}
+				break;
+
+				case MidiEventType::NoteOff:
+				{
+					NoteOffEvent* noteOffEv = (NoteOffEvent*)ev;
+					pev.data1 = (uint8_t)noteOffEv->note;
+					pev.data2 = (uint8_t)noteOffEv->velocity;
+					pev.ext = MIDI_PACKED_NO_LINK;
+
+					//NoteOn和NoteOff互相记录对方的索引
+					auto noteOnIt = noteOnIdxMap.find(noteOffEv->noteOnEvent);
+					if (noteOnIt != noteOnIdxMap.end()) {
+						pev.ext = noteOnIt->second;
+						events[noteOnIt->second].ext = idx;
+						noteOnIdxMap.erase(noteOnIt);
+					}
+				}
+				break;
+
+				case MidiEventType::Controller:
+					pev.data1 = (uint8_t)((ControllerEvent*)ev)->ctrlType;
+					pev.data2 = (uint8_t)((ControllerEvent*)ev)->value;
+					break;
+
+				case MidiEventType::ProgramChange:
+					pev.data1 = (uint8_t)((ProgramChangeEvent*)ev)->value;
+					break;
+
+				case MidiEventType::KeyPressure:
+					pev.data1 = (uint8_t)((KeyPressureEvent*)ev)->note;
+					pev.data2 = (uint8_t)((KeyPressureEvent*)ev)->value;
+					break;
+
+				case MidiEventType::ChannelPressure:
+					pev.data1 = (uint8_t)((ChannelPressureEvent*)ev)->value;
+					break;
+
+				case MidiEventType::PitchBend:
+					pev.data1 = (uint8_t)(((PitchBendEvent*)ev)->value & 0x7f);
+					pev.data2 = (uint8_t)(((PitchBendEvent*)ev)->value >> 7 & 0x7f);
+					break;
+
+				case MidiEventType::Tempo:
+					pev.ext = (uint32_t)((TempoEvent*)ev)->microTempo;
+					break;
+
+				case MidiEventType::TimeSignature:
+				{
+					TimeSignatureEvent* timeSignatureEv = (TimeSignatureEvent*)ev;
+					pev.data1 = (uint8_t)timeSignatureEv->numerator;
+					pev.data2 = (uint8_t)timeSignatureEv->denominator;
+					pev.ext = (uint32_t)timeSignatureEv->metronomeCount | (uint32_t)timeSignatureEv->nCount32ndNotesPerQuarterNote << 8;
+				}
+				break;
+
+				case MidiEventType::KeySignature:
+					pev.data1 = (uint8_t)((KeySignatureEvent*)ev)->sf;
+					pev.data2 = (uint8_t)((KeySignatureEvent*)ev)->mi;
+					break;
+
+				case MidiEventType::Text:
+				{
+					TextEvent* textEv = (TextEvent*)ev;
+					pev.data1 = (uint8_t)textEv->textType;
+					pev.ext = AddPackedData((byte*)textEv->text.c_str(), textEv->text.size());
+				}
+				break;
+
+				case MidiEventType::Sysex:
+					pev.ext = AddPackedData(((SysexEvent*)ev)->data, ((SysexEvent*)ev)->size);
+					break;
+
+				case MidiEventType::Unknown:
+					pev.data1 = ((UnknownEvent*)ev)->codeType;
+					pev.ext = AddPackedData(((UnknownEvent*)ev)->data, ((UnknownEvent*)ev)->size);
+					break;
+
+				default:
+					break;
+				}
+			}
+
+			midiTrackList[i]->SetPackedEvents(events, eventObjs, idx);
+			pos += idx;
+		}
+	}
+
+	//释放所有轨道的事件对象，只保留紧凑事件
+	void MidiFile::ReleaseEventObjects()
+	{
+		for (int i = 0; i < midiTrackList.size(); i++)
+			midiTrackList[i]->ReleaseEventObjects();
+
+		free(packedEventObjArena);
+		packedEventObjArena = nullptr;
+	}
+
+	//紧凑事件附加数据(数据长度 + 数据)
+	uint32_t MidiFile::AddPackedData(byte* data, size_t size)
+	{
+		uint32_t offset = (uint32_t)packedDataArena->size();
+		uint32_t len = (uint32_t)size;
+		packedDataArena->insert(packedDataArena->end(), (byte*)&len, (byte*)&len + sizeof(uint32_t));
+		if (size > 0)
+			packedDataArena->insert(packedDataArena->end(), data, data + size);
+		return offset;
+	}
+
+	//释放紧凑事件内存
+	void MidiFile::FreePackedEvents()
+	{
+		free(packedEventArena);
+		packedEventArena = nullptr;
+		free(packedEventObjArena);
+		packedEventObjArena = nullptr;
+
+		for (int i = 0; i < midiTrackList.size(); i++)
+			midiTrackList[i]->SetPackedEvents(nullptr, nullptr, 0);
+	}
+
 	// 解析头块
-	bool MidiFile::ParseHeaderChunk()
+	bool MidiFile::ParseHeaderChunk(MidiChunkReader& reader)
 	{
 		//
 		byte headerType[5] = { 0 };
-		midiReader->read(headerType, 0, 4);
+		ReadBytes(reader, headerType, 4);
 		if (strcmp((const char*)headerType, "MThd") != 0)
 			return false;
 
 		//
-		midiReader->read<int32_t>();
+		uint32_t headerLen = ReadInt32(reader);
+		if (headerLen < 6)
+			return false;
+
+		size_t headerEnd = reader.pos + headerLen;
 
 		//
-		short formatVal = ReadInt16(*midiReader);
+		short formatVal = ReadInt16(reader);
 		if (formatVal > 2 || formatVal < 0)
 			return false;
 		format = (MidiFileFormat)formatVal;
 
 		//
-		trackCount = ReadInt16(*midiReader);
+		trackCount = ReadInt16(reader);
 		if (trackCount <= 0)
 			return false;
 
 		//
-		tickForQuarterNote = ReadInt16(*midiReader);
+		tickForQuarterNote = ReadInt16(reader);
+		reader.pos = headerEnd;
 		return tickForQuarterNote > 0;
 
 	}
 
 
-	//解析轨道块
-	int MidiFile::ParseTrackChuck()
+	//读取事件的deltaTime和状态字节
+	//数据字节(0x00~0x7f)开头时沿用上一个事件的状态(running status)
+	void MidiFile::ReadDeltaTimeAndStatus(MidiChunkReader& reader)
 	{
-		//
-		byte headerType[5] = { 0 };
-		midiReader->read(headerType, 0, 4);
-		if (strcmp((const char*)headerType, "MTrk") != 0)
-			return -1;
+		uint32_t deltaTime = ReadDynamicValue(reader);
+		reader.tickCount += deltaTime;
 
-		//
-		uint32_t trackLen = ReadInt32(*midiReader);
-		if (trackLen == 0)
-			return 0;
+		byte evnum = PeekByte(reader);
+		if (evnum <= 0x7f)
+			return;
+
+		evnum = ReadByte(reader);
+
+		if (evnum == 0xFF)
+		{
+			reader.lastEventNum = 0xFF;
+		}
+		else if (evnum == 0xF0)
+		{
+			reader.lastEventNum = 0xF0;
+		}
+		else
+		{
+			reader.lastEventNum = (byte)(evnum >> 4);
+			reader.lastEventChannel = (byte)(evnum & 0xf);
+		}
+	}
 
+	//解析轨道块
+	//parseRet: -1:解析出错，0:解析完成
+	MidiTrack* MidiFile::ParseTrackChuck(MidiChunkReader& reader, int& parseRet)
+	{
 		MidiTrack* track = new MidiTrack();
 		track->SetTickForQuarterNote(tickForQuarterNote);
-		int parseRet = 0;
+		parseRet = 0;
 
-		while (midiReader->getReadCursor() < midiReader->size())
+		try
 		{
-			uint32_t deltaTime = ReadDynamicValue(*midiReader);
-			curtParseTickCount += deltaTime;
-
-			//解析事件
-			byte evnum = midiReader->peek<byte>();
-			if (!(evnum >= 0x00 && evnum <= 0x7f))
+			while (reader.pos < reader.size)
 			{
-				evnum = midiReader->read<byte>();
+				ReadDeltaTimeAndStatus(reader);
 
-				if (evnum == 0xFF)
+				//解析事件
+				parseRet = ParseEvent(*track, reader);
+				if (parseRet == -1)   //解析出错
+					break;
+				if (parseRet == 2)  //当前音轨数据解析结束
 				{
-					lastParseEventNum = 0xFF;
+					parseRet = 0;
+					break;
 				}
-				else if (evnum == 0xF0)
+			}
+		}
+		catch (exception)
+		{
+			//数据不完整时保留已解析的事件
+			parseRet = -1;
+		}
+
+		return track;
+	}
+
+	//从轨道块中解码下一个事件为紧凑事件
+	//只保留播放时需要的NoteOn，NoteOff，Controller，ProgramChange，PitchBend和Tempo事件
+	//音符开关事件的关联由调用者处理，ext为MIDI_PACKED_NO_LINK
+	int MidiFile::ParsePackedEvent(MidiChunkReader& reader, MidiPackedEvent& ev)
+	{
+		if (reader.pos >= reader.size)
+			return 2;
+
+		try
+		{
+			ReadDeltaTimeAndStatus(reader);
+
+			ev.startTick = reader.tickCount;
+			ev.channel = (uint8_t)reader.lastEventChannel;
+			ev.data1 = 0;
+			ev.data2 = 0;
+			ev.ext = MIDI_PACKED_NO_LINK;
+
+			switch (reader.lastEventNum)
+			{
+			case 0x9:
+			case 0x8:
+				ev.data1 = ReadByte(reader);
+				ev.data2 = ReadByte(reader);
+				if (reader.lastEventNum == 0x9 && ev.data2 != 0)
+					ev.type = (int8_t)MidiEventType::NoteOn;
+				else
+					ev.type = (int8_t)MidiEventType::NoteOff;
+				return 0;
+
+			case 0xA:
+				ReadByte(reader);
+				ReadByte(reader);
+				return 1;
+
+			case 0xB:
+				ev.type = (int8_t)MidiEventType::Controller;
+				ev.data1 = ReadByte(reader);
+				ev.data2 = ReadByte(reader);
+				return 0;
+
+			case 0xC:
+				ev.type = (int8_t)MidiEventType::ProgramChange;
+				ev.data1 = ReadByte(reader);
+				return 0;
+
+			case 0xD:
+				ReadByte(reader);
+				return 1;
+
+			case 0xE:
+			{
+				ev.type = (int8_t)MidiEventType::PitchBend;
+				byte ff = ReadByte(reader) & 0x7F;
+				byte nn = ReadByte(reader) & 0x7F;
+				ev.data1 = isLittleEndianSystem ? ff : nn;
+				ev.data2 = isLittleEndianSystem ? nn : ff;
+				return 0;
+			}
+
+			case 0xF0:
+				while (ReadByte(reader) != 0xF7);
+				return 1;
+
+			case 0xFF:
+			{
+				byte type = ReadByte(reader);
+				if (type == 0x2F)
 				{
-					lastParseEventNum = 0xF0;
+					ReadByte(reader);  //FF2F00
+					return 2;
 				}
-				else
+
+				if (type == 0x51)
 				{
-					lastParseEventNum = (byte)(evnum >> 4);
-					lastParseEventChannel = (byte)(evnum & 0xf);
+					ReadByte(reader);
+					ev.type = (int8_t)MidiEventType::Tempo;
+					ev.channel = 0xff;
+					ev.ext = Read3BtyesToInt32(reader);
+					return 0;
 				}
-			}
 
-			parseRet = ParseEvent(*track);
-			if (parseRet == -1)   //解析出错
-				break;
-			if (parseRet == 2)  //当前音轨数据解析结束
-			{
-				parseRet = 0;
-				break;
+				uint32_t len = ReadDynamicValue(reader);
+				if (reader.size - reader.pos < len)
+					return -1;
+
+				reader.pos += len;
+				return 1;
+			}
 			}
 		}
+		catch (exception)
+		{
+			return -1;
+		}
 
-		if (track->GetEventCount() != 0)
-			midiTrackList.push_back(track);
-
-		return parseRet;
+		return 1;
 	}
 
-	int MidiFile::ParseEvent(MidiTrack& track)
+	int MidiFile::ParseEvent(MidiTrack& track, MidiChunkReader& reader)
 	{
-		switch (lastParseEventNum)
+		switch (reader.lastEventNum)
 		{
 		case 0x9:
 		{
-			int note = midiReader->read<byte>();
-			int velocity = midiReader->read<byte>();
+			int note = ReadByte(reader);
+			int velocity = ReadByte(reader);
 
 			NoteOnEvent* noteOnEvent;
 			if (velocity == 0)
 			{
-				noteOnEvent = track.FindNoteOnEvent(note, lastParseEventChannel);
+				noteOnEvent = track.FindNoteOnEvent(note, reader.lastEventChannel);
 				if (noteOnEvent == nullptr)
 					break;
 
 				//
 				NoteOffEvent* noteOffEvent = new NoteOffEvent();
-				noteOffEvent->startTick = curtParseTickCount;
+				noteOffEvent->startTick = reader.tickCount;
 				noteOffEvent->note = note;
 				noteOffEvent->velocity = velocity;
-				noteOffEvent->channel = lastParseEventChannel;
+				noteOffEvent->channel = reader.lastEventChannel;
 				noteOffEvent->noteOnEvent = noteOnEvent;
 
 				//
-				noteOnEvent->endTick = curtParseTickCount;
+				noteOnEvent->endTick = reader.tickCount;
 				noteOnEvent->noteOffEvent = noteOffEvent;
 
 				track.AddEvent(noteOffEvent);
@@ -342,10 +888,10 @@ namespace ventrue
 			else
 			{
 				noteOnEvent = new NoteOnEvent();
-				noteOnEvent->startTick = curtParseTickCount;
+				noteOnEvent->startTick = reader.tickCount;
 				noteOnEvent->note = note;
 				noteOnEvent->velocity = velocity;
-				noteOnEvent->channel = lastParseEventChannel;
+				noteOnEvent->channel = reader.lastEventChannel;
 				track.AddEvent(noteOnEvent);
 			}
 		}
@@ -353,21 +899,21 @@ namespace ventrue
 
 		case 0x8:
 		{
-			int note = midiReader->read<byte>();
-			int velocity = midiReader->read<byte>();
-			NoteOnEvent* noteOnEvent = track.FindNoteOnEvent(note, lastParseEventChannel);
+			int note = ReadByte(reader);
+			int velocity = ReadByte(reader);
+			NoteOnEvent* noteOnEvent = track.FindNoteOnEvent(note, reader.lastEventChannel);
 			if (noteOnEvent == nullptr)
 				break;
 
 			NoteOffEvent* noteOffEvent = new NoteOffEvent();
-			noteOffEvent->startTick = curtParseTickCount;
+			noteOffEvent->startTick = reader.tickCount;
 			noteOffEvent->note = note;
 			noteOffEvent->velocity = velocity;
-			noteOffEvent->channel = lastParseEventChannel;
+			noteOffEvent->channel = reader.lastEventChannel;
 			noteOffEvent->noteOnEvent = noteOnEvent;
 
 			//
-			noteOnEvent->endTick = curtParseTickCount;
+			noteOnEvent->endTick = reader.tickCount;
 			noteOnEvent->noteOffEvent = noteOffEvent;
 
 			track.AddEvent(noteOffEvent);
@@ -377,10 +923,10 @@ namespace ventrue
 		case 0xA:
 		{
 			KeyPressureEvent* keyPressureEvent = new KeyPressureEvent();
-			keyPressureEvent->startTick = curtParseTickCount;
-			keyPressureEvent->note = midiReader->read<byte>();
-			keyPressureEvent->value = midiReader->read<byte>();
-			keyPressureEvent->channel = lastParseEventChannel;
+			keyPressureEvent->startTick = reader.tickCount;
+			keyPressureEvent->note = ReadByte(reader);
+			keyPressureEvent->value = ReadByte(reader);
+			keyPressureEvent->channel = reader.lastEventChannel;
 			track.AddEvent(keyPressureEvent);
 		}
 		break;
@@ -388,10 +934,10 @@ namespace ventrue
 		case 0xB:
 		{
 			ControllerEvent* ctrlEvent = new ControllerEvent();
-			ctrlEvent->startTick = curtParseTickCount;
-			ctrlEvent->ctrlType = (MidiControllerType)midiReader->read<byte>();
-			ctrlEvent->value = midiReader->read<byte>();
-			ctrlEvent->channel = lastParseEventChannel;
+			ctrlEvent->startTick = reader.tickCount;
+			ctrlEvent->ctrlType = (MidiControllerType)ReadByte(reader);
+			ctrlEvent->value = ReadByte(reader);
+			ctrlEvent->channel = reader.lastEventChannel;
 			track.AddEvent(ctrlEvent);
 		}
 		break;
@@ -399,9 +945,9 @@ namespace ventrue
 		case 0xC:
 		{
 			ProgramChangeEvent* programEvent = new ProgramChangeEvent();
-			programEvent->startTick = curtParseTickCount;
-			programEvent->channel = lastParseEventChannel;
-			programEvent->value = midiReader->read<byte>();
+			programEvent->startTick = reader.tickCount;
+			programEvent->channel = reader.lastEventChannel;
+			programEvent->value = ReadByte(reader);
 			track.AddEvent(programEvent);
 		}
 		break;
@@ -409,9 +955,9 @@ namespace ventrue
 		case 0xD:
 		{
 			ChannelPressureEvent* channelPressureEvent = new ChannelPressureEvent();
-			channelPressureEvent->startTick = curtParseTickCount;
-			channelPressureEvent->value = midiReader->read<byte>();
-			channelPressureEvent->channel = lastParseEventChannel;
+			channelPressureEvent->startTick = reader.tickCount;
+			channelPressureEvent->value = ReadByte(reader);
+			channelPressureEvent->channel = reader.lastEventChannel;
 			track.AddEvent(channelPressureEvent);
 		}
 		break;
@@ -419,17 +965,17 @@ namespace ventrue
 		case 0xE:
 		{
 			PitchBendEvent* pitchBendEvent = new PitchBendEvent();
-			pitchBendEvent->startTick = curtParseTickCount;
+			pitchBendEvent->startTick = reader.tickCount;
 
-			int ff = midiReader->read<byte>() & 0x7F;
-			int nn = midiReader->read<byte>() & 0x7F;
+			int ff = ReadByte(reader) & 0x7F;
+			int nn = ReadByte(reader) & 0x7F;
 
 			if (isLittleEndianSystem)
 				pitchBendEvent->value = nn << 7 | ff;
 			else
 				pitchBendEvent->value = ff << 7 | nn;
 
-			pitchBendEvent->channel = lastParseEventChannel;
+			pitchBendEvent->channel = reader.lastEventChannel;
 			track.AddEvent(pitchBendEvent);
 		}
 		break;
@@ -437,13 +983,13 @@ namespace ventrue
 		case 0xF0:
 		{
 			SysexEvent* sysexEvent = new SysexEvent();
-			sysexEvent->startTick = curtParseTickCount;
+			sysexEvent->startTick = reader.tickCount;
 			byte b;
 			vector<byte> byteCodes;
 
 			do
 			{
-				b = midiReader->read<byte>();
+				b = ReadByte(reader);
 				if (b != 0xF7)
 					byteCodes.push_back(b);
 				else
@@ -457,7 +1003,7 @@ namespace ventrue
 
 		case 0xFF:
 		{
-			byte type = midiReader->read<byte>();
+			byte type = ReadByte(reader);
 			switch (type)
 			{
 			case 0x03:
@@ -471,11 +1017,11 @@ namespace ventrue
 				case 0x04: textEvent->textType = MidiTextType::InstrumentName; break;
 				}
 
-				uint32_t len = ReadDynamicValue(*midiReader);
+				uint32_t len = ReadDynamicValue(reader);
 				if (len != 0)
 				{
 					byte* byteCodes = (byte*)malloc(len);
-					midiReader->read(byteCodes, 0, len);
+					ReadBytes(reader, byteCodes, len);
 					byteCodes[len - 1] = 0;
 					if (byteCodes != nullptr) {
 						textEvent->text.assign((const char*)byteCodes);
@@ -489,51 +1035,51 @@ namespace ventrue
 
 			case 0x51:
 			{
-				midiReader->read<byte>();
+				ReadByte(reader);
 				TempoEvent* tempoEvent = new TempoEvent();
-				tempoEvent->startTick = curtParseTickCount;
-				tempoEvent->microTempo = (float)Read3BtyesToInt32(*midiReader);
+				tempoEvent->startTick = reader.tickCount;
+				tempoEvent->microTempo = (float)Read3BtyesToInt32(reader);
 				track.AddEvent(tempoEvent);
 			}
 			break;
 
 			case 0x58:
 			{
-				midiReader->read<byte>();
+				ReadByte(reader);
 				TimeSignatureEvent* timeSignatureEvent = new TimeSignatureEvent();
-				timeSignatureEvent->startTick = curtParseTickCount;
-				timeSignatureEvent->numerator = midiReader->read<byte>();
-				timeSignatureEvent->denominator = midiReader->read<byte>();
-				timeSignatureEvent->metronomeCount = midiReader->read<byte>();
-				timeSignatureEvent->nCount32ndNotesPerQuarterNote = midiReader->read<byte>();
+				timeSignatureEvent->startTick = reader.tickCount;
+				timeSignatureEvent->numerator = ReadByte(reader);
+				timeSignatureEvent->denominator = ReadByte(reader);
+				timeSignatureEvent->metronomeCount = ReadByte(reader);
+				timeSignatureEvent->nCount32ndNotesPerQuarterNote = ReadByte(reader);
 				track.AddEvent(timeSignatureEvent);
 			}
 			break;
 
 			case 0x59:
 			{
-				midiReader->read<byte>();
+				ReadByte(reader);
 				KeySignatureEvent* keySignatureEvent = new KeySignatureEvent();
-				keySignatureEvent->startTick = curtParseTickCount;
-				keySignatureEvent->sf = midiReader->read<byte>();
-				keySignatureEvent->mi = midiReader->read<byte>();
+				keySignatureEvent->startTick = reader.tickCount;
+				keySignatureEvent->sf = ReadByte(reader);
+				keySignatureEvent->mi = ReadByte(reader);
 				track.AddEvent(keySignatureEvent);
 			}
 			break;
 
 
 			case 0x2F:
-				midiReader->read<byte>();  //FF2F00
+				ReadByte(reader);  //FF2F00
 				return 2;  //当前音轨数据解析结束
 
 			default:
 			{
 				UnknownEvent* unknownEvent = new UnknownEvent();
 				unknownEvent->codeType = type;
-				uint32_t len = ReadDynamicValue(*midiReader);
+				uint32_t len = ReadDynamicValue(reader);
 
 				byte* byteCodes = (byte*)malloc(len);
-				midiReader->read(byteCodes, 0, len);
+				ReadBytes(reader, byteCodes, len);
 
 				unknownEvent->CreateData(byteCodes, len);
 				free(byteCodes);
@@ -793,7 +1339,7 @@ namespace ventrue
 			UnknownEvent& unknownEvent = (UnknownEvent&)midiEvent;
 			midiWriter->write((byte)0xff);  //事件类型
 			midiWriter->write((byte)0x59);  //种类
-			WriteDynamicValue(*midiReader, (int32_t)unknownEvent.size); //len
+			WriteDynamicValue(*midiWriter, (int32_t)unknownEvent.size); //len
 			midiWriter->write(unknownEvent.data, unknownEvent.size);
 		}
 
@@ -804,24 +1350,17 @@ namespace ventrue
 	}
 
 	//读取变长值
-	uint32_t MidiFile::ReadDynamicValue(ByteStream& reader, int maxByteCount)
+	uint32_t MidiFile::ReadDynamicValue(MidiChunkReader& reader, int maxByteCount)
 	{
 		uint32_t val = 0;
 		for (int i = 0; i < maxByteCount; i++)
 		{
-			uint32_t b = reader.read<byte>();
+			uint32_t b = ReadByte(reader);
 			val = (val << 7) | (b & 0x7f);
 			if ((b & 0x80) == 0)
 				break;
 		}
 
-		if (!isLittleEndianSystem)
-		{
-			byte* v = (byte*)(&val);
-			swap(v[0], v[3]);
-			swap(v[1], v[2]);
-		}
-
 		return val;
 	}
 
@@ -847,39 +1386,35 @@ namespace ventrue
 	}
 
 
-	short MidiFile::ReadInt16(ByteStream& reader)
+	void MidiFile::ReadBytes(MidiChunkReader& reader, byte* buf, size_t len)
 	{
-		byte dataBtyes[2] = { 0 };
-		reader.read(dataBtyes, 0, 2);
-		if (isLittleEndianSystem)
-			swap(dataBtyes[0], dataBtyes[1]);
-		return *((short*)dataBtyes);
+		if (reader.pos + len > reader.size)
+			throw exception();
+
+		memcpy(buf, reader.data + reader.pos, len);
+		reader.pos += len;
 	}
 
-	uint32_t MidiFile::ReadInt32(ByteStream& reader)
+	//文件中的多字节数值为大端存储
+	short MidiFile::ReadInt16(MidiChunkReader& reader)
 	{
-		byte dataBtyes[4] = { 0 };
-		reader.read(dataBtyes, 0, 4);
-
-		if (isLittleEndianSystem) {
-			swap(dataBtyes[0], dataBtyes[3]);
-			swap(dataBtyes[1], dataBtyes[2]);
-		}
-
-		return *((uint32_t*)dataBtyes);
+		byte dataBtyes[2];
+		ReadBytes(reader, dataBtyes, 2);
+		return (short)(dataBtyes[0] << 8 | dataBtyes[1]);
 	}
 
-	uint32_t MidiFile::Read3BtyesToInt32(ByteStream& reader)
+	uint32_t MidiFile::ReadInt32(MidiChunkReader& reader)
 	{
-		byte dataBtyes[4] = { 0 };
-		reader.read(dataBtyes, 1, 3);
-
-		if (isLittleEndianSystem) {
-			swap(dataBtyes[0], dataBtyes[3]);
-			swap(dataBtyes[1], dataBtyes[2]);
-		}
+		byte dataBtyes[4];
+		ReadBytes(reader, dataBtyes, 4);
+		return (uint32_t)dataBtyes[0] << 24 | (uint32_t)dataBtyes[1] << 16 | (uint32_t)dataBtyes[2] << 8 | dataBtyes[3];
+	}
 
-		return *((uint32_t*)dataBtyes);
+	uint32_t MidiFile::Read3BtyesToInt32(MidiChunkReader& reader)
+	{
+		byte dataBtyes[3];
+		ReadBytes(reader, dataBtyes, 3);
+		return (uint32_t)dataBtyes[0] << 16 | (uint32_t)dataBtyes[1] << 8 | dataBtyes[2];
 	}
 
 
@@ -2,9 +2,30 @@
 #define _MidiFile_h_
 
 #include "MidiTypes.h"
+#include "scutils/MappedFile.h"
 
 namespace ventrue
 {
+	/// <summary>
+	/// midi数据块读取状态
+	/// 每个轨道块使用独立的读取状态，可以在多个线程中同时解析
+	/// </summary>
+	struct MidiChunkReader
+	{
+		const byte* data = nullptr;
+		size_t size = 0;
+		size_t pos = 0;
+
+		// 最后解析的事件号
+		byte lastEventNum = 0;
+
+		// 最后解析的事件作用通道
+		int lastEventChannel = 0;
+
+		// 当前解析到的所有detlaTime相加的tick数量
+		uint32_t tickCount = 0;
+	};
+
 	/// <summary>
 	/// Midi文件解析类
 	/// by cymheart, 2020--2021.
@@ -54,9 +75,48 @@ namespace ventrue
 		//增加一个Midi轨道
 		void AddMidiTrack(MidiTrack* midiTrack);
 
+		//扫描所有轨道的库选择和乐器更换事件，获取每个通道发声时使用的乐器(相同的只保留一个)
+		//乐器更换时锁定当前的库选择值，未更换过乐器的通道使用乐器0，鼓点通道(通道9)的默认库选择MSB为128
+		void ScanProgramUses(vector<MidiProgramUse>& uses);
+
 		// 解析文件到可识别数据结构
+		// 文件以内存映射方式读取，各轨道块在多个线程中并行解析
 		void Parse(string filePath);
 
+		// 以流式方式打开文件
+		// 只解析头块并定位所有轨道块，不生成轨道事件，轨道事件在播放时通过MidiTrackStream按需解码
+		// 文件保持映射状态直到MidiFile析构
+		bool OpenStream(string filePath);
+
+		//获取流式打开时各轨道的事件流
+		inline vector<MidiTrackStream*>* GetTrackStreams()
+		{
+			return &trackStreams;
+		}
+
+		//从轨道块中解码下一个事件为紧凑事件(只保留播放需要的事件)
+		//返回值 0:解码出事件，1:事件播放时不需要，已跳过，2:轨道结束，-1:解析出错
+		int ParsePackedEvent(MidiChunkReader& reader, MidiPackedEvent& ev);
+
+		//根据所有轨道的事件对象生成紧凑事件(解析后会自动生成，轨道事件改变后需重新调用)
+		//所有轨道的紧凑事件存放在一块连续内存中，sysex和meta事件的数据存放在附加数据区中
+		void BuildPackedEvents();
+
+		//释放所有轨道的事件对象，只保留紧凑事件，用于减少大型midi文件的内存占用
+		void ReleaseEventObjects();
+
+		//根据紧凑事件中的速度事件生成速度表(按tick排序)
+		//trackIdx: 只使用该轨道的速度事件(-1: 使用所有轨道的速度事件)
+		//计算方式与播放轨道保持一致，第一个速度事件之前使用播放轨道的默认速度
+		void BuildTempoMap(int trackIdx, vector<MidiTempoPoint>& tempoMap);
+
+		//获取紧凑事件在附加数据区中的数据
+		inline byte* GetPackedData(uint32_t offset, uint32_t& size)
+		{
+			size = *(uint32_t*)(packedDataArena->data() + offset);
+			return packedDataArena->data() + offset + sizeof(uint32_t);
+		}
+
 		//生成midi格式内存数据
 		void CreateMidiFormatMemData();
 
@@ -67,15 +127,25 @@ namespace ventrue
 
 		//合并轨道通道
 		void MergeTrackChannels();
-		bool CanMergeTrackChannels(list<MidiEvent*>* eventListA, list<MidiEvent*>* eventListB);
+		//firstEvA, firstEvB: 轨道中第一个NoteOn或ProgramChange事件
+		bool CanMergeTrackChannels(MidiEvent* firstEvA, MidiEvent* firstEvB);
+
+		//紧凑事件附加数据
+		uint32_t AddPackedData(byte* data, size_t size);
+		//释放紧凑事件内存
+		void FreePackedEvents();
 
 		//解析内核
-		bool ParseCore();
+		bool ParseCore(const byte* data, size_t size);
 		//解析头块
-		bool ParseHeaderChunk();
+		bool ParseHeaderChunk(MidiChunkReader& reader);
+		//定位所有轨道块
+		bool LocateTrackChunks(const byte* data, size_t size, size_t pos, vector<MidiChunkReader>& trackReaders);
+		//读取事件的deltaTime和状态字节
+		void ReadDeltaTimeAndStatus(MidiChunkReader& reader);
 		//解析轨道块
-		int ParseTrackChuck();
-		int ParseEvent(MidiTrack& track);
+		MidiTrack* ParseTrackChuck(MidiChunkReader& reader, int& parseRet);
+		int ParseEvent(MidiTrack& track, MidiChunkReader& reader);
 
 		//生成头块
 		bool CreateHeaderChunk();
@@ -85,17 +155,31 @@ namespace ventrue
 		int CreateEventData(MidiEvent& midiEvent);
 
 		//读取变长值
-		uint32_t ReadDynamicValue(ByteStream& reader, int maxByteCount = 4);
+		uint32_t ReadDynamicValue(MidiChunkReader& reader, int maxByteCount = 4);
 		//写入变长值
 		void WriteDynamicValue(ByteStream& writer, int32_t value);
 
-		short ReadInt16(ByteStream& reader);
-		uint32_t ReadInt32(ByteStream& reader);
-		uint32_t Read3BtyesToInt32(ByteStream& reader);
+		inline byte ReadByte(MidiChunkReader& reader)
+		{
+			if (reader.pos >= reader.size)
+				throw exception();
+			return reader.data[reader.pos++];
+		}
+
+		inline byte PeekByte(MidiChunkReader& reader)
+		{
+			if (reader.pos >= reader.size)
+				throw exception();
+			return reader.data[reader.pos];
+		}
+
+		void ReadBytes(MidiChunkReader& reader, byte* buf, size_t len);
+		short ReadInt16(MidiChunkReader& reader);
+		uint32_t ReadInt32(MidiChunkReader& reader);
+		uint32_t Read3BtyesToInt32(MidiChunkReader& reader);
 		void WriteInt32To3Btyes(ByteStream& writer, int32_t value);
 
 	private:
-		ByteStream* midiReader = nullptr;
 		ByteStream* midiWriter = nullptr;
 
 		bool isLittleEndianSystem = true;
@@ -103,13 +187,7 @@ namespace ventrue
 		//轨道通道合并模式
 		TrackChannelMergeMode mergeMode = TrackChannelMergeMode::AutoMerge;
 
-		// 最后解析的事件号
-		byte lastParseEventNum = 0;
-
-		// 最后解析的事件作用通道
-		int lastParseEventChannel = 0;
-
-		// 当前解析到的所有detlaTime相加的tick数量
+		// 当前生成到的所有detlaTime相加的tick数量
 		uint32_t curtParseTickCount = 0;
 
 		// 格式
@@ -124,6 +202,18 @@ namespace ventrue
 
 		MidiTrackList midiTrackList;
 
+		//所有轨道的紧凑事件
+		MidiPackedEvent* packedEventArena = nullptr;
+		//与紧凑事件一一对应的事件对象
+		MidiEvent** packedEventObjArena = nullptr;
+		//sysex和meta事件的附加数据
+		vector<byte>* packedDataArena = nullptr;
+
+		//流式打开时映射的文件
+		MappedFile* streamFile = nullptr;
+		//流式打开时各轨道的事件流
+		vector<MidiTrackStream*> trackStreams;
+
 	};
 }
 
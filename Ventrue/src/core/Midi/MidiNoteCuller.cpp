@@ -0,0 +1,161 @@
+﻿#include"MidiNoteCuller.h"
+#include"MidiFile.h"
+#include"MidiTrack.h"
+#include"MidiEvent.h"
+
+namespace ventrue
+{
+	// 同一通道同一音符的裁剪状态
+	struct NoteCullKeyState
+	{
+		// 最后保留的音符
+		NoteOnEvent* lastNoteOn = nullptr;
+		// 最后保留的音符的起始时间点(单位:秒)
+		double lastNoteOnSec = 0;
+		// 正在发声的音符
+		vector<NoteOnEvent*> soundingNoteOns;
+	};
+
+	MidiNoteCuller::MidiNoteCuller(const MidiNoteCullOptions& options)
+	{
+		this->options = options;
+	}
+
+	MidiNoteCuller::~MidiNoteCuller()
+	{
+	}
+
+	// 裁剪midi文件中的音符
+	MidiNoteCullReport MidiNoteCuller::Cull(MidiFile* midiFile)
+	{
+		MidiNoteCullReport report;
+		if (!options.IsEnable())
+			return report;
+
+		MidiTrackList* trackList = midiFile->GetTrackList();
+
+		//事件对象已释放时无法裁剪
+		for (int i = 0; i < trackList->size(); i++)
+		{
+			if ((*trackList)[i]->GetEventCount() == 0 &&
+				(*trackList)[i]->GetPackedEventCount() != 0)
+				return report;
+		}
+
+		//同步轨道格式中，任一轨道的速度事件作用于所有轨道
+		bool isSyncTracks = midiFile->GetFormat() == MidiFileFormat::SyncTracks;
+		vector<MidiTempoPoint> tempoMap;
+		if (isSyncTracks)
+			midiFile->BuildTempoMap(-1, tempoMap);
+
+		for (int i = 0; i < trackList->size(); i++)
+		{
+			if (!isSyncTracks)
+				midiFile->BuildTempoMap(i, tempoMap);
+
+			removeEvents.clear();
+			CullTrack((*trackList)[i], tempoMap, report);
+			(*trackList)[i]->RemoveEvents(removeEvents);
+		}
+
+		removeEvents.clear();
+
+		if (report.GetRemovedCount() != 0)
+			midiFile->BuildPackedEvents();
+
+		return report;
+	}
+
+	// 裁剪轨道中的音符
+	void MidiNoteCuller::CullTrack(MidiTrack* track, vector<MidiTempoPoint>& tempoMap, MidiNoteCullReport& report)
+	{
+		unordered_map<int, NoteCullKeyState> keyStates;
+		list<MidiEvent*>* eventList = track->GetEventList();
+		int m = 0;
+
+		for (auto it = eventList->begin(); it != eventList->end(); ++it)
+		{
+			if ((*it)->type != MidiEventType::NoteOn)
+				continue;
+
+			NoteOnEvent* noteOn = (NoteOnEvent*)*it;
+			report.noteCount++;
+
+			//力度过低
+			if (noteOn->velocity < options.minVelocity)
+			{
+				RemoveNote(noteOn);
+				report.lowVelocityCount++;
+				continue;
+			}
+
+			uint32_t tick = noteOn->startTick;
+			while (m + 1 < tempoMap.size() && tempoMap[m + 1].tick <= tick)
+				m++;
+
+			double sec = tempoMap[m].sec + ((double)tick - tempoMap[m].tick) * tempoMap[m].secPerTick;
+			NoteCullKeyState& keyState = keyStates[noteOn->note << 4 | noteOn->channel];
+
+			//与最后保留的音符间隔过短时合并
+			NoteOnEvent* lastNoteOn = keyState.lastNoteOn;
+			if (options.mergeSameKeyMs > 0 && lastNoteOn != nullptr &&
+				(sec - keyState.lastNoteOnSec) * 1000 < options.mergeSameKeyMs)
+			{
+				lastNoteOn->velocity = max(lastNoteOn->velocity, noteOn->velocity);
+
+				NoteOffEvent* noteOff = noteOn->noteOffEvent;
+				NoteOffEvent* lastNoteOff = lastNoteOn->noteOffEvent;
+				if (noteOff != nullptr && lastNoteOff != nullptr &&
+					noteOff->startTick > lastNoteOff->startTick)
+				{
+					//合并后的音符使用较晚的结束事件
+					removeEvents.insert(lastNoteOff);
+					removeEvents.insert(noteOn);
+					lastNoteOn->noteOffEvent = noteOff;
+					lastNoteOn->endTick = noteOff->startTick;
+					noteOff->noteOnEvent = lastNoteOn;
+				}
+				else
+				{
+					RemoveNote(noteOn);
+				}
+
+				report.mergedCount++;
+				continue;
+			}
+
+			//同时发声数量超过限制
+			if (options.maxSameKeyOverlap > 0)
+			{
+				vector<NoteOnEvent*>& soundings = keyState.soundingNoteOns;
+				for (int i = (int)soundings.size() - 1; i >= 0; i--)
+				{
+					if (soundings[i]->noteOffEvent == nullptr || soundings[i]->endTick <= tick) {
+						soundings[i] = soundings.back();
+						soundings.pop_back();
+					}
+				}
+
+				if ((int)soundings.size() >= options.maxSameKeyOverlap)
+				{
+					RemoveNote(noteOn);
+					report.overlapCount++;
+					continue;
+				}
+
+				soundings.push_back(noteOn);
+			}
+
+			keyState.lastNoteOn = noteOn;
+			keyState.lastNoteOnSec = sec;
+		}
+	}
+
+	// 移除音符和对应的NoteOff
+	void MidiNoteCuller::RemoveNote(NoteOnEvent* noteOn)
+	{
+		removeEvents.insert(noteOn);
+		if (noteOn->noteOffEvent != nullptr)
+			removeEvents.insert(noteOn->noteOffEvent);
+	}
+}
@@ -0,0 +1,79 @@
+﻿#ifndef _MidiNoteCuller_h_
+#define _MidiNoteCuller_h_
+
+#include "MidiTypes.h"
+
+namespace ventrue
+{
+	// 音符裁剪规则
+	// 所有规则都只比较同一轨道中同一通道的同一音符
+	struct MidiNoteCullOptions
+	{
+		// 力度低于该值的音符被删除(0: 不删除)
+		int minVelocity = 0;
+		// 在该时间内(单位:毫秒)再次按下的音符合并到之前的音符中(0: 不合并)
+		float mergeSameKeyMs = 0;
+		// 同时发声的最大数量，超过时新按下的音符被删除(0: 不限制)
+		int maxSameKeyOverlap = 0;
+
+		// 是否有需要执行的规则
+		inline bool IsEnable() const
+		{
+			return minVelocity > 0 || mergeSameKeyMs > 0 || maxSameKeyOverlap > 0;
+		}
+	};
+
+	// 音符裁剪结果
+	struct MidiNoteCullReport
+	{
+		// 裁剪前的音符数量
+		int noteCount = 0;
+		// 力度过低被删除的音符数量
+		int lowVelocityCount = 0;
+		// 被合并的音符数量
+		int mergedCount = 0;
+		// 同时发声数量超过限制被删除的音符数量
+		int overlapCount = 0;
+
+		// 总共移除的音符数量
+		inline int GetRemovedCount()
+		{
+			return lowVelocityCount + mergedCount + overlapCount;
+		}
+	};
+
+	/*
+	* midi音符裁剪
+	* 在midi文件解析后离线分析所有音符，移除对发声几乎没有贡献的音符，
+	* 减少播放时创建发音的开销(以降低部分还原度为代价):
+	* 1.力度过低的音符直接删除
+	* 2.极短时间内重复按下的同一音符合并为一个音符，合并后的音符持续到较晚的结束时间
+	* 3.同一音符同时发声的数量超过限制时，删除新按下的音符
+	* 需要在释放事件对象之前执行，执行后会重新生成紧凑事件
+	* by cymheart, 2020--2021.
+	*/
+	class MidiNoteCuller
+	{
+	public:
+		MidiNoteCuller(const MidiNoteCullOptions& options);
+		~MidiNoteCuller();
+
+		// 裁剪midi文件中的音符
+		MidiNoteCullReport Cull(MidiFile* midiFile);
+
+	private:
+		// 裁剪轨道中的音符，需要移除的事件记录到removeEvents中
+		void CullTrack(MidiTrack* track, vector<MidiTempoPoint>& tempoMap, MidiNoteCullReport& report);
+
+		// 移除音符和对应的NoteOff
+		void RemoveNote(NoteOnEvent* noteOn);
+
+	private:
+		MidiNoteCullOptions options;
+
+		// 需要移除的事件
+		unordered_set<MidiEvent*> removeEvents;
+	};
+}
+
+#endif
@@ -1,5 +1,6 @@
 ﻿#include"MidiTrack.h"
 #include"MidiEvent.h"
+#include<algorithm>
 
 namespace ventrue
 {
@@ -94,6 +95,12 @@ namespace ventrue
 	}
 
 	MidiTrack::~MidiTrack()
+	{
+		ReleaseEventObjects();
+	}
+
+	//释放所有事件对象，之后只能通过紧凑事件访问
+	void MidiTrack::ReleaseEventObjects()
 	{
 		list<MidiEvent*>::iterator it = midiEventList.begin();
 		list<MidiEvent*>::iterator end = midiEventList.end();
@@ -102,6 +109,12 @@ namespace ventrue
 			delete* it;
 		}
 		midiEventList.clear();
+
+		for (int i = 0; i < 16; i++)
+			MidiEventList().swap(midiEventListAtChannel[i]);
+
+		noteOnEventMap.clear();
+		packedEventObjs = nullptr;
 	}
 
 
@@ -129,6 +142,44 @@ namespace ventrue
 		noteOnEventMap[note << 12 | channel].push_back(midiEvent);
 	}
 
+	//移除并释放指定的事件
+	void MidiTrack::RemoveEvents(const unordered_set<MidiEvent*>& removeEvents)
+	{
+		if (removeEvents.empty())
+			return;
+
+		auto isRemove = [&](MidiEvent* ev) {
+			return removeEvents.find(ev) != removeEvents.end();
+		};
+
+		for (int i = 0; i < 16; i++)
+		{
+			MidiEventList& evList = midiEventListAtChannel[i];
+			evList.erase(remove_if(evList.begin(), evList.end(), isRemove), evList.end());
+		}
+
+		for (auto it = noteOnEventMap.begin(); it != noteOnEventMap.end();)
+		{
+			vector<NoteOnEvent*>& noteOns = it->second;
+			noteOns.erase(remove_if(noteOns.begin(), noteOns.end(), isRemove), noteOns.end());
+			if (noteOns.empty())
+				it = noteOnEventMap.erase(it);
+			else
+				++it;
+		}
+
+		for (auto it = midiEventList.begin(); it != midiEventList.end();)
+		{
+			if (isRemove(*it)) {
+				delete* it;
+				it = midiEventList.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
 	/// <summary>
 	/// 寻找匹配的NoteOnEvent
 	/// </summary>
@@ -160,10 +211,10 @@ namespace ventrue
 
 		int orgBaseTick = 0;
 		int dstBaseTick = 0;
-		//未修改前的每tick的毫秒数
-		float orgMsPerTick = 0;
+		//未修改前的每tick的毫秒数(第一个Tempo事件之前使用默认值500000)
+		float orgMsPerTick = 500000 / tickForQuarterNote;
 		//修改后的每tick的毫秒数
-		float dstMsPerTick = 0;
+		float dstMsPerTick = 500000 / changedTickForQuarterNote;
 
 		list<MidiEvent*>::iterator it = midiEventList.begin();
 		list<MidiEvent*>::iterator end = midiEventList.end();
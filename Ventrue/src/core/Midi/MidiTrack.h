@@ -28,6 +28,9 @@ namespace ventrue
 
 		void AddNoteOnEventToMap(int note, int channel, NoteOnEvent* midiEvent);
 
+		//移除并释放指定的事件(之后需要重新生成紧凑事件)
+		void RemoveEvents(const unordered_set<MidiEvent*>& removeEvents);
+
 		/// <summary>
 		/// 获取事件列表
 		/// </summary>
@@ -66,6 +69,36 @@ namespace ventrue
 		//改变轨道所有Midi事件中一个四分音符所要弹奏的tick数
 		void ChangeMidiEventsTickForQuarterNote(float changedTickForQuarterNote);
 
+		//设置紧凑事件(内存由MidiFile持有)
+		//eventObjs: 与紧凑事件一一对应的事件对象，事件对象释放后为nullptr
+		inline void SetPackedEvents(MidiPackedEvent* events, MidiEvent** eventObjs, uint32_t count)
+		{
+			packedEvents = events;
+			packedEventObjs = eventObjs;
+			packedEventCount = count;
+		}
+
+		//获取紧凑事件
+		inline MidiPackedEvent* GetPackedEvents()
+		{
+			return packedEvents;
+		}
+
+		//获取与紧凑事件一一对应的事件对象
+		inline MidiEvent** GetPackedEventObjs()
+		{
+			return packedEventObjs;
+		}
+
+		//获取紧凑事件数量
+		inline uint32_t GetPackedEventCount()
+		{
+			return packedEventCount;
+		}
+
+		//释放所有事件对象，之后只能通过紧凑事件访问
+		void ReleaseEventObjects();
+
 	private:
 		list<MidiEvent*> midiEventList;
 		MidiEventList midiEventListAtChannel[16];
@@ -75,6 +108,11 @@ namespace ventrue
 
 		unordered_map<int, vector<NoteOnEvent*>> noteOnEventMap;
 
+		//紧凑事件
+		MidiPackedEvent* packedEvents = nullptr;
+		MidiEvent** packedEventObjs = nullptr;
+		uint32_t packedEventCount = 0;
+
 	};
 
 }
@@ -0,0 +1,145 @@
+﻿#include"MidiTrackStream.h"
+
+namespace ventrue
+{
+	//读取位置之后预解码的事件数量
+	static const uint32_t STREAM_PREFETCH_COUNT = 2048;
+
+	MidiTrackStream::MidiTrackStream(MidiFile* midiFile, const byte* data, size_t size)
+	{
+		this->midiFile = midiFile;
+		reader.data = data;
+		reader.size = size;
+		window.reserve(STREAM_PREFETCH_COUNT * 2);
+	}
+
+	MidiTrackStream::~MidiTrackStream()
+	{
+	}
+
+	//回到轨道开头
+	void MidiTrackStream::Reset()
+	{
+		reader.pos = 0;
+		reader.lastEventNum = 0;
+		reader.lastEventChannel = 0;
+		reader.tickCount = 0;
+
+		window.clear();
+		baseIdx = 0;
+		readIdx = 0;
+		isDecodeEnded = false;
+		noteOnIdxMap.clear();
+	}
+
+	//丢弃已读取的事件，并在读取位置之后预解码一段事件
+	void MidiTrackStream::Fill()
+	{
+		if (readIdx >= STREAM_PREFETCH_COUNT)
+			DiscardReadEvents();
+
+		while (!isDecodeEnded && window.size() - readIdx < STREAM_PREFETCH_COUNT)
+			DecodeNext();
+	}
+
+	//解码下一个事件到窗口中
+	void MidiTrackStream::DecodeNext()
+	{
+		MidiPackedEvent ev;
+		int ret = midiFile->ParsePackedEvent(reader, ev);
+		if (ret == 1)
+			return;
+
+		//轨道结束或数据出错
+		if (ret != 0)
+		{
+			isDecodeEnded = true;
+			CloseNotes();
+			return;
+		}
+
+		AddEvent(ev);
+	}
+
+	//添加事件到窗口中，并关联音符开关事件
+	void MidiTrackStream::AddEvent(MidiPackedEvent& ev)
+	{
+		int key = ev.data1 << 4 | ev.channel;
+
+		if (ev.GetType() == MidiEventType::NoteOn)
+		{
+			noteOnIdxMap[key].push_back(baseIdx + window.size());
+		}
+		else if (ev.GetType() == MidiEventType::NoteOff)
+		{
+			//没有对应NoteOn的NoteOff直接丢弃
+			auto it = noteOnIdxMap.find(key);
+			if (it == noteOnIdxMap.end())
+				return;
+
+			uint64_t noteOnIdx = it->second.back();
+			it->second.pop_back();
+			if (it->second.empty())
+				noteOnIdxMap.erase(it);
+
+			uint32_t idx = (uint32_t)window.size();
+			if (noteOnIdx >= baseIdx)
+			{
+				window[noteOnIdx - baseIdx].ext = idx;
+				ev.ext = (uint32_t)(noteOnIdx - baseIdx);
+			}
+			else
+			{
+				//NoteOn已被丢弃时关联到自身
+				ev.ext = idx;
+			}
+		}
+
+		window.push_back(ev);
+	}
+
+	//丢弃已读取的事件
+	void MidiTrackStream::DiscardReadEvents()
+	{
+		uint32_t count = readIdx;
+		window.erase(window.begin(), window.begin() + count);
+		baseIdx += count;
+		readIdx = 0;
+
+		//修正音符开关事件的关联索引
+		for (uint32_t i = 0; i < window.size(); i++)
+		{
+			MidiPackedEvent& ev = window[i];
+			if (ev.ext == MIDI_PACKED_NO_LINK)
+				continue;
+
+			if (ev.GetType() == MidiEventType::NoteOn)
+				ev.ext -= count;
+			else if (ev.GetType() == MidiEventType::NoteOff)
+				ev.ext = ev.ext >= count ? ev.ext - count : i;
+		}
+	}
+
+	//轨道结束时关闭所有未关闭的音符
+	void MidiTrackStream::CloseNotes()
+	{
+		vector<int> keys;
+		for (auto it = noteOnIdxMap.begin(); it != noteOnIdxMap.end(); ++it)
+		{
+			for (size_t i = 0; i < it->second.size(); i++)
+				keys.push_back(it->first);
+		}
+
+		for (int i = 0; i < keys.size(); i++)
+		{
+			MidiPackedEvent ev;
+			ev.startTick = reader.tickCount;
+			ev.type = (int8_t)MidiEventType::NoteOff;
+			ev.channel = (uint8_t)(keys[i] & 0xf);
+			ev.data1 = (uint8_t)(keys[i] >> 4);
+			ev.data2 = 127;
+			ev.ext = MIDI_PACKED_NO_LINK;
+			AddEvent(ev);
+		}
+	}
+}
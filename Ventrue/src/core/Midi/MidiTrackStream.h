@@ -0,0 +1,90 @@
+﻿#ifndef _MidiTrackStream_h_
+#define _MidiTrackStream_h_
+
+#include "MidiFile.h"
+
+namespace ventrue
+{
+	/// <summary>
+	/// midi轨道事件流
+	/// 播放时从轨道块中按需解码紧凑事件，内存中只保留读取位置之后的一段事件窗口，
+	/// 已读取的事件会被丢弃，内存占用与轨道大小无关
+	/// by cymheart, 2020--2021.
+	/// </summary>
+	class MidiTrackStream
+	{
+	public:
+		//data, size: 轨道块数据(由midiFile持有)
+		MidiTrackStream(MidiFile* midiFile, const byte* data, size_t size);
+		~MidiTrackStream();
+
+		//回到轨道开头
+		void Reset();
+
+		//丢弃已读取的事件，并在读取位置之后预解码一段事件
+		//调用后窗口中事件的索引和读取位置会改变
+		void Fill();
+
+		//获取窗口中的事件
+		//NoteOn和NoteOff的ext为关联事件在窗口中的索引，NoteOff还未解码时NoteOn的ext为MIDI_PACKED_NO_LINK
+		inline MidiPackedEvent* GetEvents()
+		{
+			return window.data();
+		}
+
+		//获取窗口中的事件数量
+		inline uint32_t GetEventCount()
+		{
+			return (uint32_t)window.size();
+		}
+
+		//获取读取位置(窗口中的索引)
+		inline uint32_t GetReadIdx()
+		{
+			return readIdx;
+		}
+
+		//设置读取位置(窗口中的索引)
+		inline void SetReadIdx(uint32_t idx)
+		{
+			readIdx = idx;
+		}
+
+		//轨道事件是否已全部读取
+		inline bool IsEnded()
+		{
+			return isDecodeEnded && readIdx == window.size();
+		}
+
+	private:
+		//解码下一个事件到窗口中
+		void DecodeNext();
+		//添加事件到窗口中，并关联音符开关事件
+		void AddEvent(MidiPackedEvent& ev);
+		//丢弃已读取的事件
+		void DiscardReadEvents();
+		//轨道结束时关闭所有未关闭的音符
+		void CloseNotes();
+
+	private:
+		MidiFile* midiFile;
+		MidiChunkReader reader;
+
+		//事件窗口
+		vector<MidiPackedEvent> window;
+
+		//窗口中第一个事件在轨道中的序号
+		uint64_t baseIdx = 0;
+
+		//读取位置
+		uint32_t readIdx = 0;
+
+		//是否已解码到轨道结尾
+		bool isDecodeEnded = false;
+
+		//未关闭的NoteOn在轨道中的序号(note << 4 | channel)
+		unordered_map<int, vector<uint64_t>> noteOnIdxMap;
+	};
+}
+
+#endif
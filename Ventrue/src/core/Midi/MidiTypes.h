@@ -13,6 +13,8 @@ namespace ventrue
 	class NoteOnEvent;
 	class NoteOffEvent;
 	class MidiTrack;
+	class MidiTrackStream;
+	class MidiFile;
 
 	using MidiEventList = vector<MidiEvent*>;
 	using MidiTrackList = vector<MidiTrack*>;
@@ -282,6 +284,66 @@ namespace ventrue
 		NoMerge
 	};
 
+	/// <summary>
+	/// 通道发声时使用的乐器
+	/// </summary>
+	struct MidiProgramUse
+	{
+		//通道
+		int channel = 0;
+		//库选择MSB
+		int bankSelectMSB = 0;
+		//库选择LSB
+		int bankSelectLSB = 0;
+		//乐器号
+		int programNum = 0;
+	};
+
+	//紧凑事件中没有关联事件时的索引值
+#define MIDI_PACKED_NO_LINK 0xFFFFFFFF
+
+	/// <summary>
+	/// 紧凑存储的midi事件(固定长度的POD记录)
+	/// 每个轨道的事件按顺序连续存放，播放时线性遍历
+	/// </summary>
+	struct MidiPackedEvent
+	{
+		//起始tick
+		uint32_t startTick;
+		//事件类型(MidiEventType)
+		int8_t type;
+		//通道(0xff: 无通道)
+		uint8_t channel;
+		//NoteOn/NoteOff/KeyPressure: 音符, Controller: 控制器类型, ProgramChange/ChannelPressure: 值
+		//PitchBend: 低7位, TimeSignature: 分子, KeySignature: sf, Text: 文本类型, Unknown: 类型码
+		uint8_t data1;
+		//NoteOn/NoteOff: 力度, Controller/KeyPressure: 值, PitchBend: 高7位
+		//TimeSignature: 分母, KeySignature: mi
+		uint8_t data2;
+		//NoteOn: 对应NoteOff在轨道中的索引, NoteOff: 对应NoteOn在轨道中的索引
+		//Tempo: 一个四分音符的微秒数, TimeSignature: 节拍器时钟数 | 32分音符数 << 8
+		//Text/Sysex/Unknown: 数据在附加数据区中的偏移
+		uint32_t ext;
+
+		inline MidiEventType GetType() const
+		{
+			return (MidiEventType)type;
+		}
+	};
+
+	/// <summary>
+	/// 速度表中的一段速度
+	/// </summary>
+	struct MidiTempoPoint
+	{
+		//起始tick
+		uint32_t tick;
+		//起始tick对应的时间点(单位:秒)
+		double sec;
+		//每个tick的时长(单位:秒)
+		double secPerTick;
+	};
+
 }
 
 #endif
@@ -0,0 +1,578 @@
+﻿#include"SoundFontCache.h"
+#include"Synth/Ventrue.h"
+#include"Synth/SoundFont.h"
+#include"Synth/Sample.h"
+#include"Synth/SampleStore.h"
+#include"Synth/Instrument.h"
+#include"Synth/Preset.h"
+#include"Synth/Region.h"
+#include"Synth/Generator.h"
+#include"Synth/Modulator.h"
+#include <fstream>
+
+namespace ventrue
+{
+	static const char SFCACHE_MAGIC[8] = { 'V', 'T', 'S', 'F', 'C', 'A', 'C', 'H' };
+	static const uint32_t SFCACHE_ENDIAN_TAG = 0x01020304;
+
+	//按16字节对齐，便于pcm数据的SIMD读取
+	static inline uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~((uint64_t)15);
+	}
+
+	//表[offset, offset + count * itemSize)是否在文件范围内(避免溢出)
+	static inline bool CheckRange(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t fileSize)
+	{
+		return offset <= fileSize && count <= (fileSize - offset) / itemSize;
+	}
+
+	SoundFontCache::~SoundFontCache()
+	{
+		for (int i = 0; i < mappedFiles.size(); i++)
+			DEL(mappedFiles[i]);
+		mappedFiles.clear();
+	}
+
+	//加载缓存文件到ventrue
+	void SoundFontCache::Parse(string filePath)
+	{
+		MappedFile* file = new MappedFile();
+		if (!file->Open(filePath)) {
+			DEL(file);
+			return;
+		}
+
+		data = file->GetData();
+		const SFCacheHeader* header = (const SFCacheHeader*)data;
+		if (!CheckHeader(header, file->GetSize()) ||
+			!CheckEntries(header, file->GetSize())) {
+			DEL(file);
+			data = nullptr;
+			return;
+		}
+
+		//共享音源的样本数据需随共享音源一同释放
+		if (soundFont != nullptr)
+			soundFont->AddMappedFile(file);
+		else
+			mappedFiles.push_back(file);
+
+		const SFCacheSample* cacheSamples = (const SFCacheSample*)(data + header->sampleOffset);
+		const SFCacheInstrument* cacheInsts = (const SFCacheInstrument*)(data + header->instOffset);
+		const SFCachePreset* cachePresets = (const SFCachePreset*)(data + header->presetOffset);
+		const SFCacheRegion* cacheRegions = (const SFCacheRegion*)(data + header->regionOffset);
+		const char* cacheNames = (const char*)(data + header->nameOffset);
+		string name;
+
+		//样本
+		vector<Sample*> samples(header->sampleCount);
+		for (uint32_t i = 0; i < header->sampleCount; i++)
+		{
+			const SFCacheSample& cs = cacheSamples[i];
+			name.assign(cacheNames + cs.nameOffset, cs.nameLen);
+			float* pcm = (float*)(data + cs.pcmOffset);
+
+			Sample* sample = ventrue->AddSample(name, pcm, (size_t)cs.size, soundFont);
+			sample->sampleRate = cs.sampleRate;
+			sample->originalPitch = cs.originalPitch;
+			sample->centPitchCorrection = cs.centPitchCorrection;
+			sample->velocity = cs.velocity;
+			sample->sampleType = (SampleType)cs.sampleType;
+			sample->startIdx = cs.startIdx;
+			sample->endIdx = cs.endIdx;
+			sample->startloopIdx = cs.startloopIdx;
+			sample->endloopIdx = cs.endloopIdx;
+			samples[i] = sample;
+		}
+
+		for (uint32_t i = 0; i < header->sampleCount; i++)
+		{
+			int32_t link = cacheSamples[i].sampleLink;
+			if (link >= 0 && link < (int32_t)header->sampleCount)
+				samples[i]->SetSampleLink(samples[link]);
+		}
+
+		//乐器
+		vector<Instrument*> insts(header->instCount);
+		for (uint32_t i = 0; i < header->instCount; i++)
+		{
+			const SFCacheInstrument& ci = cacheInsts[i];
+			name.assign(cacheNames + ci.nameOffset, ci.nameLen);
+			Instrument* inst = ventrue->AddInstrument(name, soundFont);
+
+			for (uint32_t j = ci.regionStart; j < ci.regionStart + ci.regionCount; j++)
+			{
+				const SFCacheRegion& cr = cacheRegions[j];
+				Region* region;
+				if (cr.linkIdx < 0)
+					region = inst->GetGlobalRegion();
+				else
+					region = ventrue->SampleBindToInstrument(samples[cr.linkIdx], inst);
+
+				ReadRegion(region, cr);
+			}
+
+			insts[i] = inst;
+		}
+
+		//预设
+		for (uint32_t i = 0; i < header->presetCount; i++)
+		{
+			const SFCachePreset& cp = cachePresets[i];
+			name.assign(cacheNames + cp.nameOffset, cp.nameLen);
+			Preset* preset = ventrue->AddPreset(name, cp.bankSelectMSB, cp.bankSelectLSB, cp.instrumentNum, soundFont);
+
+			for (uint32_t j = cp.regionStart; j < cp.regionStart + cp.regionCount; j++)
+			{
+				const SFCacheRegion& cr = cacheRegions[j];
+				Region* region;
+				if (cr.linkIdx < 0)
+					region = preset->GetGlobalRegion();
+				else
+					region = ventrue->InstrumentBindToPreset(insts[cr.linkIdx], preset);
+
+				ReadRegion(region, cr);
+			}
+		}
+
+		data = nullptr;
+	}
+
+	bool SoundFontCache::CheckHeader(const SFCacheHeader* header, size_t fileSize)
+	{
+		if (fileSize < sizeof(SFCacheHeader) ||
+			memcmp(header->magic, SFCACHE_MAGIC, sizeof(SFCACHE_MAGIC)) != 0 ||
+			header->version != SFCACHE_VERSION ||
+			header->endianTag != SFCACHE_ENDIAN_TAG ||
+			header->fileSize != fileSize)
+		{
+			return false;
+		}
+
+		if (!CheckRange(header->sampleOffset, header->sampleCount, sizeof(SFCacheSample), fileSize) ||
+			!CheckRange(header->instOffset, header->instCount, sizeof(SFCacheInstrument), fileSize) ||
+			!CheckRange(header->presetOffset, header->presetCount, sizeof(SFCachePreset), fileSize) ||
+			!CheckRange(header->regionOffset, header->regionCount, sizeof(SFCacheRegion), fileSize) ||
+			!CheckRange(header->genOffset, header->genCount, sizeof(SFCacheGenerator), fileSize) ||
+			!CheckRange(header->modOffset, header->modCount, sizeof(SFCacheModulator), fileSize) ||
+			!CheckRange(header->modInputOffset, header->modInputCount, sizeof(SFCacheModInput), fileSize) ||
+			!CheckRange(header->nameOffset, header->nameSize, 1, fileSize) ||
+			header->pcmOffset > fileSize)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	//检查所有表项中的索引和偏移，任何一项越界都拒绝使用此缓存
+	bool SoundFontCache::CheckEntries(const SFCacheHeader* header, size_t fileSize)
+	{
+		const SFCacheSample* cacheSamples = (const SFCacheSample*)(data + header->sampleOffset);
+		const SFCacheInstrument* cacheInsts = (const SFCacheInstrument*)(data + header->instOffset);
+		const SFCachePreset* cachePresets = (const SFCachePreset*)(data + header->presetOffset);
+		const SFCacheRegion* cacheRegions = (const SFCacheRegion*)(data + header->regionOffset);
+		const SFCacheGenerator* cacheGens = (const SFCacheGenerator*)(data + header->genOffset);
+		const SFCacheModulator* cacheMods = (const SFCacheModulator*)(data + header->modOffset);
+
+		//样本
+		for (uint32_t i = 0; i < header->sampleCount; i++)
+		{
+			const SFCacheSample& cs = cacheSamples[i];
+			if ((uint64_t)cs.nameOffset + cs.nameLen > header->nameSize ||
+				cs.pcmOffset < header->pcmOffset ||
+				cs.pcmOffset > fileSize ||
+				cs.pcmOffset % sizeof(float) != 0 ||
+				cs.size > (fileSize - cs.pcmOffset) / sizeof(float) ||
+				cs.sampleLink >= (int32_t)header->sampleCount)
+				return false;
+		}
+
+		//乐器区域关联样本，预设区域关联乐器
+		for (uint32_t i = 0; i < header->instCount; i++)
+		{
+			const SFCacheInstrument& ci = cacheInsts[i];
+			if ((uint64_t)ci.nameOffset + ci.nameLen > header->nameSize ||
+				(uint64_t)ci.regionStart + ci.regionCount > header->regionCount)
+				return false;
+
+			for (uint32_t j = ci.regionStart; j < ci.regionStart + ci.regionCount; j++)
+			{
+				if (cacheRegions[j].linkIdx >= (int32_t)header->sampleCount)
+					return false;
+			}
+		}
+
+		for (uint32_t i = 0; i < header->presetCount; i++)
+		{
+			const SFCachePreset& cp = cachePresets[i];
+			if ((uint64_t)cp.nameOffset + cp.nameLen > header->nameSize ||
+				(uint64_t)cp.regionStart + cp.regionCount > header->regionCount)
+				return false;
+
+			for (uint32_t j = cp.regionStart; j < cp.regionStart + cp.regionCount; j++)
+			{
+				if (cacheRegions[j].linkIdx >= (int32_t)header->instCount)
+					return false;
+			}
+		}
+
+		//区域的生成器和调制器
+		for (uint32_t i = 0; i < header->regionCount; i++)
+		{
+			const SFCacheRegion& cr = cacheRegions[i];
+			if ((uint64_t)cr.genStart + cr.genCount > header->genCount ||
+				(uint64_t)cr.modStart + cr.modCount > header->modCount)
+				return false;
+		}
+
+		for (uint32_t i = 0; i < header->genCount; i++)
+		{
+			if (cacheGens[i].type < 0 || cacheGens[i].type >= (int32_t)GeneratorType::EndOper)
+				return false;
+		}
+
+		for (uint32_t i = 0; i < header->modCount; i++)
+		{
+			const SFCacheModulator& cm = cacheMods[i];
+			if ((uint64_t)cm.inputStart + cm.inputCount > header->modInputCount ||
+				cm.outGenType < (int32_t)GeneratorType::None ||
+				cm.outGenType >= (int32_t)GeneratorType::EndOper)
+				return false;
+		}
+
+		return true;
+	}
+
+	//从缓存中恢复区域的生成器和调制器
+	void SoundFontCache::ReadRegion(Region* region, const SFCacheRegion& cacheRegion)
+	{
+		const SFCacheHeader* header = (const SFCacheHeader*)data;
+		const SFCacheGenerator* cacheGens = (const SFCacheGenerator*)(data + header->genOffset);
+		const SFCacheModulator* cacheMods = (const SFCacheModulator*)(data + header->modOffset);
+		const SFCacheModInput* cacheInputs = (const SFCacheModInput*)(data + header->modInputOffset);
+
+		GeneratorList& genList = *region->GetGenList();
+		for (uint32_t i = cacheRegion.genStart; i < cacheRegion.genStart + cacheRegion.genCount; i++)
+		{
+			GeneratorType type = (GeneratorType)cacheGens[i].type;
+			if (type == GeneratorType::KeyRange || type == GeneratorType::VelRange)
+				genList.SetAmountRange(type, cacheGens[i].low, cacheGens[i].high);
+			else
+				genList.SetAmount(type, cacheGens[i].low);
+		}
+
+		if (cacheRegion.modCount == 0)
+			return;
+
+		//先生成所有调制器，再连接调制器之间的输出关系
+		vector<Modulator*> regionMods(cacheRegion.modCount);
+		for (uint32_t i = 0; i < cacheRegion.modCount; i++)
+		{
+			const SFCacheModulator& cm = cacheMods[cacheRegion.modStart + i];
+			Modulator* mod = new Modulator();
+			mod->SetType((ModulatorType)cm.type);
+
+			for (int port = 0; port < 2; port++)
+			{
+				mod->sourceTransTypes[port] = (ModSourceTransformType)cm.sourceTransType[port];
+				mod->dir[port] = cm.dir[port];
+				mod->polar[port] = cm.polar[port];
+				mod->inValueRange[port] = RangeFloat(cm.inValueRange[port][0], cm.inValueRange[port][1]);
+				mod->outValueRange[port] = RangeFloat(cm.outValueRange[port][0], cm.outValueRange[port][1]);
+			}
+
+			for (uint32_t j = cm.inputStart; j < cm.inputStart + cm.inputCount; j++)
+			{
+				const SFCacheModInput& ci = cacheInputs[j];
+				mod->AddInputInfo(
+					(ModInputType)ci.inputType, (ModInputPreset)ci.inputPreset, (MidiControllerType)ci.ctrlType,
+					ci.inputPort, ci.inputNativeValueMin, ci.inputNativeValueMax);
+			}
+
+			mod->SetAmount(cm.amount);
+			mod->SetAbsType((ModTransformType)cm.absType);
+			mod->SetOutModulationType((ModulationType)cm.modulationType);
+			regionMods[i] = mod;
+		}
+
+		for (uint32_t i = 0; i < cacheRegion.modCount; i++)
+		{
+			const SFCacheModulator& cm = cacheMods[cacheRegion.modStart + i];
+			if (cm.outModIdx >= 0 && cm.outModIdx < (int32_t)cacheRegion.modCount)
+				regionMods[i]->SetOutTarget(regionMods[cm.outModIdx], cm.outModPort);
+			else
+				regionMods[i]->SetOutTarget((GeneratorType)cm.outGenType);
+
+			region->AddModulator(regionMods[i]);
+		}
+	}
+
+	//保存ventrue当前已加载的音源到缓存文件
+	bool SoundFontCache::Save(string filePath)
+	{
+		SampleList& sampleList = *ventrue->GetSampleList();
+		InstrumentList& instList = *ventrue->GetInstrumentList();
+		PresetList& presetList = *ventrue->GetPresetList();
+		SampleStore* sampleStore = ventrue->GetSampleStore();
+
+		//流式样本的数据不完全在内存中，不能写入缓存
+		for (int i = 0; i < sampleList.size(); i++)
+		{
+			if (sampleList[i]->isStreaming)
+				return false;
+		}
+
+		regions.clear();
+		gens.clear();
+		mods.clear();
+		modInputs.clear();
+		names.clear();
+
+		unordered_map<Sample*, int32_t> sampleIdxMap;
+		unordered_map<Instrument*, int32_t> instIdxMap;
+		for (int i = 0; i < sampleList.size(); i++)
+			sampleIdxMap[sampleList[i]] = i;
+		for (int i = 0; i < instList.size(); i++)
+			instIdxMap[instList[i]] = i;
+
+		//样本
+		vector<SFCacheSample> cacheSamples(sampleList.size());
+		for (int i = 0; i < sampleList.size(); i++)
+		{
+			Sample* sample = sampleList[i];
+			SFCacheSample& cs = cacheSamples[i];
+			memset(&cs, 0, sizeof(SFCacheSample));
+			cs.nameOffset = WriteName(sample->name);
+			cs.nameLen = (uint32_t)sample->name.size();
+			cs.size = sample->size;
+			cs.sampleRate = sample->sampleRate;
+			cs.originalPitch = sample->originalPitch;
+			cs.centPitchCorrection = sample->centPitchCorrection;
+			cs.velocity = sample->velocity;
+			cs.sampleType = (int32_t)sample->sampleType;
+			cs.startIdx = sample->startIdx;
+			cs.endIdx = sample->endIdx;
+			cs.startloopIdx = sample->startloopIdx;
+			cs.endloopIdx = sample->endloopIdx;
+
+			auto it = sampleIdxMap.find(sample->sampleLink);
+			cs.sampleLink = (it != sampleIdxMap.end() ? it->second : -1);
+		}
+
+		//乐器
+		vector<SFCacheInstrument> cacheInsts(instList.size());
+		for (int i = 0; i < instList.size(); i++)
+		{
+			Instrument* inst = instList[i];
+			SFCacheInstrument& ci = cacheInsts[i];
+			ci.nameOffset = WriteName(inst->name);
+			ci.nameLen = (uint32_t)inst->name.size();
+			ci.regionStart = (uint32_t)regions.size();
+
+			WriteRegion(inst->GetGlobalRegion(), -1);
+
+			SamplesLinkToInstRegionInfoList& infos = *inst->GetInstRegionLinkInfoList();
+			for (int j = 0; j < infos.size(); j++)
+				WriteRegion(infos[j].region, sampleIdxMap[infos[j].linkSample]);
+
+			ci.regionCount = (uint32_t)regions.size() - ci.regionStart;
+		}
+
+		//预设
+		vector<SFCachePreset> cachePresets(presetList.size());
+		for (int i = 0; i < presetList.size(); i++)
+		{
+			Preset* preset = presetList[i];
+			SFCachePreset& cp = cachePresets[i];
+			cp.nameOffset = WriteName(preset->name);
+			cp.nameLen = (uint32_t)preset->name.size();
+			cp.bankSelectMSB = preset->bankSelectMSB;
+			cp.bankSelectLSB = preset->bankSelectLSB;
+			cp.instrumentNum = preset->instrumentNum;
+			cp.regionStart = (uint32_t)regions.size();
+
+			WriteRegion(preset->GetGlobalRegion(), -1);
+
+			InstLinkToPresetRegionInfoList& infos = *preset->GetPresetRegionLinkInfoList();
+			for (int j = 0; j < infos.size(); j++)
+				WriteRegion(infos[j].region, instIdxMap[infos[j].linkInst]);
+
+			cp.regionCount = (uint32_t)regions.size() - cp.regionStart;
+		}
+
+		//布局
+		SFCacheHeader header;
+		memset(&header, 0, sizeof(SFCacheHeader));
+		memcpy(header.magic, SFCACHE_MAGIC, sizeof(SFCACHE_MAGIC));
+		header.version = SFCACHE_VERSION;
+		header.endianTag = SFCACHE_ENDIAN_TAG;
+		header.sampleCount = (uint32_t)cacheSamples.size();
+		header.instCount = (uint32_t)cacheInsts.size();
+		header.presetCount = (uint32_t)cachePresets.size();
+		header.regionCount = (uint32_t)regions.size();
+		header.genCount = (uint32_t)gens.size();
+		header.modCount = (uint32_t)mods.size();
+		header.modInputCount = (uint32_t)modInputs.size();
+		header.nameSize = (uint32_t)names.size();
+
+		uint64_t offset = AlignOffset(sizeof(SFCacheHeader));
+		header.sampleOffset = offset; offset = AlignOffset(offset + cacheSamples.size() * sizeof(SFCacheSample));
+		header.instOffset = offset; offset = AlignOffset(offset + cacheInsts.size() * sizeof(SFCacheInstrument));
+		header.presetOffset = offset; offset = AlignOffset(offset + cachePresets.size() * sizeof(SFCachePreset));
+		header.regionOffset = offset; offset = AlignOffset(offset + regions.size() * sizeof(SFCacheRegion));
+		header.genOffset = offset; offset = AlignOffset(offset + gens.size() * sizeof(SFCacheGenerator));
+		header.modOffset = offset; offset = AlignOffset(offset + mods.size() * sizeof(SFCacheModulator));
+		header.modInputOffset = offset; offset = AlignOffset(offset + modInputs.size() * sizeof(SFCacheModInput));
+		header.nameOffset = offset; offset = AlignOffset(offset + names.size());
+		header.pcmOffset = offset;
+
+		for (int i = 0; i < cacheSamples.size(); i++)
+		{
+			cacheSamples[i].pcmOffset = offset;
+			offset = AlignOffset(offset + cacheSamples[i].size * sizeof(float));
+		}
+
+		header.fileSize = offset;
+
+		//写入
+		ofstream out(filePath, ios::out | ios::binary | ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		uint64_t writePos = 0;
+		char zeros[16] = { 0 };
+		auto writeAt = [&](uint64_t pos, const void* buf, size_t len) {
+			if (pos > writePos)
+				out.write(zeros, (streamsize)(pos - writePos));
+			out.write((const char*)buf, (streamsize)len);
+			writePos = pos + len;
+		};
+
+		writeAt(0, &header, sizeof(SFCacheHeader));
+		writeAt(header.sampleOffset, cacheSamples.data(), cacheSamples.size() * sizeof(SFCacheSample));
+		writeAt(header.instOffset, cacheInsts.data(), cacheInsts.size() * sizeof(SFCacheInstrument));
+		writeAt(header.presetOffset, cachePresets.data(), cachePresets.size() * sizeof(SFCachePreset));
+		writeAt(header.regionOffset, regions.data(), regions.size() * sizeof(SFCacheRegion));
+		writeAt(header.genOffset, gens.data(), gens.size() * sizeof(SFCacheGenerator));
+		writeAt(header.modOffset, mods.data(), mods.size() * sizeof(SFCacheModulator));
+		writeAt(header.modInputOffset, modInputs.data(), modInputs.size() * sizeof(SFCacheModInput));
+		writeAt(header.nameOffset, names.data(), names.size());
+
+		//按需解码模式下，样本可能尚未解码，写入时临时固定
+		for (int i = 0; i < sampleList.size(); i++)
+		{
+			Sample* sample = sampleList[i];
+			sampleStore->Pin(sample);
+			if (sample->pcm != nullptr)
+				writeAt(cacheSamples[i].pcmOffset, sample->pcm, sample->size * sizeof(float));
+			sampleStore->Unpin(sample);
+		}
+
+		if (writePos < header.fileSize)
+			out.write(zeros, (streamsize)(header.fileSize - writePos));
+
+		bool isOk = out.good();
+		out.close();
+
+		regions.clear();
+		gens.clear();
+		mods.clear();
+		modInputs.clear();
+		names.clear();
+
+		return isOk;
+	}
+
+	//导出区域的生成器和调制器
+	void SoundFontCache::WriteRegion(Region* region, int32_t linkIdx)
+	{
+		SFCacheRegion cr;
+		cr.linkIdx = linkIdx;
+		cr.genStart = (uint32_t)gens.size();
+		cr.modStart = (uint32_t)mods.size();
+
+		GeneratorList& genList = *region->GetGenList();
+		for (int i = 0; i < 64; i++)
+		{
+			GeneratorType type = (GeneratorType)i;
+			if (genList.IsEmpty(type))
+				continue;
+
+			RangeFloat range = genList.GetAmountRange(type);
+			SFCacheGenerator cg;
+			cg.type = i;
+			cg.low = range.min;
+			cg.high = range.max;
+			gens.push_back(cg);
+		}
+
+		ModulatorVec* regionMods = region->GetModulators();
+		size_t modCount = (regionMods == nullptr ? 0 : regionMods->size());
+		for (size_t i = 0; i < modCount; i++)
+		{
+			Modulator* mod = (*regionMods)[i];
+			SFCacheModulator cm;
+			memset(&cm, 0, sizeof(SFCacheModulator));
+			cm.type = (int32_t)mod->type;
+			cm.outGenType = (int32_t)mod->outTargetGeneratorType;
+			cm.outModIdx = -1;
+			cm.outModPort = mod->outTargetModulatorPort;
+			cm.absType = (int32_t)mod->absType;
+			cm.modulationType = (int32_t)mod->outTargetModulationType;
+			cm.amount = mod->amount;
+
+			for (size_t j = 0; j < modCount; j++)
+			{
+				if ((*regionMods)[j] == mod->outTargetModulator) {
+					cm.outModIdx = (int32_t)j;
+					break;
+				}
+			}
+
+			for (int port = 0; port < 2; port++)
+			{
+				cm.sourceTransType[port] = (int32_t)mod->sourceTransTypes[port];
+				cm.dir[port] = mod->dir[port];
+				cm.polar[port] = mod->polar[port];
+				cm.inValueRange[port][0] = mod->inValueRange[port].min;
+				cm.inValueRange[port][1] = mod->inValueRange[port].max;
+				cm.outValueRange[port][0] = mod->outValueRange[port].min;
+				cm.outValueRange[port][1] = mod->outValueRange[port].max;
+			}
+
+			//调制器类型的输入由输出连接关系重建，这里只保存预设和控制器输入
+			cm.inputStart = (uint32_t)modInputs.size();
+			ModInputInfoList& infos = *mod->inputInfos;
+			for (int j = 0; j < infos.size(); j++)
+			{
+				if (infos[j]->inputType == ModInputType::Modulator)
+					continue;
+
+				SFCacheModInput ci;
+				ci.inputType = (int32_t)infos[j]->inputType;
+				ci.inputPreset = (int32_t)infos[j]->inputPreset;
+				ci.ctrlType = (int32_t)infos[j]->ctrlType;
+				ci.inputPort = infos[j]->inputPort;
+				ci.inputNativeValueMin = infos[j]->inputNativeValueMin;
+				ci.inputNativeValueMax = infos[j]->inputNativeValueMax;
+				modInputs.push_back(ci);
+			}
+			cm.inputCount = (uint32_t)modInputs.size() - cm.inputStart;
+
+			mods.push_back(cm);
+		}
+
+		cr.genCount = (uint32_t)gens.size() - cr.genStart;
+		cr.modCount = (uint32_t)mods.size() - cr.modStart;
+		regions.push_back(cr);
+	}
+
+	uint32_t SoundFontCache::WriteName(const string& name)
+	{
+		uint32_t offset = (uint32_t)names.size();
+		names.insert(names.end(), name.begin(), name.end());
+		return offset;
+	}
+}
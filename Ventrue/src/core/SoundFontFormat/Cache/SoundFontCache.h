@@ -0,0 +1,180 @@
+﻿#ifndef _SoundFontCache_h_
+#define _SoundFontCache_h_
+
+#include"Synth/VentrueTypes.h"
+#include"Synth/SoundFontParser.h"
+#include"scutils/MappedFile.h"
+
+namespace ventrue
+{
+	//缓存文件格式版本，结构变化时需要递增
+#define SFCACHE_VERSION 1
+
+	//缓存文件中所有偏移都是相对于文件起始位置的字节偏移，所有引用都是表内索引，
+	//因此文件与加载地址无关，可直接内存映射使用
+#pragma pack(push, 4)
+	struct SFCacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t endianTag;
+		uint64_t fileSize;
+
+		uint32_t sampleCount;
+		uint32_t instCount;
+		uint32_t presetCount;
+		uint32_t regionCount;
+		uint32_t genCount;
+		uint32_t modCount;
+		uint32_t modInputCount;
+		uint32_t nameSize;
+
+		uint64_t sampleOffset;
+		uint64_t instOffset;
+		uint64_t presetOffset;
+		uint64_t regionOffset;
+		uint64_t genOffset;
+		uint64_t modOffset;
+		uint64_t modInputOffset;
+		uint64_t nameOffset;
+		uint64_t pcmOffset;
+	};
+
+	struct SFCacheSample
+	{
+		uint32_t nameOffset;
+		uint32_t nameLen;
+		uint64_t pcmOffset;
+		uint64_t size;
+		float sampleRate;
+		float originalPitch;
+		float centPitchCorrection;
+		float velocity;
+		int32_t sampleType;
+		int32_t sampleLink;
+		int32_t startIdx;
+		int32_t endIdx;
+		int32_t startloopIdx;
+		int32_t endloopIdx;
+	};
+
+	struct SFCacheRegion
+	{
+		//关联的样本(乐器区域)或乐器(预设区域)索引, -1:全局区域
+		int32_t linkIdx;
+		uint32_t genStart;
+		uint32_t genCount;
+		uint32_t modStart;
+		uint32_t modCount;
+	};
+
+	struct SFCacheInstrument
+	{
+		uint32_t nameOffset;
+		uint32_t nameLen;
+		//区域起始索引，第一个为全局区域
+		uint32_t regionStart;
+		uint32_t regionCount;
+	};
+
+	struct SFCachePreset
+	{
+		uint32_t nameOffset;
+		uint32_t nameLen;
+		int32_t bankSelectMSB;
+		int32_t bankSelectLSB;
+		int32_t instrumentNum;
+		//区域起始索引，第一个为全局区域
+		uint32_t regionStart;
+		uint32_t regionCount;
+	};
+
+	struct SFCacheGenerator
+	{
+		int32_t type;
+		float low;
+		float high;
+	};
+
+	struct SFCacheModulator
+	{
+		int32_t type;
+		int32_t outGenType;
+		//输出目标调制器在所在区域调制器中的索引, -1:输出到生成器
+		int32_t outModIdx;
+		int32_t outModPort;
+		int32_t absType;
+		int32_t modulationType;
+		int32_t sourceTransType[2];
+		int32_t dir[2];
+		int32_t polar[2];
+		float inValueRange[2][2];
+		float outValueRange[2][2];
+		float amount;
+		uint32_t inputStart;
+		uint32_t inputCount;
+	};
+
+	struct SFCacheModInput
+	{
+		int32_t inputType;
+		int32_t inputPreset;
+		int32_t ctrlType;
+		int32_t inputPort;
+		float inputNativeValueMin;
+		float inputNativeValueMax;
+	};
+#pragma pack(pop)
+
+	/*
+	* 预编译音源缓存
+	* 把已解析完成的样本(解码后的浮点pcm)，乐器，预设，区域的生成器和调制器导出为一个二进制文件，
+	* 加载时直接内存映射此文件，样本pcm直接指向映射内存，无需再次解析和转换
+	* by cymheart, 2020--2021.
+	*/
+	class SoundFontCache :public SoundFontParser
+	{
+	public:
+		SoundFontCache(Ventrue* ventrue)
+			:SoundFontParser(ventrue)
+		{
+		}
+
+		~SoundFontCache();
+
+		//加载缓存文件到ventrue
+		void Parse(string filePath);
+
+		SoundFontParser* NewInstance(Ventrue* ventrue)
+		{
+			return new SoundFontCache(ventrue);
+		}
+
+		//保存ventrue当前已加载的音源到缓存文件
+		bool Save(string filePath);
+
+	private:
+		bool CheckHeader(const SFCacheHeader* header, size_t fileSize);
+		bool CheckEntries(const SFCacheHeader* header, size_t fileSize);
+
+		void WriteRegion(Region* region, int32_t linkIdx);
+		void ReadRegion(Region* region, const SFCacheRegion& cacheRegion);
+		uint32_t WriteName(const string& name);
+
+	private:
+		//已映射的缓存文件，样本pcm直接引用其内存，需在样本释放后才能关闭
+		vector<MappedFile*> mappedFiles;
+
+		//导出时的临时表
+		vector<SFCacheRegion> regions;
+		vector<SFCacheGenerator> gens;
+		vector<SFCacheModulator> mods;
+		vector<SFCacheModInput> modInputs;
+		vector<char> names;
+
+		//加载时的映射数据
+		const uint8_t* data = nullptr;
+	};
+}
+
+#endif
@@ -7,16 +7,28 @@
 #include"Synth/Generator.h"
 #include"Synth/UnitTransform.h"
 #include"Synth/Modulator.h"
+#include"Synth/SampleStore.h"
 
 namespace ventrue
 {
+	SF2Parser::~SF2Parser()
+	{
+		DEL(sampleJobs);
+		DEL(sf2);
+	}
+
 	void SF2Parser::Parse(string filePath)
 	{
 		DEL(sf2);
 		sf2 = new SF2(filePath);
+
+		//样本数据在工作线程中转换，同时在当前线程中建立乐器和预设的区域结构
 		ParseSampleList();
 		ParseInstrumentList();
 		ParsePresetList();
+
+		sampleJobs->Wait();
+		sampleJobList.clear();
 	}
 
 	//解析样本列表    
@@ -40,6 +52,7 @@ namespace ventrue
 		vector<Sample*> sampleLink;
 		struct Info { int linkIdx; Sample* sample; Info(int idx, Sample* s) { linkIdx = idx; sample = s; } };
 		vector<Info> sampleLinkInfo;
+		sampleJobList.clear();
 
 		for (int i = 0; i < samples.size(); i++)
 		{
@@ -49,9 +62,11 @@ namespace ventrue
 			uint32_t start = samples[i]->Start;
 			uint32_t end = samples[i]->End;
 			pcm = smpls + start;
-			if (sm24) { pcmSM24 = sm24 + i; }
+			if (sm24) { pcmSM24 = sm24 + start; }
+
+			Sample* oreSample = ventrue->AddSample(name, soundFont);
+			sampleJobList.push_back({ oreSample, pcm, end - start + 1, pcmSM24 });
 
-			Sample* oreSample = ventrue->AddSample(name, pcm, end - start + 1, pcmSM24);
 			oreSample->startIdx = 0;
 			oreSample->endIdx = end - start;
 			oreSample->startloopIdx = samples[i]->LoopStart - start;
@@ -80,12 +95,21 @@ namespace ventrue
 		}
 
 
-		SampleList& sampleList = *ventrue->GetSampleList();
+		SampleList& sampleList = *ventrue->GetSampleList(soundFont);
 
 		for (int i = 0; i < sampleLinkInfo.size(); i++)
 		{
 			sampleLinkInfo[i].sample->SetSampleLink(sampleList[sampleLinkInfo[i].linkIdx]);
 		}
+
+		sampleJobs->Start(sampleJobList.size(), [this](size_t idx) { ConvertSample(idx); });
+	}
+
+	//转换样本数据(在工作线程中执行)
+	void SF2Parser::ConvertSample(size_t idx)
+	{
+		SampleJob& job = sampleJobList[idx];
+		ventrue->GetLoadSampleStore(soundFont)->SetSamples(job.sample, job.pcm, job.size, job.sm24);
 	}
 
 
@@ -110,7 +134,7 @@ namespace ventrue
 		for (size_t i = 0; i < insts.size() - 1; i++)
 		{
 			name.assign((const char*)insts[i]->instrumentName, 20);
-			Instrument* oreInst = ventrue->AddInstrument(name);
+			Instrument* oreInst = ventrue->AddInstrument(name, soundFont);
 
 			for (size_t j = insts[i]->InstrumentBagIndex; j < insts[i + 1]->InstrumentBagIndex; j++)
 			{
@@ -131,7 +155,7 @@ namespace ventrue
 		//sf区域列表
 		vector<SF2Bag*>& bags = sf2->hydraChunk->ibagSubChunk->bags;
 		vector<SF2GeneratorList*>& gens = sf2->hydraChunk->igenSubChunk->generators;
-		SampleList& sampleList = *ventrue->GetSampleList();
+		SampleList& sampleList = *ventrue->GetSampleList(soundFont);
 		Region* region;
 
 		int genStart = bags[bagIdx]->GeneratorIndex;
@@ -198,7 +222,7 @@ namespace ventrue
 		for (size_t i = 0; i < presets.size() - 1; i++)
 		{
 			name.assign((const char*)presets[i]->presetName, 20);
-			Preset* orePreset = ventrue->AddPreset(name, presets[i]->Bank, 0, presets[i]->Preset);
+			Preset* orePreset = ventrue->AddPreset(name, presets[i]->Bank, 0, presets[i]->Preset, soundFont);
 
 			if (i + 1 >= presets.size())
 				break;
@@ -223,7 +247,7 @@ namespace ventrue
 		//sf区域列表
 		vector<SF2Bag*>& bags = sf2->hydraChunk->pbagSubChunk->bags;
 		vector<SF2GeneratorList*>& gens = sf2->hydraChunk->pgenSubChunk->generators;
-		InstrumentList& instList = *ventrue->GetInstrumentList();
+		InstrumentList& instList = *ventrue->GetInstrumentList(soundFont);
 
 		Region* region;
 
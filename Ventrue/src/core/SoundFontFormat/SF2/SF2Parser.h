@@ -4,6 +4,7 @@
 #include"SF2.h"
 #include"Synth/VentrueTypes.h"
 #include"Synth/SoundFontParser.h"
+#include"scutils/ParallelJobs.h"
 
 namespace ventrue
 {
@@ -13,13 +14,24 @@ namespace ventrue
 		SF2Parser(Ventrue* ventrue)
 			:SoundFontParser(ventrue)
 		{
+			sampleJobs = new ParallelJobs();
 		}
 
+		~SF2Parser();
+
 		void Parse(string filePath);
+
+		SoundFontParser* NewInstance(Ventrue* ventrue)
+		{
+			return new SF2Parser(ventrue);
+		}
+
 	private:
 
 		//解析样本列表    
 		void ParseSampleList();
+		//转换样本数据(在工作线程中执行)
+		void ConvertSample(size_t idx);
 
 		//解析乐器列表    
 		void ParseInstrumentList();
@@ -43,7 +55,20 @@ namespace ventrue
 		void ReplaceRegionPrevSameModulator(Modulator* modulator, Region* region);
 
 	private:
+		struct SampleJob
+		{
+			Sample* sample;
+			short* pcm;
+			uint32_t size;
+			byte* sm24;
+		};
+
 		SF2* sf2 = nullptr;
+
+		//样本数据转换任务，与乐器预设的解析同时进行
+		ParallelJobs* sampleJobs = nullptr;
+		vector<SampleJob> sampleJobList;
+
 		Modulator** modulators = nullptr;
 		size_t modulatorCount = 0;
 	};
@@ -7,6 +7,8 @@
 #include"SoundFormat/Wav/WavReader.h"
 #include <Synth\UnitTransform.h>
 #include"Synth/Ventrue.h"
+#include"Synth/SampleStore.h"
+#include"scutils/ParallelJobs.h"
 
 namespace ventrue
 {
@@ -70,6 +72,44 @@ namespace ventrue
 	}
 
 
+	//设置流式样本
+	//只转换开头和循环起始处的preloadFrames个采样点，其余部分在发声时由SampleStreamer从wav文件中读取
+	static void SetStreamSample(SampleLoadInfo& info, uint32_t preloadFrames)
+	{
+		WavReader& wav = *info.wavReader;
+		Sample* sample = info.sample;
+		uint32_t size = (uint32_t)wav.GetDataSize();
+
+		SampleStreamSource* source = new SampleStreamSource();
+		source->filePath = info.filePath;
+		source->dataOffset = wav.GetDataOffset();
+		source->blockAlign = wav.GetBlockAlign();
+		source->bitsPerSample = wav.GetBitsPerSample();
+		source->isFloat = wav.IsFloat();
+		source->scale = 0.7f;
+
+		float* head = (float*)malloc(preloadFrames * sizeof(float));
+		wav.ReadChannel(0, 0, preloadFrames, head, source->scale);
+
+		//循环回跳后的数据也需要常驻内存，以便I/O线程有足够的时间重新读取后续数据
+		float* loopHead = nullptr;
+		uint32_t loopHeadStart = 0;
+		uint32_t loopHeadSize = 0;
+		if (sample->endloopIdx > sample->startloopIdx && sample->startloopIdx >= 0)
+		{
+			uint32_t loopHeadEnd = min((uint32_t)sample->startloopIdx + preloadFrames, size);
+			loopHeadStart = max((uint32_t)sample->startloopIdx, preloadFrames);
+			if (loopHeadEnd > loopHeadStart)
+			{
+				loopHeadSize = loopHeadEnd - loopHeadStart;
+				loopHead = (float*)malloc(loopHeadSize * sizeof(float));
+				wav.ReadChannel(0, loopHeadStart, loopHeadSize, loopHead, source->scale);
+			}
+		}
+
+		sample->SetStreamHead(size, head, preloadFrames, loopHead, loopHeadStart, loopHeadSize, source);
+	}
+
 	/// <summary>  
 	/// 解析样本列表    
 	/// </summary>      
@@ -87,11 +127,10 @@ namespace ventrue
 
 		XMLElement* xmlSample = xmlSampleList->FirstChildElement("Sample");
 
-		//
-		WavReader wavReader;
-
+		//第一步:收集所有样本的描述信息
 		struct Info { string link; Sample* sample; Info(string l, Sample* s) { link = l; sample = s; } };
 		vector<Info> sampleLinkList;
+		vector<SampleLoadInfo> loadInfos;
 		string name;
 		string file;
 
@@ -115,13 +154,36 @@ namespace ventrue
 					file.assign(name);
 			}
 
+			SampleLoadInfo info;
+			info.name = name;
+			info.filePath = pathRoot + path + file + ".wav";
+			info.xmlSample = xmlSample;
+			loadInfos.push_back(info);
+		}
 
-			wavReader.ReadWavFile(pathRoot + path + file + ".wav");
-			short* pcm = wavReader.GetLeftChannelData();
-			if (pcm == nullptr)
+		//第二步:并行打开所有wav文件
+		ParallelJobs jobs;
+		jobs.Start(loadInfos.size(), [&loadInfos](size_t idx) {
+			SampleLoadInfo& info = loadInfos[idx];
+			info.wavReader = new WavReader();
+			if (!info.wavReader->Open(info.filePath))
+				DEL(info.wavReader);
+			});
+		jobs.Wait();
+
+		//第三步:按顺序生成样本，并设置样本信息
+		for (int i = 0; i < loadInfos.size(); i++)
+		{
+			SampleLoadInfo& info = loadInfos[i];
+			if (info.wavReader == nullptr)
 				continue;
 
-			Sample* sample = ventrue->AddSample(name, pcm, wavReader.GetDataSize());
+			Sample* sample = ventrue->AddSample(info.name, soundFont);
+			sample->size = info.wavReader->GetDataSize();
+			sample->sampleRate = (float)info.wavReader->GetSamplesRate();
+			info.sample = sample;
+
+			XMLElement* xmlSample = info.xmlSample;
 			XMLElement* childElem = xmlSample->FirstChildElement(); //取得子节点集合
 
 			for (; childElem; childElem = childElem->NextSiblingElement())
@@ -202,17 +264,63 @@ namespace ventrue
 				}
 			}
 
-
 			if (sample->endIdx == 0)
 				sample->endIdx = (int)sample->size - 1;
 
 			if (sample->endloopIdx == 0)
 				sample->endloopIdx = sample->endIdx;
-
 		}
 
+		//第四步:并行从映射内存中转换样本数据
+		SampleStore* sampleStore = ventrue->GetLoadSampleStore(soundFont);
+		//共享音源不使用流式播放
+		uint32_t streamPreloadFrames = 0;
+		if (ventrue->IsSampleStreaming() && soundFont == nullptr)
+			streamPreloadFrames = ventrue->GetSampleStreamPreloadFrames();
+		jobs.Start(loadInfos.size(), [&loadInfos, sampleStore, streamPreloadFrames](size_t idx) {
+			SampleLoadInfo& info = loadInfos[idx];
+			if (info.wavReader == nullptr)
+				return;
+
+			WavReader& wav = *info.wavReader;
+			Sample* sample = info.sample;
+			uint32_t size = (uint32_t)wav.GetDataSize();
+
+			//大样本只转换常驻内存的部分，其余在发声时从文件流式读取
+			if (streamPreloadFrames > 0 && size > streamPreloadFrames * 2)
+			{
+				SetStreamSample(info, streamPreloadFrames);
+				DEL(info.wavReader);
+				return;
+			}
+
+			if (wav.GetBitsPerSample() == 16 && !wav.IsFloat())
+			{
+				//16位单声道数据直接使用映射内存，其它情况先取出左声道
+				const short* pcm16 = wav.GetMappedPcm16();
+				if (pcm16 != nullptr)
+				{
+					sampleStore->SetSamples(sample, (short*)pcm16, size);
+				}
+				else
+				{
+					vector<short> left(size);
+					wav.ReadChannel(0, left.data());
+					sampleStore->SetSamples(sample, left.data(), size);
+				}
+			}
+			else
+			{
+				//非16位数据直接转换为浮点pcm，不经过样本存储的按需解码
+				wav.ReadChannel(0, sample->AllocPcm(size), 0.7f);
+			}
+
+			DEL(info.wavReader);
+			});
+		jobs.Wait();
+
 		//
-		SampleList& sampleList = *(ventrue->GetSampleList());
+		SampleList& sampleList = *(ventrue->GetSampleList(soundFont));
 
 		for (int i = 0; i < sampleLinkList.size(); i++)
 		{
@@ -220,7 +328,7 @@ namespace ventrue
 			{
 				if (sampleList[j]->name == sampleLinkList[i].link)
 				{
-					sampleLinkList[i].sample->SetSampleLink(sampleList[i]);
+					sampleLinkList[i].sample->SetSampleLink(sampleList[j]);
 				}
 			}
 		}
@@ -231,7 +339,7 @@ namespace ventrue
 	/// </summary>
 	void VentrueFont::ParseInstrumentList()
 	{
-		SampleList& sampleList = *(ventrue->GetSampleList());
+		SampleList& sampleList = *(ventrue->GetSampleList(soundFont));
 		XMLElement* xmlInstrumentList = xmlDoc->FirstChildElement("Ventrue")->FirstChildElement("InstrumentList"); //取得InstrumentList
 		if (xmlInstrumentList == nullptr)
 			return;
@@ -241,7 +349,7 @@ namespace ventrue
 		for (; xmlInstrument; xmlInstrument = xmlInstrument->NextSiblingElement())
 		{
 			string name(xmlInstrument->FindAttribute("name")->Value());
-			Instrument* inst = ventrue->AddInstrument(name);
+			Instrument* inst = ventrue->AddInstrument(name, soundFont);
 			XMLElement* childRegionElem = xmlInstrument->FirstChildElement("Region"); //取得子节点集合
 
 			for (; childRegionElem; childRegionElem = childRegionElem->NextSiblingElement("Region"))
@@ -278,7 +386,7 @@ namespace ventrue
 	/// </summary>
 	void VentrueFont::ParsePresetList()
 	{
-		InstrumentList& instList = *(ventrue->GetInstrumentList());
+		InstrumentList& instList = *(ventrue->GetInstrumentList(soundFont));
 
 		XMLElement* xmlPresetList = xmlDoc->FirstChildElement("Ventrue")->FirstChildElement("PresetList"); //取得PresetList
 		if (xmlPresetList == nullptr)
@@ -296,7 +404,7 @@ namespace ventrue
 			xmlPreset->FindAttribute("bankMSB")->QueryIntValue(&bankMSB);
 			xmlPreset->FindAttribute("bankLSB")->QueryIntValue(&bankLSB);
 			xmlPreset->FindAttribute("InstNum")->QueryIntValue(&instNum);
-			Preset* preset = ventrue->AddPreset(name, bankMSB, bankLSB, instNum);
+			Preset* preset = ventrue->AddPreset(name, bankMSB, bankLSB, instNum, soundFont);
 
 			XMLElement* childRegionElem = xmlPreset->FirstChildElement("Region"); //取得子节点集合
 
@@ -17,6 +17,18 @@ namespace ventrue
         UnitType_Polyphone
     };
 
+    class WavReader;
+
+    //样本加载信息
+    struct SampleLoadInfo
+    {
+        string name;
+        string filePath;
+        tinyxml2::XMLElement* xmlSample = nullptr;
+        WavReader* wavReader = nullptr;
+        Sample* sample = nullptr;
+    };
+
     class VentrueFont :public SoundFontParser
     {
     public:
@@ -31,6 +43,11 @@ namespace ventrue
         /// </summary>
         void Parse(string filePath);
 
+        SoundFontParser* NewInstance(Ventrue* ventrue)
+        {
+            return new VentrueFont(ventrue);
+        }
+
     private:
         /// <summary>
         /// 解析单位类型
@@ -1,11 +1,25 @@
 ﻿#include "WavReader.h"
-#include "scutils\ByteStream.h"
 
 namespace ventrue
 {
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+    static inline uint32_t ReadU32(const uint8_t* p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline uint16_t ReadU16(const uint8_t* p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
     WavReader::~WavReader()
     {
         DeleteData();
+        Close();
     }
 
     void WavReader::DeleteData()
@@ -14,159 +28,244 @@ namespace ventrue
         DEL_ARRAY(rightChannelData);
     }
 
-    // 读取波形文件并显示
+    // 读取wav文件到左右声道的16位数据中
     void WavReader::ReadWavFile(string filePath)
     {
-        if (filePath == "")
-            return;
-
-        DEL_ARRAY(leftChannelData);
-        DEL_ARRAY(rightChannelData);
-
-        std::ifstream t;
-        size_t length;
-        char* buffer;
+        DeleteData();
 
-        try
-        {
-            t.open(filePath, ios::in | ios::binary);
-            t.seekg(0, std::ios::end);
-            length = t.tellg();
-            t.seekg(0, std::ios::beg);
-            buffer = new char[length];
-            t.read(buffer, length);   
-        }
-        catch (exception)
+        if (!Open(filePath))
         {
-            t.close();
             cout << filePath << "文件打开出错!" << endl;
             return;
         }
-   
- 
-        ByteStream br(buffer, length);
-        delete[] buffer;
-        byte id[4];
-        byte size[4];
-        byte type[4];
-
-        byte formatid[4];
-        byte formatsize[4];
-        byte formattag[2];
-        byte numchannels[2];
-        byte samplespersec[4];
-        byte avgbytespersec[4];
-        byte blockalign[2];
-        byte bitspersample[2];
-        byte additionalinfo[2];    //可选
-
-        byte datasize[4];
 
-        //RIFF WAVE Chunk
-        br.read(id, 0, 4);
-        br.read(size, 0, 4);
-        br.read(type, 0, 4);
-
-        Id.assign((const char*)id, 4);
-        Size = bytArray2Int(size);//十六进制转为十进制
-        Type.assign((const char*)type, 4);
-
-
-        //Format Chunk
-        br.read(formatid, 0, 4);
-        br.read(formatsize, 0, 4);
-        br.read(formattag, 0, 2);
-        br.read(numchannels, 0, 2);
-        br.read(samplespersec, 0, 4);
-        br.read(avgbytespersec, 0, 4);
-        br.read(blockalign, 0, 2);
-        br.read(bitspersample, 0, 2);
-
-        string formatStr((const char*)formatsize, 2);
-        if (formatStr == "18")
+        leftChannelData = new short[frameCount];
+        ReadChannel(0, leftChannelData);
+
+        if (num_Channels == 2)
         {
-            br.read(additionalinfo, 0, 2);
-            additionalInfo.assign((const char*)additionalinfo, 2);  //附加信息
+            rightChannelData = new short[frameCount];
+            ReadChannel(1, rightChannelData);
         }
 
-        formatId.assign((const char*)formatid, 4);
-        formatSize = bytArray2Int(formatsize);
-
-        byte fourByte[4] = { formattag[0], formattag[1] };
-        formatTag = bytArray2Int(fourByte);
+        Close();
+    }
 
-        fourByte[0] = numchannels[0]; fourByte[1] = numchannels[1];
-        num_Channels = bytArray2Int(fourByte);                    //声道数目，1--单声道；2--双声道
-        SamplesPerSec = bytArray2Int(samplespersec);            //采样率
-        AvgBytesPerSec = bytArray2Int(avgbytespersec);          //每秒所需字节数   
+    //以内存映射方式打开wav文件，并解析格式信息
+    bool WavReader::Open(string filePath)
+    {
+        Close();
+        frameCount = 0;
+        dataSize = 0;
+        isFloat = false;
 
-        fourByte[0] = blockalign[0]; fourByte[1] = blockalign[1];
-        BlockAlign = bytArray2Int(fourByte);                        //数据块对齐单位(每个采样需要的字节数)
+        if (filePath == "")
+            return false;
 
-        fourByte[0] = bitspersample[0]; fourByte[1] = bitspersample[1];
-        BitsPerSample = bytArray2Int(fourByte);        // 每个采样需要的bit数     
+        mappedFile = new MappedFile();
+        if (!mappedFile->Open(filePath)) {
+            Close();
+            return false;
+        }
 
-        // Data Chunk  
-        byte d_flag;
+        const uint8_t* buf = mappedFile->GetData();
+        size_t len = mappedFile->GetSize();
 
-        while (true)
-        {
-            br.read(&d_flag, 0, 1);
-            if (d_flag == 'd')
-                break;
+        //RIFF WAVE Chunk
+        if (len < 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0) {
+            Close();
+            return false;
         }
 
-        byte dt_id[4];
-        dt_id[0] = d_flag;
-        br.read(dt_id, 1, 3);
-        dataId.assign((const char*)dt_id, 4);
-        br.read(datasize, 0, 4);
-        dataSize = bytArray2Int(datasize);
-
+        Id.assign((const char*)buf, 4);
+        Size = ReadU32(buf + 4);
+        Type.assign((const char*)buf + 8, 4);
 
-        if (BitsPerSample == 8)
+        //按块遍历，块大小为奇数时需补齐一个字节
+        bool hasFmt = false;
+        size_t pos = 12;
+        while (pos + 8 <= len)
         {
-            leftChannelData = new short[dataSize];
+            const uint8_t* chunk = buf + pos;
+            uint32_t chunkSize = ReadU32(chunk + 4);
+            const uint8_t* body = chunk + 8;
 
-            if (num_Channels == 2)
+            if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && pos + 8 + chunkSize <= len)
             {
-                rightChannelData = new short[dataSize];
+                formatId.assign((const char*)chunk, 4);
+                formatSize = (int)chunkSize;
+                formatTag = ReadU16(body);
+                num_Channels = ReadU16(body + 2);
+                SamplesPerSec = (int)ReadU32(body + 4);
+                AvgBytesPerSec = (int)ReadU32(body + 8);
+                BlockAlign = ReadU16(body + 12);
+                BitsPerSample = ReadU16(body + 14);
 
-                for (int i = 0; i < dataSize; i += 2)
-                {
-                    leftChannelData[i] = br.read<byte>();
-                    rightChannelData[i] = br.read<byte>();
-                }
+                if (chunkSize >= 18)
+                    additionalInfo.assign((const char*)body + 16, 2);
+
+                //扩展格式的实际格式在子格式GUID的前两个字节
+                if (formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 40)
+                    formatTag = ReadU16(body + 24);
+
+                isFloat = (formatTag == WAVE_FORMAT_IEEE_FLOAT);
+                hasFmt = true;
             }
-            else
+            else if (memcmp(chunk, "data", 4) == 0)
             {
-                for (int i = 0; i < dataSize; i++)
-                {
-                    leftChannelData[i] = br.read<byte>();
-                }
+                dataId.assign((const char*)chunk, 4);
+                dataSize = chunkSize;
+                if (pos + 8 + dataSize > len)
+                    dataSize = len - pos - 8;
+                data = body;
+                break;
             }
+
+            pos += 8 + chunkSize + (chunkSize & 1);
         }
-        else if (BitsPerSample == 16)
+
+        if (!hasFmt || data == nullptr || num_Channels <= 0 || BlockAlign <= 0 ||
+            (formatTag != WAVE_FORMAT_PCM && formatTag != WAVE_FORMAT_IEEE_FLOAT) ||
+            (isFloat && BitsPerSample != 32) ||
+            (!isFloat && BitsPerSample != 8 && BitsPerSample != 16 && BitsPerSample != 24 && BitsPerSample != 32) ||
+            BlockAlign < num_Channels * (BitsPerSample / 8))
         {
-            leftChannelData = new short[dataSize / 2];
+            Close();
+            return false;
+        }
 
-            if (num_Channels == 2)
-            {
-                rightChannelData = new short[dataSize / 2];
+        frameCount = dataSize / BlockAlign;
+        return true;
+    }
+
+    //关闭内存映射
+    void WavReader::Close()
+    {
+        DEL(mappedFile);
+        data = nullptr;
+    }
+
+    //16位单声道文件时，直接返回映射内存中的采样数据，否则返回nullptr
+    const short* WavReader::GetMappedPcm16()
+    {
+        if (data == nullptr || isFloat || BitsPerSample != 16 || num_Channels != 1)
+            return nullptr;
+
+        return (const short*)data;
+    }
 
-                for (int i = 0; i < dataSize / 2; i += 2)
-                {
-                    leftChannelData[i] = br.read<short>();
-                    rightChannelData[i] = br.read<short>();
-                }
+    //从映射内存中转换指定声道的数据到dst，满幅值映射为scale
+    void WavReader::ReadChannel(int channel, float* dst, float scale)
+    {
+        ReadChannel(channel, 0, frameCount, dst, scale);
+    }
+
+    //从映射内存中转换指定声道[start, start + count)范围的数据到dst
+    void WavReader::ReadChannel(int channel, size_t start, size_t count, float* dst, float scale)
+    {
+        if (data == nullptr || channel >= num_Channels || start >= frameCount)
+            return;
+
+        if (count > frameCount - start)
+            count = frameCount - start;
+
+        const uint8_t* src = data + start * BlockAlign + channel * (BitsPerSample / 8);
+        ConvertToFloat(src, count, BlockAlign, BitsPerSample, isFloat, dst, scale);
+    }
+
+    //转换交错排列的采样数据到浮点数据，src指向第一个帧中所需声道的位置，step为帧的字节数
+    void WavReader::ConvertToFloat(
+        const uint8_t* src, size_t count, int step,
+        int bitsPerSample, bool isFloat, float* dst, float scale)
+    {
+        if (isFloat)
+        {
+            float v;
+            for (size_t i = 0; i < count; i++, src += step) {
+                memcpy(&v, src, 4);
+                dst[i] = v * scale;
             }
-            else
-            {
-                for (int i = 0; i < dataSize / 2; i++)
-                {
-                    leftChannelData[i] = br.read<short>();
-                }
+            return;
+        }
+
+        switch (bitsPerSample)
+        {
+        case 8:
+        {
+            float mul = scale / 127.0f;
+            for (size_t i = 0; i < count; i++, src += step)
+                dst[i] = ((int)src[0] - 128) * mul;
+        }
+        break;
+
+        case 16:
+        {
+            float mul = scale / 32767.0f;
+            for (size_t i = 0; i < count; i++, src += step)
+                dst[i] = (int16_t)ReadU16(src) * mul;
+        }
+        break;
+
+        case 24:
+        {
+            float mul = scale / 8388607.0f;
+            for (size_t i = 0; i < count; i++, src += step)
+                dst[i] = ((int32_t)(src[0] << 8 | src[1] << 16 | (uint32_t)src[2] << 24) >> 8) * mul;
+        }
+        break;
+
+        case 32:
+        {
+            float mul = scale / 2147483647.0f;
+            for (size_t i = 0; i < count; i++, src += step)
+                dst[i] = (int32_t)ReadU32(src) * mul;
+        }
+        break;
+        }
+    }
+
+    //从映射内存中转换指定声道的数据到16位dst
+    void WavReader::ReadChannel(int channel, short* dst)
+    {
+        if (data == nullptr || channel >= num_Channels)
+            return;
+
+        int bytesPerSample = BitsPerSample / 8;
+        const uint8_t* src = data + channel * bytesPerSample;
+        size_t step = BlockAlign;
+
+        if (isFloat)
+        {
+            float v;
+            for (size_t i = 0; i < frameCount; i++, src += step) {
+                memcpy(&v, src, 4);
+                v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+                dst[i] = (short)(v * 32767.0f);
             }
+            return;
+        }
+
+        switch (BitsPerSample)
+        {
+        case 8:
+            for (size_t i = 0; i < frameCount; i++, src += step)
+                dst[i] = (short)(((int)src[0] - 128) << 8);
+            break;
+
+        case 16:
+            for (size_t i = 0; i < frameCount; i++, src += step)
+                dst[i] = (int16_t)ReadU16(src);
+            break;
+
+        case 24:
+            for (size_t i = 0; i < frameCount; i++, src += step)
+                dst[i] = (int16_t)ReadU16(src + 1);
+            break;
+
+        case 32:
+            for (size_t i = 0; i < frameCount; i++, src += step)
+                dst[i] = (int16_t)ReadU16(src + 2);
+            break;
         }
     }
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define _WavReader_h_
 
 #include"scutils/Utils.h"
+#include"scutils/MappedFile.h"
 #include <iostream>
 #include <fstream>
 
@@ -11,6 +12,11 @@ using namespace scutils;
 
 namespace ventrue
 {
+    /*
+    * wav文件读取
+    * 通过内存映射读取文件，支持8/16/24/32位整数PCM和32位浮点格式
+    * Open()之后可直接从映射内存转换出各声道数据，不经过中间缓存
+    */
     class WavReader
     {
 
@@ -32,6 +38,22 @@ namespace ventrue
             return SamplesPerSec;
         }
 
+        /// <summary>
+        /// 获取每个采样的位数
+        /// </summary>
+        int GetBitsPerSample()
+        {
+            return BitsPerSample;
+        }
+
+        /// <summary>
+        /// 是否为浮点格式
+        /// </summary>
+        bool IsFloat()
+        {
+            return isFloat;
+        }
+
         /// <summary>
         /// 获取PCM数据
         /// </summary>
@@ -41,11 +63,12 @@ namespace ventrue
             return leftChannelData;
         }
 
+        /// <summary>
+        /// 获取每个声道的采样点数
+        /// </summary>
         size_t GetDataSize()
         {
-            if (BitsPerSample != 8)
-                return dataSize / 2;   
-            return dataSize;
+            return frameCount;
         }
 
         /// <summary>
@@ -76,10 +99,46 @@ namespace ventrue
             return bytArray[0] | (bytArray[1] << 8) | (bytArray[2] << 16) | (bytArray[3] << 24);
         }
 
+        //读取wav文件到左右声道的16位数据中
         void ReadWavFile(string filePath);
 
         void DeleteData();
 
+        //以内存映射方式打开wav文件，并解析格式信息
+        bool Open(string filePath);
+
+        //关闭内存映射
+        void Close();
+
+        //16位单声道文件时，直接返回映射内存中的采样数据，否则返回nullptr
+        const short* GetMappedPcm16();
+
+        //从映射内存中转换指定声道的数据到dst，满幅值映射为scale
+        void ReadChannel(int channel, float* dst, float scale = 1.0f);
+
+        //从映射内存中转换指定声道[start, start + count)范围的数据到dst
+        void ReadChannel(int channel, size_t start, size_t count, float* dst, float scale = 1.0f);
+
+        //从映射内存中转换指定声道的数据到16位dst
+        void ReadChannel(int channel, short* dst);
+
+        //获取数据块在文件中的字节偏移
+        uint64_t GetDataOffset()
+        {
+            return (data == nullptr ? 0 : (uint64_t)(data - mappedFile->GetData()));
+        }
+
+        //获取每帧的字节数
+        int GetBlockAlign()
+        {
+            return BlockAlign;
+        }
+
+        //转换交错排列的采样数据到浮点数据，src指向第一个帧中所需声道的位置，step为帧的字节数
+        static void ConvertToFloat(
+            const uint8_t* src, size_t count, int step,
+            int bitsPerSample, bool isFloat, float* dst, float scale = 1.0f);
+
     private:
         // RIFF WAVE Chunk    
         string Id; //文件标识
@@ -108,9 +167,16 @@ namespace ventrue
         short* leftChannelData =  nullptr;  //左单声道数据
         short* rightChannelData = nullptr;  //右单声道数据
 
+        //每声道采样点数
+        size_t frameCount = 0;
+        //是否为浮点格式
+        bool isFloat = false;
+
+        MappedFile* mappedFile = nullptr;
+        const uint8_t* data = nullptr;
 
     };
 
 }
 
-#endif
\ No newline at end of file
+#endif
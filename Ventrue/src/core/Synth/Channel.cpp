@@ -46,6 +46,40 @@ namespace ventrue
 			midiTrackRecord->RecordSetPitchBend(value, channelNum);
 	}
 
+	//保存乐器和控制器状态(包括滑音和RPN设置)
+	void Channel::SaveState(ChannelState& state)
+	{
+		state.bankMSB = bankMSB;
+		state.bankLSB = bankLSB;
+		state.programNum = programNum;
+		memcpy(state.ccValue, ccValue, sizeof(ccValue));
+		memcpy(state.ccCombValue, ccCombValue, sizeof(ccCombValue));
+		memcpy(state.ccComputedValue, ccComputedValue, sizeof(ccComputedValue));
+		state.pitchBend = pitchBend;
+		state.pitchBendRange = pitchBendRange;
+		state.fineTune = fineTune;
+		state.coarseTune = coarseTune;
+		state.usedControllerTypeList = usedControllerTypeList;
+		state.usedPresetTypeList = usedPresetTypeList;
+	}
+
+	//恢复乐器和控制器状态
+	void Channel::RestoreState(ChannelState& state)
+	{
+		bankMSB = state.bankMSB;
+		bankLSB = state.bankLSB;
+		programNum = state.programNum;
+		memcpy(ccValue, state.ccValue, sizeof(ccValue));
+		memcpy(ccCombValue, state.ccCombValue, sizeof(ccCombValue));
+		memcpy(ccComputedValue, state.ccComputedValue, sizeof(ccComputedValue));
+		pitchBend = state.pitchBend;
+		pitchBendRange = state.pitchBendRange;
+		fineTune = state.fineTune;
+		coarseTune = state.coarseTune;
+		usedControllerTypeList = state.usedControllerTypeList;
+		usedPresetTypeList = state.usedPresetTypeList;
+	}
+
 	//设置控制器值
 	//0~31(MSB) 和 32~64(LSB)成对出现
 	void Channel::SetControllerValue(MidiControllerType type, int value)
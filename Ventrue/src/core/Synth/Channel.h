@@ -7,6 +7,23 @@
 
 namespace ventrue
 {
+	// 通道的乐器和控制器状态
+	struct ChannelState
+	{
+		int bankMSB = 0;
+		int bankLSB = 0;
+		int programNum = 0;
+		int ccValue[128];
+		float ccCombValue[128];
+		float ccComputedValue[128];
+		float pitchBend = 0;
+		float pitchBendRange = 2;
+		float fineTune = 0;
+		float coarseTune = 0;
+		MidiControllerTypeList usedControllerTypeList;
+		ModPresetTypeList usedPresetTypeList;
+	};
+
 	class Channel
 	{
 
@@ -93,6 +110,12 @@ namespace ventrue
 			isDisablePlay = false;
 		}
 
+		//保存乐器和控制器状态(包括滑音和RPN设置)
+		void SaveState(ChannelState& state);
+
+		//恢复乐器和控制器状态
+		void RestoreState(ChannelState& state);
+
 	private:
 
 		void ComputeControllerHighResValue(int type);
@@ -17,6 +17,15 @@ namespace ventrue
 	void GeneratorList::Remove(GeneratorType type)
 	{
 		DEL(gens[(int)type]);
+		InvalidateRangeTable(type);
+	}
+
+	// KeyRange或VelRange改变时，使按键查找表失效
+	void GeneratorList::InvalidateRangeTable(GeneratorType type)
+	{
+		if (isBuildedRangeTable != nullptr &&
+			(type == GeneratorType::KeyRange || type == GeneratorType::VelRange))
+			*isBuildedRangeTable = false;
 	}
 
 	// 根据生成器类型，获取生成器数据范围值
@@ -60,6 +69,7 @@ namespace ventrue
 			gens[(int)type] = new Generator(type);
 
 		gens[(int)type]->genAmount.amount = 0;
+		InvalidateRangeTable(type);
 	}
 
 	// 根据生成器类型，设置生成器数据值
@@ -69,6 +79,7 @@ namespace ventrue
 			gens[(int)type] = new Generator(type);
 
 		gens[(int)type]->genAmount.amount = LimitValueRange(type, amount);
+		InvalidateRangeTable(type);
 	}
 
 	// 根据生成器类型，设置生成器数据范围值
@@ -80,6 +91,7 @@ namespace ventrue
 		RangeFloat rangeValue = LimitRangeValueRange(type, low, high);
 		gens[(int)type]->genAmount.rangeData.low = rangeValue.min;
 		gens[(int)type]->genAmount.rangeData.high = rangeValue.max;
+		InvalidateRangeTable(type);
 	}
 
 
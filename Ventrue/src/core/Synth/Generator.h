@@ -49,6 +49,12 @@ namespace ventrue
             this->type = type;
         }
 
+        // 设置按键查找表的建立标志，KeyRange或VelRange改变时标志被置为false
+        inline void SetRangeTableFlag(bool* isBuildedRangeTable)
+        {
+            this->isBuildedRangeTable = isBuildedRangeTable;
+        }
+
         // 根据生成器类型,判断此类型生成器是否为空值，从未设置过
         bool IsEmpty(GeneratorType type)
         {
@@ -92,9 +98,14 @@ namespace ventrue
         // 限制类型值的取值范围  
         RangeFloat LimitRangeValueRange(GeneratorType genType, float low, float high);
  
+    private:
+        // KeyRange或VelRange改变时，使按键查找表失效
+        void InvalidateRangeTable(GeneratorType type);
+
     private:
         Generator* gens[64] = {nullptr}; 
         RegionType type = RegionType::Insttrument;
+        bool* isBuildedRangeTable = nullptr;
 
     };
 }
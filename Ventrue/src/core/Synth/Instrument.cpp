@@ -1,4 +1,5 @@
 ﻿#include"Instrument.h"
+#include"Generator.h"
 namespace ventrue
 {
     Instrument::Instrument()
@@ -16,28 +17,68 @@ namespace ventrue
     Region* Instrument::LinkSamples(Sample* sample)
     {
         Region* instRegion = new Region(RegionType::Insttrument);
+        instRegion->GetGenList()->SetRangeTableFlag(&isBuildedKeyRegionTable);
         SamplesLinkToInstRegionInfo linkInfo;
         linkInfo.region = instRegion;
         linkInfo.linkSample = sample;
         instRegionLinkInfoList->push_back(linkInfo);
+
+        //区域发生变化，查找表需要重新建立
+        isBuildedKeyRegionTable = false;
         return instRegion;
     }
 
+    // 建立按键到乐器区域的查找表
+    void Instrument::BuildKeyRegionTable()
+    {
+        keyRegionIdxs.clear();
+
+        RangeFloat keyRange;
+        for (int key = 0; key < 128; key++)
+        {
+            keyRegionOffsets[key] = (int)keyRegionIdxs.size();
+            for (int i = 0; i < instRegionLinkInfoList->size(); i++)
+            {
+                keyRange = (*instRegionLinkInfoList)[i].region->GetKeyRange();
+                if (key >= keyRange.min && key <= keyRange.max)
+                    keyRegionIdxs.push_back(i);
+            }
+        }
+
+        keyRegionOffsets[128] = (int)keyRegionIdxs.size();
+        isBuildedKeyRegionTable = true;
+    }
+
     // 获取KeyNum在指定范围内的乐器区域组
     int Instrument::GetHavKeyInstRegionLinkInfos(int keyNum, float velocity, SamplesLinkToInstRegionInfo* activeInstRegionLinkInfos)
     {
         RangeFloat keyRange;
         RangeFloat velRange;
         int pos = 0;
-        for (int i = 0; i < instRegionLinkInfoList->size(); i++)
-        {
-            keyRange = (*instRegionLinkInfoList)[i].region->GetKeyRange();
-            velRange = (*instRegionLinkInfoList)[i].region->GetVelRange();
 
-            if (keyNum >= keyRange.min && keyNum <= keyRange.max &&
-                velocity >= velRange.min && velocity <= velRange.max)
+        //使用查找表时只需判断力度范围
+        if (isBuildedKeyRegionTable && keyNum >= 0 && keyNum < 128)
+        {
+            for (int j = keyRegionOffsets[keyNum]; j < keyRegionOffsets[keyNum + 1]; j++)
             {
-                activeInstRegionLinkInfos[pos++] = (*instRegionLinkInfoList)[i];
+                SamplesLinkToInstRegionInfo& linkInfo = (*instRegionLinkInfoList)[keyRegionIdxs[j]];
+                velRange = linkInfo.region->GetVelRange();
+                if (velocity >= velRange.min && velocity <= velRange.max)
+                    activeInstRegionLinkInfos[pos++] = linkInfo;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < instRegionLinkInfoList->size(); i++)
+            {
+                keyRange = (*instRegionLinkInfoList)[i].region->GetKeyRange();
+                velRange = (*instRegionLinkInfoList)[i].region->GetVelRange();
+
+                if (keyNum >= keyRange.min && keyNum <= keyRange.max &&
+                    velocity >= velRange.min && velocity <= velRange.max)
+                {
+                    activeInstRegionLinkInfos[pos++] = (*instRegionLinkInfoList)[i];
+                }
             }
         }
 
@@ -21,8 +21,23 @@ namespace ventrue
         // 连接一个样本到一个instRegion
         Region* LinkSamples(Sample* sample);
 
+        // 建立按键到乐器区域的查找表(区域的按键范围设置完成后调用)
+        void BuildKeyRegionTable();
+
+        // 是否已建立按键查找表
+        inline bool IsBuildedKeyRegionTable()
+        {
+            return isBuildedKeyRegionTable;
+        }
+
         // 获取KeyNum在指定范围内的乐器区域组
         int GetHavKeyInstRegionLinkInfos(int keyNum, float velocity, SamplesLinkToInstRegionInfo* activeInstRegionLinkInfos);
+
+        // 获取乐器区域关联信息列表
+        SamplesLinkToInstRegionInfoList* GetInstRegionLinkInfoList()
+        {
+            return instRegionLinkInfoList;
+        }
        
     public:
         string name;
@@ -32,6 +47,11 @@ namespace ventrue
         Region* globalRegion;
         SamplesLinkToInstRegionInfoList* instRegionLinkInfoList;
 
+        // 按键查找表: 按键key对应的区域序号为keyRegionIdxs[keyRegionOffsets[key], keyRegionOffsets[key + 1])
+        bool isBuildedKeyRegionTable = false;
+        int keyRegionOffsets[129] = { 0 };
+        vector<int> keyRegionIdxs;
+
     };
 }
 
@@ -4,6 +4,7 @@
 #include"Instrument.h"
 #include"Ventrue.h"
 #include"VirInstrument.h"
+#include"SoundFont.h"
 
 namespace ventrue
 {
@@ -14,6 +15,9 @@ namespace ventrue
 
 	KeySounder::~KeySounder()
 	{
+		if (soundFont != nullptr)
+			soundFont->ReleaseVoiceRef();
+
 		DEL_OBJS_VECTOR(regionSounderList);
 	}
 
@@ -33,6 +37,7 @@ namespace ventrue
 		isSoundEnd = false;
 		virInst = nullptr;
 		isForceOffKey = false;
+		soundFont = nullptr;
 	}
 
 	void KeySounder::Release()
@@ -44,6 +49,11 @@ namespace ventrue
 		}
 		regionSounderList->clear();
 
+		if (soundFont != nullptr) {
+			soundFont->ReleaseVoiceRef();
+			soundFont = nullptr;
+		}
+
 		VentruePool::GetInstance().KeySounderPool().Push(this);
 	}
 
@@ -206,6 +216,13 @@ namespace ventrue
 	{
 		Preset* preset = virInst->GetPreset();
 		InstLinkToPresetRegionInfoList* presetRegionLinkInfoList = preset->GetPresetRegionLinkInfoList();
+
+		//在发声结束前，所使用的音源不能被释放
+		if (soundFont == nullptr && preset->soundFont != nullptr) {
+			soundFont = preset->soundFont;
+			soundFont->AddVoiceRef();
+		}
+
 		Region* activeInstRegion;
 		Instrument* inst;
 		Region* presetRegion;
@@ -239,6 +256,10 @@ namespace ventrue
 					activeInstRegion, inst->GetGlobalRegion(),
 					(*presetRegionLinkInfoList)[i].region, preset->GetGlobalRegion());
 
+				//样本尚未解码的区域不发声
+				if (regionSounder == nullptr)
+					continue;
+
 				regionSounderList->push_back(regionSounder);
 			}
 		}
@@ -256,7 +277,12 @@ namespace ventrue
 		regionSounder->instGlobalRegion = activeInstGlobalRegion;
 		regionSounder->presetRegion = activePresetRegion;
 		regionSounder->presetGlobalRegion = activePresetGlobalRegion;
-		regionSounder->SetSample(sample);
+		if (!regionSounder->SetSample(sample))
+		{
+			regionSounder->Release();
+			return nullptr;
+		}
+
 		regionSounder->Init();
 
 		return regionSounder;
@@ -174,6 +174,9 @@ namespace ventrue
 		//是否强制释放按键
 		bool isForceOffKey = false;
 
+		//发声所使用的音源(用于判断被替换的音源何时可以释放)
+		SoundFont* soundFont = nullptr;
+
 
 
 		RegionSounderList* regionSounderList = nullptr;
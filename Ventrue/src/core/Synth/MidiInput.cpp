@@ -0,0 +1,176 @@
+﻿#include"MidiInput.h"
+
+namespace ventrue
+{
+	static const uint8_t GM_RESET[] = { 0x7E, 0x7F, 0x09, 0x01 };
+	static const uint8_t GM2_RESET[] = { 0x7E, 0x7F, 0x09, 0x03 };
+	static const uint8_t GS_RESET[] = { 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41 };
+	static const uint8_t XG_RESET[] = { 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00 };
+
+	MidiInput::MidiInput(uint32_t queueSize)
+		:writePos(0)
+		, readPos(0)
+		, droppedCount(0)
+	{
+		uint32_t size = 1;
+		while (size < queueSize)
+			size <<= 1;
+
+		queueMask = size - 1;
+		queue = new MidiInputEvent[size];
+		pending = new MidiInputEvent[size];
+	}
+
+	MidiInput::~MidiInput()
+	{
+		DEL_ARRAY(queue);
+		DEL_ARRAY(pending);
+	}
+
+	// 解析midi字节流并写入队列
+	void MidiInput::Push(const uint8_t* data, size_t size, int sampleOffset)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			uint8_t value = data[i];
+
+			//实时消息可以出现在任何位置，不影响running status
+			if (value >= 0xF8)
+				continue;
+
+			if (value & 0x80)
+			{
+				if (value == 0xF0)
+				{
+					isInSysEx = true;
+					sysExSize = 0;
+					runningStatus = 0;
+					continue;
+				}
+
+				if (value == 0xF7)
+				{
+					if (isInSysEx)
+						PushSysEx(sampleOffset);
+					isInSysEx = false;
+					runningStatus = 0;
+					continue;
+				}
+
+				//其它状态字节会中断未结束的SysEx
+				isInSysEx = false;
+				dataCount = 0;
+
+				//系统公共消息清除running status, 且不需要处理
+				runningStatus = value < 0xF0 ? value : 0;
+				continue;
+			}
+
+			//数据字节
+			if (isInSysEx)
+			{
+				//只需要识别较短的复位消息，更长的SysEx不会被记录
+				if (sysExSize < sizeof(sysExBuf))
+					sysExBuf[sysExSize] = value;
+				sysExSize++;
+				continue;
+			}
+
+			if (runningStatus == 0)
+				continue;
+
+			dataBytes[dataCount++] = value;
+			if (dataCount < GetDataSize(runningStatus))
+				continue;
+
+			PushMessage(runningStatus, dataBytes[0], dataCount > 1 ? dataBytes[1] : 0, sampleOffset);
+			dataCount = 0;
+		}
+	}
+
+	// 获取通道消息的数据字节数量
+	int MidiInput::GetDataSize(uint8_t status)
+	{
+		switch (status & 0xF0)
+		{
+		case 0xC0: //ProgramChange
+		case 0xD0: //ChannelPressure
+			return 1;
+		default:
+			return 2;
+		}
+	}
+
+	// 处理一个完整的SysEx消息
+	void MidiInput::PushSysEx(int sampleOffset)
+	{
+		MidiInputSysExType type;
+		if (sysExSize == sizeof(GM_RESET) && memcmp(sysExBuf, GM_RESET, sysExSize) == 0)
+			type = MidiInputSysExType::GMReset;
+		else if (sysExSize == sizeof(GM2_RESET) && memcmp(sysExBuf, GM2_RESET, sysExSize) == 0)
+			type = MidiInputSysExType::GM2Reset;
+		else if (sysExSize == sizeof(GS_RESET) && memcmp(sysExBuf, GS_RESET, sysExSize) == 0)
+			type = MidiInputSysExType::GSReset;
+		else if (sysExSize == sizeof(XG_RESET) && memcmp(sysExBuf, XG_RESET, sysExSize) == 0)
+			type = MidiInputSysExType::XGReset;
+		else
+			return;
+
+		PushMessage(0xF0, (uint8_t)type, 0, sampleOffset);
+	}
+
+	// 处理一个完整的消息
+	void MidiInput::PushMessage(uint8_t status, uint8_t data1, uint8_t data2, int sampleOffset)
+	{
+		uint32_t pos = writePos.load(memory_order_relaxed);
+		if (pos - readPos.load(memory_order_acquire) > queueMask)
+		{
+			droppedCount.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+
+		MidiInputEvent& ev = queue[pos & queueMask];
+		ev.samplePos = sampleOffset < 0 ? 0 : sampleOffset;
+		ev.status = status;
+		ev.data1 = data1;
+		ev.data2 = data2;
+
+		writePos.store(pos + 1, memory_order_release);
+	}
+
+	// 渲染块开始时调用，取出队列中的消息并转换为渲染位置
+	void MidiInput::BeginBlock(int64_t blockStartPos)
+	{
+		uint32_t pos = readPos.load(memory_order_relaxed);
+		uint32_t end = writePos.load(memory_order_acquire);
+
+		for (; pos != end; pos++)
+		{
+			//等待处理的消息已满时，剩余消息留在队列中
+			if (pendingTail - pendingHead > queueMask)
+				break;
+
+			MidiInputEvent& ev = pending[pendingTail & queueMask];
+			ev = queue[pos & queueMask];
+			ev.samplePos += blockStartPos;
+			pendingTail++;
+		}
+
+		readPos.store(pos, memory_order_release);
+	}
+
+	// 取出一个渲染位置不超过samplePos的消息
+	bool MidiInput::Pop(int64_t samplePos, MidiInputEvent& ev)
+	{
+		if (pendingHead == pendingTail)
+			return false;
+
+		MidiInputEvent& front = pending[pendingHead & queueMask];
+		if (front.samplePos > samplePos)
+			return false;
+
+		ev = front;
+		pendingHead++;
+		return true;
+	}
+}
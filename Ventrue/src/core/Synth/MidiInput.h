@@ -0,0 +1,96 @@
+﻿#ifndef _MidiInput_h_
+#define _MidiInput_h_
+
+#include "VentrueTypes.h"
+
+namespace ventrue
+{
+	// 可识别的SysEx消息
+	enum class MidiInputSysExType :uint8_t
+	{
+		// GM System On: F0 7E 7F 09 01 F7
+		GMReset,
+		// GM2 System On: F0 7E 7F 09 03 F7
+		GM2Reset,
+		// GS Reset: F0 41 10 42 12 40 00 7F 00 41 F7
+		GSReset,
+		// XG System On: F0 43 10 4C 00 00 7E 00 F7
+		XGReset,
+	};
+
+	// midi输入事件
+	struct MidiInputEvent
+	{
+		//事件所在的渲染位置(入队时为相对于下一个渲染块开始位置的偏移)
+		int64_t samplePos;
+		//状态字节(包含通道号), SysEx时为0xF0
+		uint8_t status;
+		//SysEx时为MidiInputSysExType
+		uint8_t data1;
+		uint8_t data2;
+	};
+
+	/*
+	* midi原始字节流输入
+	* 解析midi字节流(支持running status和SysEx)，把消息写入无锁环形队列，
+	* 渲染线程在每个渲染块开始时取出队列中的消息，并按采样位置在子帧中处理
+	* Push只允许一个线程调用，渲染线程为唯一的读取端
+	* by cymheart, 2020--2021.
+	*/
+	class MidiInput
+	{
+	public:
+		// queueSize: 队列可容纳的消息数量(会调整为2的幂)
+		MidiInput(uint32_t queueSize = 4096);
+		~MidiInput();
+
+		// 解析midi字节流并写入队列(不分配内存)
+		// sampleOffset: 消息相对于下一个渲染块开始位置的采样点偏移
+		void Push(const uint8_t* data, size_t size, int sampleOffset);
+
+		// 渲染块开始时调用，取出队列中的消息并转换为渲染位置
+		void BeginBlock(int64_t blockStartPos);
+
+		// 取出一个渲染位置不超过samplePos的消息
+		bool Pop(int64_t samplePos, MidiInputEvent& ev);
+
+		// 获取因队列已满而丢弃的消息数量
+		inline uint64_t GetDroppedCount()
+		{
+			return droppedCount.load(memory_order_relaxed);
+		}
+
+	private:
+		// 处理一个完整的消息
+		void PushMessage(uint8_t status, uint8_t data1, uint8_t data2, int sampleOffset);
+
+		// 处理一个完整的SysEx消息
+		void PushSysEx(int sampleOffset);
+
+		// 获取通道消息的数据字节数量
+		static int GetDataSize(uint8_t status);
+
+	private:
+		//写入线程与渲染线程之间的无锁队列
+		MidiInputEvent* queue = nullptr;
+		uint32_t queueMask = 0;
+		atomic<uint32_t> writePos;
+		atomic<uint32_t> readPos;
+		atomic<uint64_t> droppedCount;
+
+		//渲染线程中已取出等待处理的消息
+		MidiInputEvent* pending = nullptr;
+		uint32_t pendingHead = 0;
+		uint32_t pendingTail = 0;
+
+		//解析状态(只在写入线程中使用)
+		uint8_t runningStatus = 0;
+		uint8_t dataBytes[2] = { 0 };
+		int dataCount = 0;
+		bool isInSysEx = false;
+		uint8_t sysExBuf[16] = { 0 };
+		int sysExSize = 0;
+	};
+}
+
+#endif
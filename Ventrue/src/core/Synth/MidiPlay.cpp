@@ -6,11 +6,17 @@
 #include"Midi/MidiEvent.h"
 #include"Midi/MidiTrack.h"
 #include"Midi/MidiFile.h"
+#include"Midi/MidiTrackStream.h"
 #include"VirInstrument.h"
 #include"Preset.h"
+#include<algorithm>
 
 namespace ventrue
 {
+	//Goto检查点的时间间隔(单位:秒)
+	static const double GOTO_CHECKPOINT_INTERVAL = 5;
+
+
 	MidiPlay::MidiPlay(Ventrue* ventrue)
 	{
 		this->ventrue = ventrue;
@@ -24,22 +30,31 @@ namespace ventrue
 		for (int i = 0; i < trackList.size(); i++)
 			DEL(trackList[i]);
 
-		for (int i = 0; i < assistMidiEvList.size(); i++)
-			DEL(assistMidiEvList[i]);
-
 		DEL(assistTrack);
 	}
 
 	// 解析MidiFile
-	void MidiPlay::ParseMidiFile(string midiFilePath, TrackChannelMergeMode mode)
+	void MidiPlay::ParseMidiFile(string midiFilePath, TrackChannelMergeMode mode, bool isReleaseEventObjects, MidiNoteCullOptions* cullOptions)
 	{
 		midiFile = new MidiFile();
 		midiFile->SetTrackChannelMergeMode(mode);
 		midiFile->Parse(midiFilePath);
 
+		//裁剪需要使用事件对象，在释放之前进行
+		if (cullOptions != nullptr && cullOptions->IsEnable())
+		{
+			MidiNoteCuller culler(*cullOptions);
+			noteCullReport = culler.Cull(midiFile);
+		}
+
+		//播放只使用紧凑事件，事件对象仅用于记录事件的时间点
+		if (isReleaseEventObjects)
+			midiFile->ReleaseEventObjects();
+
 		//
 		midiTrackList = midiFile->GetTrackList();
 		Clear();
+		ScanUsedPresets();
 
 		//
 		state = MidiPlayState::PLAY;
@@ -48,6 +63,7 @@ namespace ventrue
 		TrackRun(0);
 		isComputeEventTime = false;
 		state = MidiPlayState::STOP;
+		BuildGotoCheckpoints();
 		GotoStart();
 
 		//
@@ -55,6 +71,20 @@ namespace ventrue
 	}
 
 
+	// 以流式方式打开midi文件
+	void MidiPlay::OpenMidiStream(string midiFilePath)
+	{
+		midiFile = new MidiFile();
+		midiFile->OpenStream(midiFilePath);
+
+		midiTrackList = midiFile->GetTrackList();
+		trackStreams = midiFile->GetTrackStreams();
+		isStreaming = true;
+
+		Clear();
+		state = MidiPlayState::STOP;
+	}
+
 	//停止播放
 	void MidiPlay::Stop()
 	{
@@ -184,6 +214,187 @@ namespace ventrue
 	}
 
 
+	//获取播放时发声会用到的所有预设乐器
+	void MidiPlay::GetUsedPresetKeys(vector<int>& keys)
+	{
+		keys.insert(keys.end(), usedPresetKeys.begin(), usedPresetKeys.end());
+
+		//鼓点通道固定使用(128, 0, 打击乐号)
+		if (isUsedPercussion)
+			keys.push_back(128 << 16 | percussionProgramNum);
+	}
+
+	// 预编译播放时间线
+	void MidiPlay::CompileTimeline(float sampleRate)
+	{
+		if (midiFile == nullptr || isStreaming)
+			return;
+
+		timeline.clear();
+		timelineTrackEnds.clear();
+		timelineSampleRate = sampleRate;
+		isUseTimeline = true;
+
+		//同步轨道格式中，任一轨道的速度事件作用于所有轨道
+		bool isSyncTracks = midiFile->GetFormat() == MidiFileFormat::SyncTracks;
+		vector<MidiTempoPoint> tempoMap;
+		if (isSyncTracks)
+			midiFile->BuildTempoMap(-1, tempoMap);
+
+		//把每个轨道的通道事件的tick换算为绝对采样位置
+		for (int i = 0; i < midiTrackList->size(); i++)
+		{
+			MidiPackedEvent* events = (*midiTrackList)[i]->GetPackedEvents();
+			uint32_t eventCount = (*midiTrackList)[i]->GetPackedEventCount();
+
+			if (!isSyncTracks)
+				midiFile->BuildTempoMap(i, tempoMap);
+
+			int m = 0;
+			for (uint32_t j = 0; j < eventCount; j++)
+			{
+				switch (events[j].GetType())
+				{
+				case MidiEventType::NoteOn:
+				case MidiEventType::NoteOff:
+				case MidiEventType::Controller:
+				case MidiEventType::ProgramChange:
+				case MidiEventType::PitchBend:
+					break;
+				default:
+					continue;
+				}
+
+				uint32_t tick = events[j].startTick;
+				while (m + 1 < tempoMap.size() && tempoMap[m + 1].tick <= tick)
+					m++;
+
+				double sec = tempoMap[m].sec + ((double)tick - tempoMap[m].tick) * tempoMap[m].secPerTick;
+
+				MidiTimelineEvent ev;
+				ev.samplePos = (uint64_t)(sec * sampleRate + 0.5);
+				ev.eventIdx = j;
+				ev.trackIdx = i;
+				timeline.push_back(ev);
+			}
+		}
+
+		//按采样位置排序，相同位置保持轨道顺序和轨道内的事件顺序
+		stable_sort(timeline.begin(), timeline.end(),
+			[](const MidiTimelineEvent& a, const MidiTimelineEvent& b) {
+				return a.samplePos < b.samplePos;
+			});
+
+		//记录每个轨道播放结束时的时间线位置
+		vector<size_t> trackEndIdxs(midiTrackList->size(), 0);
+		for (size_t i = 0; i < timeline.size(); i++)
+			trackEndIdxs[timeline[i].trackIdx] = i + 1;
+
+		for (int i = 0; i < trackEndIdxs.size(); i++)
+			timelineTrackEnds.push_back(make_pair(trackEndIdxs[i], i));
+
+		sort(timelineTrackEnds.begin(), timelineTrackEnds.end());
+
+		//复用解析时生成的检查点，只需补上时间线的播放位置:
+		//即检查点状态中第一个尚未处理的时间线事件
+		size_t idx = 0;
+		for (int n = 0; n < gotoCheckpoints.size(); n++)
+		{
+			vector<TrackState>& trackStates = gotoCheckpoints[n].trackStates;
+			for (; idx < timeline.size(); idx++)
+			{
+				TrackState& trackState = trackStates[timeline[idx].trackIdx];
+				if (!trackState.isEnded && timeline[idx].eventIdx >= (uint32_t)trackState.eventOffsetIdx)
+					break;
+			}
+
+			gotoCheckpoints[n].timelineIdx = idx;
+		}
+	}
+
+	//按固定时间间隔生成Goto使用的播放位置检查点
+	//Goto时从最近的检查点恢复播放状态，只需快进检查点之后的少量事件
+	void MidiPlay::BuildGotoCheckpoints()
+	{
+		gotoCheckpoints.clear();
+		Clear();
+
+		//只保存轨道中有事件的通道
+		vector<uint16_t> channelMasks(trackList.size(), 0);
+		for (int i = 0; i < trackList.size(); i++)
+		{
+			MidiPackedEvent* events = (*midiTrackList)[i]->GetPackedEvents();
+			uint32_t eventCount = (*midiTrackList)[i]->GetPackedEventCount();
+			for (uint32_t j = 0; j < eventCount; j++)
+			{
+				if (events[j].channel < 16)
+					channelMasks[i] |= 1 << events[j].channel;
+			}
+
+			trackList[i]->SetPercussionProgramNum(percussionProgramNum);
+		}
+
+		isBuildingCheckpoints = true;
+		isDirectGoto = true;
+
+		for (int n = 1; n * GOTO_CHECKPOINT_INTERVAL < endSec; n++)
+		{
+			double sec = n * GOTO_CHECKPOINT_INTERVAL;
+			PlayCore(sec);
+
+			gotoCheckpoints.emplace_back();
+			MidiPlayCheckpoint& checkpoint = gotoCheckpoints.back();
+			checkpoint.sec = sec;
+			checkpoint.percussionProgramNum = percussionProgramNum;
+			checkpoint.timelineIdx = timelineIdx;
+			checkpoint.trackStates.resize(trackList.size());
+			for (int i = 0; i < trackList.size(); i++)
+				trackList[i]->SaveState(checkpoint.trackStates[i], channelMasks[i]);
+		}
+
+		isDirectGoto = false;
+		isBuildingCheckpoints = false;
+		Clear();
+	}
+
+	//获取不晚于指定时间点的最近检查点
+	MidiPlayCheckpoint* MidiPlay::FindGotoCheckpoint(double sec)
+	{
+		if (gotoCheckpoints.empty() || sec < gotoCheckpoints[0].sec)
+			return nullptr;
+
+		int idx = (int)(sec / GOTO_CHECKPOINT_INTERVAL) - 1;
+		idx = min(max(idx, 0), (int)gotoCheckpoints.size() - 1);
+		if (gotoCheckpoints[idx].sec > sec)
+			idx--;
+
+		return idx >= 0 ? &gotoCheckpoints[idx] : nullptr;
+	}
+
+	//扫描midi事件，统计发声会用到的预设乐器
+	//鼓点通道的乐器由打击乐号决定，单独记录
+	void MidiPlay::ScanUsedPresets()
+	{
+		usedPresetKeys.clear();
+		isUsedPercussion = false;
+
+		vector<MidiProgramUse> uses;
+		midiFile->ScanProgramUses(uses);
+
+		unordered_set<int> keySet;
+		for (int i = 0; i < uses.size(); i++)
+		{
+			if (uses[i].channel == 9) {
+				isUsedPercussion = true;
+				continue;
+			}
+
+			int key = uses[i].bankSelectMSB << 16 | uses[i].bankSelectLSB << 8 | uses[i].programNum;
+			if (keySet.insert(key).second)
+				usedPresetKeys.push_back(key);
+		}
+	}
+
 	void MidiPlay::Clear()
 	{
 		isGotoEnd = false;
@@ -191,10 +402,11 @@ namespace ventrue
 		isOpen = false;
 		startTime = 0;
 		gotoSec = 0;
+		timelineIdx = 0;
+		timelineTrackEndIdx = 0;
+		timelineBaseSec = 0;
 
-		for (int i = 0; i < assistMidiEvList.size(); i++)
-			DEL(assistMidiEvList[i]);
-
+		assistMidiEvList.clear();
 		assistTrack->Clear();
 
 		//生成音轨演奏信息
@@ -203,9 +415,16 @@ namespace ventrue
 			trackList[i]->Clear();
 		}
 
-		if (trackList.size() < midiTrackList->size())
+		if (isStreaming)
+		{
+			for (int i = 0; i < trackStreams->size(); i++)
+				(*trackStreams)[i]->Reset();
+		}
+
+		size_t trackCount = GetTrackCount();
+		if (trackList.size() < trackCount)
 		{
-			size_t count = midiTrackList->size() - trackList.size();
+			size_t count = trackCount - trackList.size();
 			for (size_t i = 0; i < count; i++)
 			{
 				trackList.push_back(new Track((int)(trackList.size())));
@@ -213,6 +432,15 @@ namespace ventrue
 		}
 	}
 
+	//获取轨道数量
+	size_t MidiPlay::GetTrackCount()
+	{
+		if (isStreaming)
+			return trackStreams->size();
+
+		return midiTrackList->size();
+	}
+
 	void MidiPlay::DisableTrack(int trackIdx)
 	{
 		if (trackIdx >= trackList.size())
@@ -293,35 +521,168 @@ namespace ventrue
 
 		if (isOpen == false)
 		{
+			//采样率改变后，需要重新编译时间线
+			if (isUseTimeline && timelineSampleRate != ventrue->GetSampleProcessRate())
+			{
+				double orgGotoSec = gotoSec;
+				bool orgIsGotoEnd = isGotoEnd;
+				CompileTimeline(ventrue->GetSampleProcessRate());
+				gotoSec = orgGotoSec;
+				isGotoEnd = orgIsGotoEnd;
+			}
+
 			isOpen = true;
-			list<MidiEvent*>* eventList;
+
+			//从检查点恢复时，只需快进检查点之后的事件
+			MidiPlayCheckpoint* checkpoint = nullptr;
+			if (gotoSec > 0 && !isGotoEnd)
+				checkpoint = FindGotoCheckpoint(gotoSec);
+
 			for (int i = 0; i < trackList.size(); i++)
 			{
-				eventList = (*midiTrackList)[i]->GetEventList();
-				trackList[i]->eventOffsetIter = eventList->begin();
-				trackList[i]->baseTickTime = sec;
-				trackList[i]->SetPercussionProgramNum(percussionProgramNum);
+				if (checkpoint != nullptr)
+				{
+					trackList[i]->RestoreState(checkpoint->trackStates[i], sec);
+					if (checkpoint->percussionProgramNum != percussionProgramNum)
+						trackList[i]->SetPercussionProgramNum(percussionProgramNum);
+				}
+				else
+				{
+					trackList[i]->eventOffsetIdx = 0;
+					trackList[i]->baseTickTime = sec;
+					trackList[i]->SetPercussionProgramNum(percussionProgramNum);
+				}
 			}
 
 			assistTrack->baseTickTime = sec;
+			timelineIdx = checkpoint != nullptr ? checkpoint->timelineIdx : 0;
+			timelineBaseSec = sec;
 
 			if (gotoSec > 0)
 			{
 				isDirectGoto = true;
-				TrackPlayCore(gotoSec + sec);
+				PlayCore(gotoSec + sec);
 				isDirectGoto = false;
 				isGotoEnd = false;
 			}
 		}
 
-		TrackPlayCore(gotoSec + sec);
+		PlayCore(gotoSec + sec);
+	}
+
+	//根据播放方式处理到指定时间点的事件
+	void MidiPlay::PlayCore(double sec)
+	{
+		if (isUseTimeline)
+			TimelinePlayCore(sec);
+		else if (isStreaming)
+			StreamPlayCore(sec);
+		else
+			TrackPlayCore(sec);
+	}
+
+	//按轨道事件流播放
+	//窗口中的事件处理完后继续解码，直到遇到当前时间点之后的事件或轨道结束
+	void MidiPlay::StreamPlayCore(double sec)
+	{
+		int trackEndCount = 0;
+
+		for (int i = 0; i < trackList.size(); i++)
+		{
+			Track* track = trackList[i];
+			if (track->isEnded) {
+				trackEndCount++;
+				continue;
+			}
+
+			MidiTrackStream* stream = (*trackStreams)[i];
+			track->CalCurtTicksCount(sec);
+
+			bool isReachCurtTick = false;
+			while (!isReachCurtTick)
+			{
+				stream->Fill();
+				MidiPackedEvent* events = stream->GetEvents();
+				uint32_t eventCount = stream->GetEventCount();
+				uint32_t idx = stream->GetReadIdx();
+				for (; idx < eventCount; idx++)
+				{
+					uint32_t startTick = events[idx].startTick;
+
+					//
+					while (track->NeedSettingTempo() &&
+						startTick >= track->GetSettingStartTickCount())
+					{
+						track->SetTempoBySetting();
+						track->CalCurtTicksCount(sec);
+					}
+
+					//
+					if (!isGotoEnd && startTick > track->curtTickCount)
+					{
+						isReachCurtTick = true;
+						break;
+					}
+
+					ProcessTrackEvent(events, idx, nullptr, i, sec);
+				}
+
+				stream->SetReadIdx(idx);
+				if (stream->IsEnded())
+					break;
+			}
+
+			if (stream->IsEnded())
+				EndTrack(track);
+		}
+
+		if (trackEndCount == trackList.size())
+			CheckPlayEnd();
+
+		AssistTrackPlayCore(sec);
+	}
+
+	//按预编译时间线播放
+	//事件已按采样位置排好序，只需推进游标直到当前采样位置
+	void MidiPlay::TimelinePlayCore(double sec)
+	{
+		uint64_t samplePos = (uint64_t)max((sec - timelineBaseSec) * timelineSampleRate, 0.0);
+		size_t count = timeline.size();
+		MidiTimelineEvent* tl = timeline.data();
+
+		for (; timelineIdx < count; timelineIdx++)
+		{
+			if (!isGotoEnd && tl[timelineIdx].samplePos > samplePos)
+				break;
+
+			MidiTrack* midiTrack = (*midiTrackList)[tl[timelineIdx].trackIdx];
+			ProcessTrackEvent(midiTrack->GetPackedEvents(), tl[timelineIdx].eventIdx,
+				midiTrack->GetPackedEventObjs(), tl[timelineIdx].trackIdx, sec);
+		}
+
+		//轨道按播放结束的时间线位置排序，依次处理已结束的轨道
+		for (; timelineTrackEndIdx < timelineTrackEnds.size(); timelineTrackEndIdx++)
+		{
+			if (timelineTrackEnds[timelineTrackEndIdx].first > timelineIdx)
+				break;
+
+			Track* track = trackList[timelineTrackEnds[timelineTrackEndIdx].second];
+			if (!track->isEnded)
+				EndTrack(track);
+		}
+
+		if (timelineTrackEndIdx == timelineTrackEnds.size())
+			CheckPlayEnd();
+
+		AssistTrackPlayCore(sec);
 	}
 
 
 	void MidiPlay::TrackPlayCore(double sec)
 	{
-		list<MidiEvent*>* eventList;
-		MidiEvent* ev;
+		MidiPackedEvent* events;
+		MidiEvent** eventObjs;
+		uint32_t eventCount;
 		int trackEndCount = 0;
 
 		for (int i = 0; i < trackList.size(); i++)
@@ -333,50 +694,65 @@ namespace ventrue
 
 			trackList[i]->CalCurtTicksCount(sec);
 
-			eventList = (*midiTrackList)[i]->GetEventList();
-			list<MidiEvent*>::iterator it = trackList[i]->eventOffsetIter;
-			list<MidiEvent*>::iterator end = eventList->end();
-			for (; it != end; it++)
+			//紧凑事件连续存放，按索引线性遍历
+			events = (*midiTrackList)[i]->GetPackedEvents();
+			eventObjs = (*midiTrackList)[i]->GetPackedEventObjs();
+			eventCount = (*midiTrackList)[i]->GetPackedEventCount();
+			uint32_t idx = (uint32_t)trackList[i]->eventOffsetIdx;
+			for (; idx < eventCount; idx++)
 			{
-				ev = *it;
+				uint32_t startTick = events[idx].startTick;
 
 				//
 				while (trackList[i]->NeedSettingTempo() &&
-					ev->startTick >= trackList[i]->GetSettingStartTickCount())
+					startTick >= trackList[i]->GetSettingStartTickCount())
 				{
 					trackList[i]->SetTempoBySetting();
 					trackList[i]->CalCurtTicksCount(sec);
 				}
 
 				//
-				if (!isGotoEnd && ev->startTick > trackList[i]->curtTickCount)
+				if (!isGotoEnd && startTick > trackList[i]->curtTickCount)
 				{
-					trackList[i]->eventOffsetIter = it;
+					trackList[i]->eventOffsetIdx = (int)idx;
 					break;
 				}
 
 
-				ProcessTrackEvent(ev, i, sec);
+				ProcessTrackEvent(events, idx, eventObjs, i, sec);
 			}
 
-			if (it == end)
-			{
-				trackList[i]->isEnded = true;
+			if (idx == eventCount)
+				EndTrack(trackList[i]);
+		}
 
-				//轨道播发结束后，清除相关设置
-				for (int j = 0; j < 16; j++)
-				{
-					Channel* channel = (*trackList[i])[j];
-					if (channel != nullptr) {
-						channel->SetControllerValue(MidiControllerType::SustainPedalOnOff, 0);
-						ventrue->ModulationVirInstParams(channel);
-					}
-				}
+		if (trackEndCount == trackList.size())
+			CheckPlayEnd();
+
+		AssistTrackPlayCore(sec);
+	}
+
+	//轨道播放结束
+	void MidiPlay::EndTrack(Track* track)
+	{
+		track->isEnded = true;
+
+		//轨道播发结束后，清除相关设置
+		for (int j = 0; j < 16; j++)
+		{
+			Channel* channel = (*track)[j];
+			if (channel != nullptr) {
+				channel->SetControllerValue(MidiControllerType::SustainPedalOnOff, 0);
+				ventrue->ModulationVirInstParams(channel);
 			}
 		}
+	}
 
+	//所有轨道播放结束后检测发声是否结束
+	void MidiPlay::CheckPlayEnd()
+	{
 		//检测播放是否结束
-		if (!isComputeEventTime && trackEndCount == trackList.size())
+		if (!isComputeEventTime && !isBuildingCheckpoints)
 		{
 			bool isEnd = true;
 			for (int i = 0; i < trackList.size(); i++)
@@ -397,45 +773,50 @@ namespace ventrue
 				Stop();
 			}
 		}
+	}
 
-
-		//处理辅助播放轨道的midi事件
+	//处理辅助播放轨道的midi事件
+	void MidiPlay::AssistTrackPlayCore(double sec)
+	{
 		assistTrack->CalCurtTicksCount(sec);
 		int j = assistTrack->eventOffsetIdx;
 		for (; j < assistMidiEvList.size(); j++)
 		{
-			if (!isGotoEnd && assistMidiEvList[j]->startTick > assistTrack->curtTickCount)
+			if (!isGotoEnd && assistMidiEvList[j].startTick > assistTrack->curtTickCount)
 			{
 				assistTrack->eventOffsetIdx = j;
 				break;
 			}
 
-			ProcessTrackEvent(assistMidiEvList[j], 0, sec);
+			ProcessTrackEvent(assistMidiEvList.data(), j, nullptr, 0, sec);
 		}
 	}
 
 	//处理轨道事件
-	void MidiPlay::ProcessTrackEvent(MidiEvent* midEv, int trackIdx, double sec)
+	void MidiPlay::ProcessTrackEvent(MidiPackedEvent* events, uint32_t idx, MidiEvent** eventObjs, int trackIdx, double sec)
 	{
+		MidiPackedEvent& midEv = events[idx];
+
 		if (isComputeEventTime &&
-			midEv->type != MidiEventType::NoteOn)
+			midEv.GetType() != MidiEventType::NoteOn)
 		{
-			midEv->endSec = midEv->startSec =
-				trackList[trackIdx]->GetTickSec(midEv->startTick);
+			float evSec = (float)trackList[trackIdx]->GetTickSec(midEv.startTick);
+			if (eventObjs != nullptr)
+				eventObjs[idx]->endSec = eventObjs[idx]->startSec = evSec;
 
-			if (midEv->endSec > endSec)
-				endSec = midEv->endSec;
+			if (evSec > endSec)
+				endSec = evSec;
 		}
 
 		//
-		switch (midEv->type)
+		switch (midEv.GetType())
 		{
 		case MidiEventType::Tempo:
 		{
-			TempoEvent* tempoEv = (TempoEvent*)midEv;
+			float microTempo = (float)midEv.ext;
 
 			// 设置轨道速度
-			trackList[trackIdx]->SetTempo(tempoEv->microTempo, midiFile->GetTickForQuarterNote(), tempoEv->startTick);
+			trackList[trackIdx]->SetTempo(microTempo, midiFile->GetTickForQuarterNote(), midEv.startTick);
 			trackList[trackIdx]->CalCurtTicksCount(sec);
 
 			if (midiFile->GetFormat() == MidiFileFormat::SyncTracks)
@@ -445,7 +826,7 @@ namespace ventrue
 					if (i == trackIdx)
 						continue;
 
-					trackList[i]->AddTempoSetting(tempoEv->microTempo, midiFile->GetTickForQuarterNote(), tempoEv->startTick);
+					trackList[i]->AddTempoSetting(microTempo, midiFile->GetTickForQuarterNote(), midEv.startTick);
 				}
 			}
 		}
@@ -453,15 +834,13 @@ namespace ventrue
 
 		case MidiEventType::NoteOn:
 		{
-			NoteOnEvent* noteOnEv = (NoteOnEvent*)midEv;
-
-			if (isComputeEventTime)
-				noteOnEv->startSec = trackList[trackIdx]->GetTickSec(noteOnEv->startTick);
+			if (isComputeEventTime && eventObjs != nullptr)
+				eventObjs[idx]->startSec = (float)trackList[trackIdx]->GetTickSec(midEv.startTick);
 
 			if (isDirectGoto || trackList[trackIdx]->isDisablePlay)
 				break;
 
-			Channel& channel = *(*trackList[trackIdx])[noteOnEv->channel];
+			Channel& channel = *(*trackList[trackIdx])[midEv.channel];
 			if (channel.IsDisablePlay())
 				break;
 
@@ -473,43 +852,46 @@ namespace ventrue
 					return;
 			}
 
+			uint32_t endTick = 0;
+			if (midEv.ext != MIDI_PACKED_NO_LINK)
+				endTick = events[midEv.ext].startTick;
+			else if (isStreaming)
+				endTick = midEv.startTick + 0x7fffff;  //流式播放时NoteOff可能还未解码，按长音符处理
+
 			VirInstrument* virInst = ventrue->EnableVirInstrument(preset, &channel);
 			virInst->SetType(VirInstrumentType::MidiTrackType);
-			virInst->OnKey(noteOnEv->note, (float)noteOnEv->velocity, noteOnEv->endTick - noteOnEv->startTick + 1, false);
-			//printf("开始:%.2f秒 - 结束:%.2f秒 \n", noteOnEv->startSec, noteOnEv->endSec);
+			virInst->OnKey(midEv.data1, (float)midEv.data2, endTick - midEv.startTick + 1, false);
 
 			//对缺少对应关闭音符事件的NoteOn，在辅助轨道上添加一个0.5s后关闭的事件
-			if (noteOnEv->noteOffEvent == nullptr)
+			//流式播放时轨道结束会关闭所有未关闭的音符
+			if (midEv.ext == MIDI_PACKED_NO_LINK && !isStreaming)
 			{
-				NoteOffEvent* noteOffEvent = new NoteOffEvent();
-				noteOffEvent->startTick = assistTrack->GetTickCount(sec + 0.5f);
-				noteOffEvent->note = noteOnEv->note;
-				noteOffEvent->velocity = 127;
-				noteOffEvent->channel = noteOnEv->channel;
-				noteOffEvent->noteOnEvent = noteOnEv;
-				assistMidiEvList.push_back(noteOffEvent);
+				MidiPackedEvent noteOffEv;
+				noteOffEv.startTick = assistTrack->GetTickCount(sec + 0.5f);
+				noteOffEv.type = (int8_t)MidiEventType::NoteOff;
+				noteOffEv.channel = midEv.channel;
+				noteOffEv.data1 = midEv.data1;
+				noteOffEv.data2 = 127;
+				noteOffEv.ext = 0;  //辅助事件不需要关联NoteOn的索引
+				assistMidiEvList.push_back(noteOffEv);
 			}
 		}
 		break;
 
 		case MidiEventType::NoteOff:
 		{
-			NoteOffEvent* noteOffEv = (NoteOffEvent*)midEv;
-			if (noteOffEv->noteOnEvent == nullptr)
+			if (midEv.ext == MIDI_PACKED_NO_LINK)
 				break;
 
-			if (isComputeEventTime) {
-				noteOffEv->noteOnEvent->endSec = midEv->endSec;
-
-				if (midEv->endSec > endSec)
-					endSec = midEv->endSec;
+			if (isComputeEventTime && eventObjs != nullptr) {
+				eventObjs[midEv.ext]->endSec = eventObjs[idx]->endSec;
 			}
 
 			if (isDirectGoto || trackList[trackIdx]->isDisablePlay)
 				break;
 
 
-			Channel& channel = *(*trackList[trackIdx])[noteOffEv->channel];
+			Channel& channel = *(*trackList[trackIdx])[midEv.channel];
 			if (channel.IsDisablePlay())
 				break;
 
@@ -522,38 +904,35 @@ namespace ventrue
 			}
 
 			VirInstrument* virInst = ventrue->EnableVirInstrument(preset, &channel);
-			virInst->OffKey(noteOffEv->note, (float)noteOffEv->velocity, false);
+			virInst->OffKey(midEv.data1, (float)midEv.data2, false);
 
 		}
 		break;
 
 		case MidiEventType::ProgramChange:
 		{
-			ProgramChangeEvent* ev = (ProgramChangeEvent*)midEv;
-			Channel& channel = *(*trackList[trackIdx])[ev->channel];
+			Channel& channel = *(*trackList[trackIdx])[midEv.channel];
 
 			//通道9为鼓点音色，一般不需要选择
-			if (ev->channel == 9)
+			if (midEv.channel == 9)
 				return;
 
-			channel.SetProgramNum(ev->value);
+			channel.SetProgramNum(midEv.data1);
 		}
 		break;
 
 		case MidiEventType::PitchBend:
 		{
-			PitchBendEvent* ev = (PitchBendEvent*)midEv;
-			Channel* channel = (*trackList[trackIdx])[ev->channel];
-			channel->SetPitchBend(ev->value);
+			Channel* channel = (*trackList[trackIdx])[midEv.channel];
+			channel->SetPitchBend(midEv.data2 << 7 | midEv.data1);
 			ventrue->ModulationVirInstParams(channel);
 		}
 		break;
 
 		case MidiEventType::Controller:
 		{
-			ControllerEvent* ev = (ControllerEvent*)midEv;
-			Channel* channel = (*trackList[trackIdx])[ev->channel];
-			channel->SetControllerValue(ev->ctrlType, ev->value);
+			Channel* channel = (*trackList[trackIdx])[midEv.channel];
+			channel->SetControllerValue((MidiControllerType)midEv.data1, midEv.data2);
 			ventrue->ModulationVirInstParams(channel);
 		}
 		break;
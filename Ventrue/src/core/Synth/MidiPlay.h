@@ -3,6 +3,8 @@
 
 #include "VentrueTypes.h"
 #include "Midi/MidiTypes.h"
+#include "Midi/MidiNoteCuller.h"
+#include "Track.h"
 
 namespace ventrue
 {
@@ -18,6 +20,31 @@ namespace ventrue
 		SUSPEND
 	};
 
+	// Goto使用的播放位置检查点
+	struct MidiPlayCheckpoint
+	{
+		//检查点时间(单位:秒)
+		double sec = 0;
+		//生成检查点时的打击乐号
+		int percussionProgramNum = 0;
+		//所有轨道的播放状态
+		vector<TrackState> trackStates;
+		//预编译时间线的播放位置
+		size_t timelineIdx = 0;
+	};
+
+	// 预编译时间线中的事件
+	// 只记录通道事件，速度已被解析为绝对采样位置
+	struct MidiTimelineEvent
+	{
+		//事件所在的采样位置
+		uint64_t samplePos;
+		//事件在所属轨道紧凑事件列表中的索引
+		uint32_t eventIdx;
+		//所属轨道
+		uint32_t trackIdx;
+	};
+
 	/// <summary>
 	/// Midi文件播放类
 	/// by cymheart, 2020--2021.
@@ -65,7 +92,37 @@ namespace ventrue
 		//移除轨道通道对应的虚拟乐器
 		void RemoveVirInstrumentByTrackChannel(int trackIdx, int channelIdx);
 		// 解析MidiFile
-		void ParseMidiFile(string midiFilePath, TrackChannelMergeMode mode);
+		// isReleaseEventObjects: 解析后是否释放事件对象只保留紧凑事件(用于音符数量巨大的midi文件)
+		// cullOptions: 解析后裁剪音符的规则(nullptr: 不裁剪)
+		void ParseMidiFile(string midiFilePath, TrackChannelMergeMode mode, bool isReleaseEventObjects = false, MidiNoteCullOptions* cullOptions = nullptr);
+
+		//获取解析时的音符裁剪结果
+		inline MidiNoteCullReport& GetNoteCullReport()
+		{
+			return noteCullReport;
+		}
+
+		// 以流式方式打开midi文件
+		// 不预先解析整个文件，播放时各轨道只在播放位置之后按需解码一段事件，速度在播放中逐步计算
+		// 可以立即开始播放，内存占用与文件大小无关，但无法获取结束时间，也不使用Goto检查点和预编译时间线
+		void OpenMidiStream(string midiFilePath);
+
+		//是否以流式方式播放
+		inline bool IsStreaming()
+		{
+			return isStreaming;
+		}
+
+		// 预编译播放时间线(需在ParseMidiFile之后调用)
+		// 一次性解析全局速度表，把所有轨道的通道事件合并为按采样位置排序的单一事件流，
+		// 播放时只需推进游标直接分发事件，不再逐帧进行tick与时间的换算
+		void CompileTimeline(float sampleRate);
+
+		//是否使用预编译时间线播放
+		inline bool IsUseTimeline()
+		{
+			return isUseTimeline;
+		}
 		//轨道运行
 		void TrackRun(double sec);
 		void DisableTrack(int trackIdx);
@@ -82,11 +139,37 @@ namespace ventrue
 		//设置打击乐号
 		void SetPercussionProgramNum(int num);
 
+		//获取播放时发声会用到的所有预设乐器(bankSelectMSB << 16 | bankSelectLSB << 8 | 乐器号)
+		void GetUsedPresetKeys(vector<int>& keys);
+
 	private:
 		void Clear();
+
+		//扫描midi事件，统计发声会用到的预设乐器
+		void ScanUsedPresets();
+
+		//按固定时间间隔生成Goto使用的播放位置检查点
+		void BuildGotoCheckpoints();
+		//获取不晚于指定时间点的最近检查点(没有时返回nullptr)
+		MidiPlayCheckpoint* FindGotoCheckpoint(double sec);
+		//获取轨道数量
+		size_t GetTrackCount();
+		//根据播放方式处理到指定时间点的事件
+		void PlayCore(double sec);
 		void TrackPlayCore(double sec);
+		//按轨道事件流播放
+		void StreamPlayCore(double sec);
+		//按预编译时间线播放
+		void TimelinePlayCore(double sec);
+		//处理辅助播放轨道的midi事件
+		void AssistTrackPlayCore(double sec);
+		//轨道播放结束
+		void EndTrack(Track* track);
+		//所有轨道播放结束后检测发声是否结束
+		void CheckPlayEnd();
 		//处理轨道事件
-		void ProcessTrackEvent(MidiEvent* midEv, int trackIdx, double sec);
+		//events: 事件所在的紧凑事件列表, idx: 事件索引, eventObjs: 与紧凑事件对应的事件对象(可为nullptr)
+		void ProcessTrackEvent(MidiPackedEvent* events, uint32_t idx, MidiEvent** eventObjs, int trackIdx, double sec);
 
 	private:
 
@@ -96,12 +179,18 @@ namespace ventrue
 		MidiFile* midiFile = nullptr;
 		MidiTrackList* midiTrackList = nullptr;
 
+		//流式播放时各轨道的事件流
+		vector<MidiTrackStream*>* trackStreams = nullptr;
+
+		//是否以流式方式播放
+		bool isStreaming = false;
+
 
 		// 音轨演奏信息
 		TrackList trackList;
 
 		//辅助midi事件列表
-		MidiEventList assistMidiEvList;
+		vector<MidiPackedEvent> assistMidiEvList;
 
 		//辅助轨道
 		Track* assistTrack;
@@ -130,6 +219,42 @@ namespace ventrue
 		//打击乐号
 		int percussionProgramNum = 0;
 
+		//发声会用到的预设乐器(不包括鼓点通道)
+		vector<int> usedPresetKeys;
+
+		//鼓点通道是否有发声
+		bool isUsedPercussion = false;
+
+		//音符裁剪结果
+		MidiNoteCullReport noteCullReport;
+
+		//Goto使用的播放位置检查点(按时间顺序)
+		vector<MidiPlayCheckpoint> gotoCheckpoints;
+
+		//是否正在生成检查点
+		bool isBuildingCheckpoints = false;
+
+		//预编译时间线(按采样位置排序)
+		vector<MidiTimelineEvent> timeline;
+
+		//是否使用预编译时间线播放
+		bool isUseTimeline = false;
+
+		//时间线编译时使用的采样率
+		float timelineSampleRate = 44100;
+
+		//时间线播放游标
+		size_t timelineIdx = 0;
+
+		//每个轨道播放结束时的时间线位置(时间线位置, 轨道索引)，按时间线位置排序
+		vector<pair<size_t, int>> timelineTrackEnds;
+
+		//已处理到的轨道结束位置
+		size_t timelineTrackEndIdx = 0;
+
+		//时间线起始采样位置对应的时间点
+		double timelineBaseSec = 0;
+
 	};
 }
 
@@ -0,0 +1,165 @@
+﻿#include"MidiRecorder.h"
+#include"MidiTrackRecord.h"
+#include"Midi/MidiFile.h"
+#include <algorithm>
+
+namespace ventrue
+{
+	//后台线程转换录制事件的间隔(毫秒)
+	static const int RECORD_DRAIN_INTERVAL_MS = 10;
+
+	MidiRecorder::MidiRecorder()
+		:registerHead(nullptr)
+		, unregisterHead(nullptr)
+		, isStop(false)
+	{
+	}
+
+	MidiRecorder::~MidiRecorder()
+	{
+		Stop();
+
+		//后台线程停止后，释放还未被处理的已移除录制
+		DelRecords(unregisterHead.exchange(nullptr, memory_order_acquire));
+	}
+
+	// 启动后台线程
+	void MidiRecorder::Start()
+	{
+		if (isRunning)
+			return;
+
+		isStop = false;
+		isRunning = true;
+		recThread = thread(&MidiRecorder::Run, this);
+	}
+
+	// 停止后台线程
+	void MidiRecorder::Stop()
+	{
+		if (!isRunning)
+			return;
+
+		isStop = true;
+		waitSem.set();
+		recThread.join();
+		isRunning = false;
+	}
+
+	// 注册录制(无锁，可在渲染线程中调用)
+	void MidiRecorder::Register(MidiTrackRecord* record)
+	{
+		MidiTrackRecord* head = registerHead.load(memory_order_relaxed);
+		do {
+			record->registerNext = head;
+		} while (!registerHead.compare_exchange_weak(head, record, memory_order_release, memory_order_relaxed));
+	}
+
+	// 移除录制(无锁，可在渲染线程中调用)
+	// 录制交由后台线程在不再使用后释放
+	void MidiRecorder::Unregister(MidiTrackRecord* record)
+	{
+		MidiTrackRecord* head = unregisterHead.load(memory_order_relaxed);
+		do {
+			record->unregisterNext = head;
+		} while (!unregisterHead.compare_exchange_weak(head, record, memory_order_release, memory_order_relaxed));
+	}
+
+	// 释放链表中已移除的录制
+	void MidiRecorder::DelRecords(MidiTrackRecord* head)
+	{
+		while (head != nullptr)
+		{
+			MidiTrackRecord* next = head->unregisterNext;
+			DEL(head);
+			head = next;
+		}
+	}
+
+	// 请求在后台线程中把录制的轨道保存为midi文件
+	void MidiRecorder::SaveMidiFile(string path, vector<MidiTrackRecord*>& saveRecords, float bpm, float tickForQuarterNote)
+	{
+		lock.lock();
+		MidiRecordSaveRequest req;
+		req.path = path;
+		req.records = saveRecords;
+		req.bpm = bpm;
+		req.tickForQuarterNote = tickForQuarterNote;
+		saveRequests.push_back(req);
+		lock.unlock();
+
+		Start();
+		waitSem.set();
+	}
+
+	void MidiRecorder::Run()
+	{
+		while (!isStop)
+		{
+			//先取移除链表，再取保存请求:
+			//请求中的录制在请求之后才会被移除，本轮释放的录制不会出现在之后的请求中
+			MidiTrackRecord* removedHead = unregisterHead.exchange(nullptr, memory_order_acquire);
+
+			list<MidiRecordSaveRequest> reqs;
+			lock.lock();
+			reqs.swap(saveRequests);
+			lock.unlock();
+
+			//注册先于移除交接，移除链表中的录制此时都已在注册链表中
+			MidiTrackRecord* record = registerHead.exchange(nullptr, memory_order_acquire);
+			for (; record != nullptr; record = record->registerNext)
+				records.push_back(record);
+
+			for (int i = 0; i < records.size(); i++)
+				records[i]->Drain();
+
+			//生成和写入midi文件时不持有lock
+			for (auto it = reqs.begin(); it != reqs.end(); it++)
+			{
+				MidiFile* midiFile = CreateMidiFile(*it);
+				midiFile->CreateMidiFormatMemData();
+				midiFile->SaveMidiFormatMemDataToDist(it->path);
+				DEL(midiFile);
+			}
+
+			//从已注册列表中去除后释放
+			for (record = removedHead; record != nullptr; record = record->unregisterNext)
+			{
+				auto it = find(records.begin(), records.end(), record);
+				if (it != records.end())
+					records.erase(it);
+			}
+			DelRecords(removedHead);
+
+			waitSem.wait_for(RECORD_DRAIN_INTERVAL_MS);
+		}
+	}
+
+	// 生成录制的midi文件
+	// 请求中的录制在本轮处理完成之前不会被释放
+	MidiFile* MidiRecorder::CreateMidiFile(MidiRecordSaveRequest& req)
+	{
+		MidiFile* midiFile = new MidiFile();
+		midiFile->SetFormat(MidiFileFormat::SyncTracks);
+		midiFile->SetTickForQuarterNote(req.tickForQuarterNote);
+
+		//
+		MidiTrackRecord globalMidiRecord;
+		globalMidiRecord.SetBPM(req.bpm);
+		globalMidiRecord.SetTickForQuarterNote(req.tickForQuarterNote);
+		globalMidiRecord.Start();
+		globalMidiRecord.Stop();
+		midiFile->AddMidiTrack(globalMidiRecord.TakeMidiTrack(req.tickForQuarterNote));
+
+		for (int i = 0; i < req.records.size(); i++)
+		{
+			MidiTrack* midiTrack = req.records[i]->TakeMidiTrack(req.tickForQuarterNote);
+			if (midiTrack == nullptr)
+				continue;
+
+			midiFile->AddMidiTrack(midiTrack);
+		}
+
+		return midiFile;
+	}
+}
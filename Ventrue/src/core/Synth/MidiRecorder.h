@@ -0,0 +1,79 @@
+﻿#ifndef _MidiRecorder_h_
+#define _MidiRecorder_h_
+
+#include "VentrueTypes.h"
+
+namespace ventrue
+{
+	// 录制midi保存请求
+	struct MidiRecordSaveRequest
+	{
+		string path;
+		vector<MidiTrackRecord*> records;
+		float bpm = 120;
+		float tickForQuarterNote = 120;
+	};
+
+	/*
+	* midi录制后台线程
+	* 定时把已注册的MidiTrackRecord环形缓存中的事件转换为midi轨道事件，
+	* 并在后台生成midi文件写入磁盘，使录制不影响渲染线程
+	* 渲染线程通过无锁链表交接注册和移除，已注册列表只在后台线程中访问
+	* by cymheart, 2020--2021.
+	*/
+	class MidiRecorder
+	{
+	public:
+		MidiRecorder();
+		~MidiRecorder();
+
+		// 启动后台线程
+		void Start();
+
+		// 停止后台线程
+		void Stop();
+
+		inline bool IsRunning()
+		{
+			return isRunning;
+		}
+
+		// 注册录制(无锁，可在渲染线程中调用)
+		void Register(MidiTrackRecord* record);
+
+		// 移除录制(无锁，可在渲染线程中调用)
+		// 录制交由后台线程在不再使用后释放，调用后不能再访问record
+		void Unregister(MidiTrackRecord* record);
+
+		// 请求在后台线程中把录制的轨道保存为midi文件
+		void SaveMidiFile(string path, vector<MidiTrackRecord*>& records, float bpm, float tickForQuarterNote);
+
+	private:
+		void Run();
+
+		// 生成录制的midi文件
+		MidiFile* CreateMidiFile(MidiRecordSaveRequest& req);
+
+		// 释放链表中已移除的录制
+		static void DelRecords(MidiTrackRecord* head);
+
+	private:
+		//已注册的录制(只在后台线程中访问)
+		vector<MidiTrackRecord*> records;
+
+		//渲染线程交接过来的注册和移除链表
+		atomic<MidiTrackRecord*> registerHead;
+		atomic<MidiTrackRecord*> unregisterHead;
+
+		//保存请求及其锁
+		list<MidiRecordSaveRequest> saveRequests;
+		mutex lock;
+
+		thread recThread;
+		Semaphore waitSem;
+		atomic<bool> isStop;
+		bool isRunning = false;
+	};
+}
+
+#endif
@@ -1,20 +1,43 @@
 ﻿#include"MidiTrackRecord.h"
+#include"Ventrue.h"
+#include"MidiRecorder.h"
 
 namespace ventrue
 {
-	MidiTrackRecord::MidiTrackRecord()
+	//录制事件环形缓存的大小(必须为2的幂)
+	//后台线程每10ms转换一次，足够容纳这段时间内的事件
+	static const uint32_t RECORD_RING_SIZE = 4096;
+
+	MidiTrackRecord::MidiTrackRecord(Ventrue* ventrue)
+		:ringWritePos(0)
+		, ringReadPos(0)
+		, droppedCount(0)
+		, startSeq(0)
+		, pendingTrack(nullptr)
 	{
+		this->ventrue = ventrue;
+
+		//由后台线程定时转换录制的事件
+		if (ventrue != nullptr)
+			ventrue->GetMidiRecorder()->Register(this);
 	}
 
 	MidiTrackRecord::~MidiTrackRecord()
 	{
 		Clear();
+		free(ring);
+
+		MidiTrack* track = pendingTrack.exchange(nullptr);
+		DEL(track);
 	}
 
 	void MidiTrackRecord::Clear()
 	{
 		isRecord = false;
+
+		lock_guard<mutex> lockGuard(trackLock);
 		DEL(midiTrack);
+		ringReadPos.store(ringWritePos.load(memory_order_acquire), memory_order_release);
 	}
 
 	void MidiTrackRecord::SetBPM(float bpm)
@@ -28,31 +51,111 @@ namespace ventrue
 		tickForQuarterNote = tick;
 	}
 
+	//分配开始录制使用的资源
+	void MidiTrackRecord::NewStartData(MidiRecordStartData& startData)
+	{
+		if (startData.isNeedRing && startData.ring == nullptr)
+			startData.ring = (MidiRecordEvent*)malloc(RECORD_RING_SIZE * sizeof(MidiRecordEvent));
+
+		if (startData.midiTrack == nullptr)
+			startData.midiTrack = new MidiTrack();
+	}
+
+	//释放开始录制使用的资源
+	void MidiTrackRecord::DelStartData(MidiRecordStartData& startData)
+	{
+		free(startData.ring);
+		startData.ring = nullptr;
+		DEL(startData.midiTrack);
+	}
+
 	//开始录制Midi,支持中途变速录制
-	void MidiTrackRecord::Start()
+	//只写入开始录制的设置，录制轨道由读取端在读取到开始位置时替换，
+	//开始位置之前的事件属于上一次录制，会随旧的录制轨道一起丢弃
+	void MidiTrackRecord::Start(MidiRecordStartData* startData)
 	{
 		if (isRecord)
 			return;
 
-		Clear();
-		midiTrack = new MidiTrack();
+		MidiRecordStartData data;
+		if (startData == nullptr)
+			startData = &data;
+
+		//首次开始录制时使用预先分配的环形缓存
+		//读取端在读取到事件之后才会访问ring
+		if (ring == nullptr)
+		{
+			startData->isNeedRing = true;
+			NewStartData(*startData);
+			ring = startData->ring;
+			startData->ring = nullptr;
+			startData->isNeedRing = false;
+		}
+
+		//上一次开始录制的轨道还未被读取端取走时，交还给调用者释放
+		if (startData->midiTrack == nullptr)
+			NewStartData(*startData);
+		startData->midiTrack = pendingTrack.exchange(startData->midiTrack, memory_order_acq_rel);
 
 		//
-		clock::time_point curTime = clock::now();
-		if (isRecord == false)
-			startRecordTime = curTime;
+		startSeq.fetch_add(1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
 
-		if (msPerTick != 0) {
-			int tm = (int)(chrono::duration_cast<res>(curTime - startRecordTime).count() * 0.001f);
-			baseTick = (int)(baseTick + tm / msPerTick);
-		}
+		startRingPos = ringWritePos.load(memory_order_relaxed);
+		startSamplePos = GetRecordSamplePos();
+		if (ventrue != nullptr)
+			startSampleRate = ventrue->GetSampleProcessRate();
+		startMsPerTick = microTempo / tickForQuarterNote * 0.001f;
+		startTickForQuarterNote = tickForQuarterNote;
 
-		startRecordTime = curTime;
-		msPerTick = microTempo / tickForQuarterNote * 0.001f;
-		isRecord = true;
+		startSeq.fetch_add(1, memory_order_release);
 
 		//
+		isRecord = true;
 		RecordSetTempo(microTempo);
+
+		if (startData == &data)
+			DelStartData(data);
+	}
+
+	//在读取端应用渲染线程中的开始录制
+	//返回值 1:已应用，0:尚未读取到开始录制的位置，-1:开始录制的设置正在被修改
+	int MidiTrackRecord::ApplyStart(uint32_t readPos)
+	{
+		uint32_t seq = startSeq.load(memory_order_acquire);
+		if (seq & 1)
+			return -1;
+
+		uint32_t ringPos = startRingPos;
+		int64_t samplePos = startSamplePos;
+		float rate = startSampleRate;
+		float newMsPerTick = startMsPerTick;
+		float tickQuarterNote = startTickForQuarterNote;
+
+		atomic_thread_fence(memory_order_acquire);
+		if (startSeq.load(memory_order_relaxed) != seq)
+			return -1;
+
+		if (ringPos != readPos)
+			return 0;
+
+		//
+		MidiTrack* track = pendingTrack.exchange(nullptr, memory_order_acq_rel);
+		if (track == nullptr)
+			track = new MidiTrack();
+
+		DEL(midiTrack);
+		midiTrack = track;
+		midiTrack->SetTickForQuarterNote(tickQuarterNote);
+
+		if (msPerTick != 0)
+			baseTick = TransToRecordMidiTick(samplePos);
+
+		startRecordSamplePos = samplePos;
+		sampleRate = rate;
+		msPerTick = newMsPerTick;
+		appliedStartSeq = seq;
+		return 1;
 	}
 
 
@@ -72,6 +175,9 @@ namespace ventrue
 	//baseTickForQuarterNote: 改变轨道的tickForQuarterNote
 	MidiTrack* MidiTrackRecord::TakeMidiTrack(float baseTickForQuarterNote)
 	{
+		Drain();
+
+		lock_guard<mutex> lockGuard(trackLock);
 		if (midiTrack == nullptr)
 			return nullptr;
 
@@ -83,18 +189,158 @@ namespace ventrue
 		return cpyMidiTrack;
 	}
 
+	//把环形缓存中的事件转换为midi轨道事件
+	void MidiTrackRecord::Drain()
+	{
+		lock_guard<mutex> lockGuard(trackLock);
+
+		uint32_t readPos = ringReadPos.load(memory_order_relaxed);
+		uint32_t writePos = ringWritePos.load(memory_order_acquire);
+		bool isStartPending = startSeq.load(memory_order_acquire) != appliedStartSeq;
+		if (readPos == writePos && !isStartPending)
+			return;
+
+		for (;;)
+		{
+			//有新的开始录制时，读取到开始位置时替换录制轨道
+			if (isStartPending)
+			{
+				int ret = ApplyStart(readPos);
+				if (ret < 0)
+					break;
+				isStartPending = (ret == 0);
+			}
+
+			if (readPos == writePos)
+				break;
+
+			if (midiTrack != nullptr)
+				AddEvent(ring[readPos & (RECORD_RING_SIZE - 1)]);
+			readPos++;
+		}
+
+		ringReadPos.store(readPos, memory_order_release);
+	}
+
+	//获取当前录制位置
+	int64_t MidiTrackRecord::GetRecordSamplePos()
+	{
+		if (ventrue == nullptr)
+			return 0;
+
+		return ventrue->GetRenderSamplePos();
+	}
 
-	//变换当前录制时间点为tick数量
-	int MidiTrackRecord::TransCurTimeToRecordMidiTick()
+	//变换录制位置(引擎已渲染的采样数)为tick数量
+	int MidiTrackRecord::TransToRecordMidiTick(int64_t samplePos)
 	{
-		return TransToRecordMidiTick(clock::now());
+		double ms = (samplePos - startRecordSamplePos) * 1000.0 / sampleRate;
+		return (int)(baseTick + ms / msPerTick);
 	}
 
-	//变换录制时间点(单位:ms)为tick数量
-	int MidiTrackRecord::TransToRecordMidiTick(clock::time_point curtTime)
+	//写入一个事件到环形缓存
+	//环形缓存已满时丢弃事件，不会等待
+	void MidiTrackRecord::PushEvent(MidiEventType type, int channel, int value1, int value2, float microTempo)
 	{
-		int tm = (int)(chrono::duration_cast<res>(curtTime - startRecordTime).count() * 0.001f);
-		return (int)(baseTick + tm / msPerTick);
+		uint32_t writePos = ringWritePos.load(memory_order_relaxed);
+		if (writePos - ringReadPos.load(memory_order_acquire) >= RECORD_RING_SIZE)
+		{
+			droppedCount.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+
+		MidiRecordEvent& recEv = ring[writePos & (RECORD_RING_SIZE - 1)];
+		recEv.samplePos = GetRecordSamplePos();
+		recEv.type = type;
+		recEv.channel = channel;
+		recEv.value1 = value1;
+		recEv.value2 = value2;
+		recEv.microTempo = microTempo;
+
+		ringWritePos.store(writePos + 1, memory_order_release);
+	}
+
+	//添加环形缓存中的事件到midi轨道
+	void MidiTrackRecord::AddEvent(MidiRecordEvent& recEv)
+	{
+		int tick = TransToRecordMidiTick(recEv.samplePos);
+
+		switch (recEv.type)
+		{
+		case MidiEventType::Tempo:
+		{
+			TempoEvent* tempoEvent = new TempoEvent();
+			tempoEvent->startTick = tick;
+			tempoEvent->microTempo = recEv.microTempo;
+			midiTrack->AddEvent(tempoEvent);
+		}
+		break;
+
+		case MidiEventType::NoteOn:
+		{
+			NoteOnEvent* noteOnEvent = new NoteOnEvent();
+			noteOnEvent->note = recEv.value1;
+			noteOnEvent->velocity = recEv.value2;
+			noteOnEvent->channel = recEv.channel;
+			noteOnEvent->startTick = tick;
+			midiTrack->AddEvent(noteOnEvent);
+		}
+		break;
+
+		case MidiEventType::NoteOff:
+		{
+			NoteOnEvent* noteOnEvent = midiTrack->FindNoteOnEvent(recEv.value1, recEv.channel);
+			if (noteOnEvent == nullptr)
+				break;
+
+			NoteOffEvent* noteOffEvent = new NoteOffEvent();
+			noteOffEvent->note = recEv.value1;
+			noteOffEvent->velocity = recEv.value2;
+			noteOffEvent->channel = recEv.channel;
+			noteOffEvent->startTick = tick;
+
+			noteOnEvent->endTick = noteOffEvent->startTick;
+			noteOnEvent->noteOffEvent = noteOffEvent;
+			noteOffEvent->noteOnEvent = noteOnEvent;
+
+			midiTrack->AddEvent(noteOffEvent);
+		}
+		break;
+
+		case MidiEventType::ProgramChange:
+		{
+			ProgramChangeEvent* programEvent = new ProgramChangeEvent();
+			programEvent->startTick = tick;
+			programEvent->channel = recEv.channel;
+			programEvent->value = recEv.value1;
+			midiTrack->AddEvent(programEvent);
+		}
+		break;
+
+		case MidiEventType::Controller:
+		{
+			ControllerEvent* ctrlEvent = new ControllerEvent();
+			ctrlEvent->startTick = tick;
+			ctrlEvent->ctrlType = (MidiControllerType)recEv.value1;
+			ctrlEvent->value = recEv.value2;
+			ctrlEvent->channel = recEv.channel;
+			midiTrack->AddEvent(ctrlEvent);
+		}
+		break;
+
+		case MidiEventType::PitchBend:
+		{
+			PitchBendEvent* pitchBendEvent = new PitchBendEvent();
+			pitchBendEvent->startTick = tick;
+			pitchBendEvent->value = recEv.value1;
+			pitchBendEvent->channel = recEv.channel;
+			midiTrack->AddEvent(pitchBendEvent);
+		}
+		break;
+
+		default:
+			break;
+		}
 	}
 
 	//录制SetTempo
@@ -103,10 +349,7 @@ namespace ventrue
 		if (!isRecord)
 			return;
 
-		TempoEvent* tempoEvent = new TempoEvent();
-		tempoEvent->startTick = TransCurTimeToRecordMidiTick();
-		tempoEvent->microTempo = microTempo;
-		midiTrack->AddEvent(tempoEvent);
+		PushEvent(MidiEventType::Tempo, -1, 0, 0, microTempo);
 	}
 
 	//录制OnKey
@@ -115,12 +358,7 @@ namespace ventrue
 		if (!isRecord)
 			return;
 
-		NoteOnEvent* noteOnEvent = new NoteOnEvent();
-		noteOnEvent->note = key;
-		noteOnEvent->velocity = (int)velocity;
-		noteOnEvent->channel = channel;
-		noteOnEvent->startTick = TransCurTimeToRecordMidiTick();
-		midiTrack->AddEvent(noteOnEvent);
+		PushEvent(MidiEventType::NoteOn, channel, key, (int)velocity);
 	}
 
 	//录制OffKey
@@ -129,18 +367,7 @@ namespace ventrue
 		if (!isRecord)
 			return;
 
-		NoteOffEvent* noteOffEvent = new NoteOffEvent();
-		noteOffEvent->note = key;
-		noteOffEvent->velocity = (int)velocity;
-		noteOffEvent->channel = channel;
-		noteOffEvent->startTick = TransCurTimeToRecordMidiTick();
-
-		NoteOnEvent* noteOnEvent = midiTrack->FindNoteOnEvent(key, channel);
-		noteOnEvent->endTick = noteOffEvent->startTick;
-		noteOnEvent->noteOffEvent = noteOffEvent;
-		noteOffEvent->noteOnEvent = noteOnEvent;
-
-		midiTrack->AddEvent(noteOffEvent);
+		PushEvent(MidiEventType::NoteOff, channel, key, (int)velocity);
 	}
 
 	//录制设置乐器
@@ -149,11 +376,7 @@ namespace ventrue
 		if (!isRecord)
 			return;
 
-		ProgramChangeEvent* programEvent = new ProgramChangeEvent();
-		programEvent->startTick = TransCurTimeToRecordMidiTick();
-		programEvent->channel = channel;
-		programEvent->value = instNum;
-		midiTrack->AddEvent(programEvent);
+		PushEvent(MidiEventType::ProgramChange, channel, instNum, 0);
 	}
 
 	//录制设置midi控制器
@@ -162,12 +385,7 @@ namespace ventrue
 		if (!isRecord)
 			return;
 
-		ControllerEvent* ctrlEvent = new ControllerEvent();
-		ctrlEvent->startTick = TransCurTimeToRecordMidiTick();
-		ctrlEvent->ctrlType = type;
-		ctrlEvent->value = value;
-		ctrlEvent->channel = channel;
-		midiTrack->AddEvent(ctrlEvent);
+		PushEvent(MidiEventType::Controller, channel, (int)type, value);
 	}
 
 	//录制设置pitchBend
@@ -176,10 +394,6 @@ namespace ventrue
 		if (!isRecord)
 			return;
 
-		PitchBendEvent* pitchBendEvent = new PitchBendEvent();
-		pitchBendEvent->startTick = TransCurTimeToRecordMidiTick();
-		pitchBendEvent->value = value;
-		pitchBendEvent->channel = channel;
-		midiTrack->AddEvent(pitchBendEvent);
+		PushEvent(MidiEventType::PitchBend, channel, value, 0);
 	}
 }
@@ -7,14 +7,44 @@
 
 namespace ventrue
 {
+	// 录制的midi事件
+	struct MidiRecordEvent
+	{
+		//事件发生时引擎已渲染的采样数
+		int64_t samplePos;
+		MidiEventType type;
+		int channel;
+		//NoteOn/NoteOff: 音符, Controller: 控制器类型, ProgramChange/PitchBend: 值
+		int value1;
+		//NoteOn/NoteOff: 力度, Controller: 值
+		int value2;
+		//Tempo: 一个四分音符的微秒数
+		float microTempo;
+	};
+
+	// 开始录制时使用的资源
+	// 在渲染线程之外分配，开始录制时渲染线程中只交换指针
+	struct MidiRecordStartData
+	{
+		//是否需要分配环形缓存(首次开始录制时)
+		bool isNeedRing = false;
+		MidiRecordEvent* ring = nullptr;
+		MidiTrack* midiTrack = nullptr;
+	};
+
 	/*
 	* midi轨道录制
+	* 录制时事件以引擎已渲染的采样数作为时间戳写入预分配的无锁环形缓存，不分配内存，
+	* 之后由MidiRecorder的后台线程(或获取轨道时)转换为midi轨道事件
+	* 环形缓存只允许一个写入线程(渲染线程)
 	* by cymheart, 2020--2021.
 	*/
 	class MidiTrackRecord
 	{
 	public:
-		MidiTrackRecord();
+		//ventrue: 提供录制时的渲染位置和采样率(为nullptr时所有事件都在起始位置)
+		//ventrue不为nullptr时录制注册到MidiRecorder，需通过MidiRecorder::Unregister释放
+		MidiTrackRecord(Ventrue* ventrue = nullptr);
 		~MidiTrackRecord();
 
 		void Clear();
@@ -23,7 +53,21 @@ namespace ventrue
 		void SetTickForQuarterNote(float tickForQuarterNote);
 
 		//开始录制Midi,支持中途变速录制
-		void Start();
+		//startData: 预先分配的资源，未使用的和被替换下来的资源留在其中由调用者释放
+		//为nullptr时在当前线程中分配
+		void Start(MidiRecordStartData* startData = nullptr);
+
+		//是否已分配环形缓存
+		inline bool IsRingAllocated()
+		{
+			return ring != nullptr;
+		}
+
+		//分配开始录制使用的资源
+		static void NewStartData(MidiRecordStartData& startData);
+
+		//释放开始录制使用的资源
+		static void DelStartData(MidiRecordStartData& startData);
 
 		//停止录制
 		void Stop();
@@ -34,6 +78,15 @@ namespace ventrue
 			return isRecord;
 		}
 
+		//获取因环形缓存已满而丢弃的事件数量
+		inline uint64_t GetDroppedCount()
+		{
+			return droppedCount.load(memory_order_relaxed);
+		}
+
+		//把环形缓存中的事件转换为midi轨道事件
+		void Drain();
+
 		//获取录制的midi轨道
 		MidiTrack* TakeMidiTrack();
 
@@ -41,11 +94,8 @@ namespace ventrue
 		//baseTickForQuarterNote: 改变轨道的tickForQuarterNote
 		MidiTrack* TakeMidiTrack(float baseTickForQuarterNote);
 
-		//变换当前录制时间点为tick数量
-		int TransCurTimeToRecordMidiTick();
-
-		//变换录制时间点(单位:ms)为tick数量
-		int TransToRecordMidiTick(clock::time_point curtTime);
+		//变换录制位置(引擎已渲染的采样数)为tick数量
+		int TransToRecordMidiTick(int64_t samplePos);
 
 
 		//录制SetTempo
@@ -62,10 +112,53 @@ namespace ventrue
 		void RecordSetPitchBend(int value, int channel);
 
 	private:
+		//获取当前录制位置
+		int64_t GetRecordSamplePos();
+
+		//写入一个事件到环形缓存
+		void PushEvent(MidiEventType type, int channel, int value1, int value2, float microTempo = 0);
+
+		//添加环形缓存中的事件到midi轨道
+		void AddEvent(MidiRecordEvent& recEv);
+
+		//在读取端应用渲染线程中的开始录制
+		//返回值 1:已应用，0:尚未读取到开始录制的位置，-1:开始录制的设置正在被修改
+		int ApplyStart(uint32_t readPos);
+
+	private:
+		friend class MidiRecorder;
+
+		Ventrue* ventrue = nullptr;
+
+		//MidiRecorder注册和移除链表中的下一个录制
+		MidiTrackRecord* registerNext = nullptr;
+		MidiTrackRecord* unregisterNext = nullptr;
+
 		//是否录制Midi
 		bool isRecord = false;
 		//录制midi所在的midi轨道
 		MidiTrack* midiTrack = nullptr;
+		//midiTrack和环形缓存读取端的锁
+		mutex trackLock;
+
+		//录制事件的环形缓存(首次开始录制时分配)
+		MidiRecordEvent* ring = nullptr;
+		atomic<uint32_t> ringWritePos;
+		atomic<uint32_t> ringReadPos;
+		//因环形缓存已满而丢弃的事件数量
+		atomic<uint64_t> droppedCount;
+
+		//渲染线程中开始录制时的设置，由读取端在读取到startRingPos时应用
+		//startSeq为奇数时表示设置正在被修改
+		atomic<uint32_t> startSeq;
+		uint32_t appliedStartSeq = 0;
+		uint32_t startRingPos = 0;
+		int64_t startSamplePos = 0;
+		float startSampleRate = 44100;
+		float startMsPerTick = 0;
+		float startTickForQuarterNote = 480;
+		//开始录制时使用的录制轨道
+		atomic<MidiTrack*> pendingTrack;
 
 		/// <summary>
 	   /// 在音乐中我们一般用BPM来表述乐曲的速度，BPM(Beat per Minute)的意思是每分钟的拍子数。
@@ -85,8 +178,10 @@ namespace ventrue
 		float msPerTick = 0;
 		//录制midi时的基tick
 		int baseTick = 0;
-		//开始录制的起始时间点
-		clock::time_point startRecordTime;
+		//开始录制时的渲染位置
+		int64_t startRecordSamplePos = 0;
+		//录制时的采样率
+		float sampleRate = 44100;
 	};
 
 }
@@ -601,6 +601,8 @@ namespace ventrue
 		float outputValue = 0;
 		float outputValueMin = 0;
 		float outputValueMax = 0;
+
+		friend class SoundFontCache;
 	};
 
 }
@@ -4,6 +4,7 @@
 namespace ventrue
 {
     Preset::Preset()
+        :isReady(true)
     {
         globalRegion = new Region(RegionType::Preset);
         presetRegionLinkInfoList = new InstLinkToPresetRegionInfoList;
@@ -34,14 +34,32 @@ namespace ventrue
 		// 连接一个乐器到一个presetRegion
 		Region* LinkInstrument(Instrument* inst);
 
+		// 预设使用的样本是否都已加载完成
+		inline bool IsReady()
+		{
+			return isReady.load(memory_order_acquire);
+		}
+
+		inline void SetReady(bool ready)
+		{
+			isReady.store(ready, memory_order_release);
+		}
+
 	public:
 		string name;
 		int bankSelectMSB = 0;
 		int bankSelectLSB = 0;
 		int instrumentNum = 0;
 
+		//所属的音源(由Ventrue自身解析时为nullptr)
+		SoundFont* soundFont = nullptr;
+
 		Region* globalRegion;
 		InstLinkToPresetRegionInfoList* presetRegionLinkInfoList;
+
+	private:
+		//渐进加载音源时，样本在后台加载完成之前为false
+		atomic<bool> isReady;
 	};
 }
 
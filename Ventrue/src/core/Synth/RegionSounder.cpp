@@ -4,6 +4,8 @@
 #include"RegionModulation.h"
 #include"Lfo.h"
 #include"Ventrue.h"
+#include"SampleStore.h"
+#include"SampleStreamer.h"
 #include"UnitTransform.h"
 #include"VirInstrument.h"
 using namespace dsignal;
@@ -61,6 +63,8 @@ namespace ventrue {
 	{
 		isRealtimeControl = true;
 		input = nullptr;
+		isStreamSample = false;
+		streamBuffer = nullptr;
 		insideCtrlModulatorList.CloseAllInsideModulator();
 		regionModulation->Clear();
 		ventrue = nullptr;
@@ -161,11 +165,42 @@ namespace ventrue {
 	// 释放
 	void RegionSounder::Release()
 	{
+		if (sample != nullptr && ventrue != nullptr)
+		{
+			GetSampleStore(sample)->Release(sample);
+			ventrue->GetSampleStreamer()->Release(streamBuffer);
+			streamBuffer = nullptr;
+			sample = nullptr;
+		}
+
 		//delete this;
 		VentruePool::GetInstance().RegionSounderPool().Push(this);
 	}
 
 
+	//获取管理样本的样本存储
+	//共享音源的样本由音源自己的样本存储管理，不使用当前Ventrue的样本存储
+	SampleStore* RegionSounder::GetSampleStore(Sample* sample)
+	{
+		return sample->store != nullptr ? sample->store : ventrue->GetSampleStore();
+	}
+
+	//设置样本(从样本存储中获取解码后的pcm)
+	//样本尚未解码时返回false
+	bool RegionSounder::SetSample(Sample* sample)
+	{
+		input = GetSampleStore(sample)->Acquire(sample);
+		if (input == nullptr)
+			return false;
+
+		this->sample = sample;
+
+		//流式样本需要I/O线程为其提前读取后续数据
+		//样本起始位置在调制后才能确定，流缓存在按键时分配
+		isStreamSample = sample->isStreaming;
+		return true;
+	}
+
 	RegionSounder* RegionSounder::New()
 	{
 		RegionSounder* regionSounder = VentruePool::GetInstance().RegionSounderPool().Pop();
@@ -215,6 +250,10 @@ namespace ventrue {
 
 		ModulationParams();
 
+		//从样本起始位置开始为流式样本读取数据
+		if (isStreamSample && streamBuffer == nullptr)
+			streamBuffer = ventrue->GetSampleStreamer()->Acquire(sample, GetPlayStartIdx());
+
 		//使用滑音
 		UsePortamento();
 
@@ -543,6 +582,12 @@ namespace ventrue {
 			+ (int)modifyedGenList->GetAmount(GeneratorType::StartAddrsCoarseOffset) * 32768;
 	}
 
+	//获取开始播放的样本位置(超出样本范围的起始偏移从0开始播放)
+	uint32_t RegionSounder::GetPlayStartIdx()
+	{
+		return (sampleStartIdx < sampleEndIdx ? sampleStartIdx : 0);
+	}
+
 	//设置样本结束位置
 	void RegionSounder::SetSampleEndIdx()
 	{
@@ -1211,7 +1256,7 @@ namespace ventrue {
 			isComputedLoopSample = false;
 
 		if (lastSamplePos == -1) {
-			lastSamplePos = 0;
+			lastSamplePos = (float)GetPlayStartIdx();
 			return 0;
 		}
 
@@ -1235,8 +1280,27 @@ namespace ventrue {
 
 		//计算采样点插值
 		float a = (float)(lastSamplePos - prevIntPos);
-		return (input[prevIntPos] * (1.0f - a) + input[nextIntPos] * a);
+		if (!isStreamSample)
+			return (input[prevIntPos] * (1.0f - a) + input[nextIntPos] * a);
+
+		//通知I/O线程当前的播放位置，循环时只需要读取到循环结束点
+		if (streamBuffer != nullptr)
+		{
+			streamBuffer->SetPlayPos(prevIntPos,
+				isComputedLoopSample ? sampleEndLoopIdx + 1 : sampleEndIdx + 1);
+		}
+
+		return (ReadStreamSample(prevIntPos) * (1.0f - a) + ReadStreamSample(nextIntPos) * a);
+	}
+
+	//读取流式样本的采样点
+	inline float RegionSounder::ReadStreamSample(uint32_t idx)
+	{
+		if (streamBuffer != nullptr)
+			return streamBuffer->Read(idx);
 
+		//没有空闲的流缓存时，只能播放常驻内存的开头部分
+		return (idx < sample->streamHeadSize ? input[idx] : 0);
 	}
 
 
@@ -91,11 +91,9 @@ namespace ventrue
 			return rightChannelSamples;
 		}
 
-		void SetSample(Sample* sample)
-		{
-			this->sample = sample;
-			input = sample->pcm;
-		}
+		//设置样本(从样本存储中获取解码后的pcm)
+		//样本尚未解码时返回false
+		bool SetSample(Sample* sample);
 
 
 		// 获取最终修改后的生成器数据表
@@ -174,6 +172,9 @@ namespace ventrue
 
 	private:
 
+		//获取管理样本的样本存储
+		SampleStore* GetSampleStore(Sample* sample);
+
 		//设置不需要调制器调制的参数值
 		void SetNotModParams(int key, float velocity);
 
@@ -194,6 +195,8 @@ namespace ventrue
 		void SetPan();
 		//设置样本起始位置
 		void SetSampleStartIdx();
+		//获取开始播放的样本位置
+		uint32_t GetPlayStartIdx();
 		//设置样本结束位置
 		void SetSampleEndIdx();
 		//设置样本循环起始位置
@@ -273,6 +276,9 @@ namespace ventrue
 
 		float NextAdjustPitchSample(float sampleSpeed);
 
+		//读取流式样本的采样点
+		inline float ReadStreamSample(uint32_t idx);
+
 		// 重设低通滤波器
 		void ResetLowPassFilter(float computedSec);
 
@@ -314,6 +320,10 @@ namespace ventrue
 		Sample* sample = nullptr;
 		float* input = nullptr;
 
+		//是否为流式样本，及其对应的流缓存
+		bool isStreamSample = false;
+		SampleStreamBuffer* streamBuffer = nullptr;
+
 
 		Iir::RBJ::LowPass* biquad = nullptr;
 		double biquadSampleRate = 44100;
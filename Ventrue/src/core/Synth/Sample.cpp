@@ -1,29 +1,169 @@
 ﻿#include"Sample.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLE_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAMPLE_USE_NEON
+#endif
+
 namespace ventrue
 {
-	Sample::~Sample()
+	//16位样本转换为浮点样本 dst[i] = src[i] * scale
+	static void ConvertShortToFloat(const short* src, float* dst, uint32_t size, float scale)
 	{
-		free(pcm);
+		uint32_t i = 0;
+
+#if defined(SAMPLE_USE_SSE2)
+		__m128 vscale = _mm_set1_ps(scale);
+		for (; i + 8 <= size; i += 8)
+		{
+			__m128i s16 = _mm_loadu_si128((const __m128i*)(src + i));
+			//符号扩展为32位整数
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+		}
+#elif defined(SAMPLE_USE_NEON)
+		float32x4_t vscale = vdupq_n_f32(scale);
+		for (; i + 8 <= size; i += 8)
+		{
+			int16x8_t s16 = vld1q_s16(src + i);
+			int32x4_t lo = vmovl_s16(vget_low_s16(s16));
+			int32x4_t hi = vmovl_s16(vget_high_s16(s16));
+			vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(lo), vscale));
+			vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(hi), vscale));
+		}
+#endif
+
+		for (; i < size; i++)
+			dst[i] = src[i] * scale;
 	}
 
-	// 设置样本
-	void Sample::SetSamples(short* samples, uint32_t size, uint8_t* sm24)
+	Sample::~Sample()
 	{
-		this->size = size;
-		pcm = (float*)malloc(size * sizeof(float));
+		if (!isExternalPcm)
+			free(pcm);
+		free(srcSamples);
+		free(srcSm24);
+		free(streamLoopHead);
+		DEL(streamSource);
+	}
 
+	//16位(或附加sm24低8位)样本转换为pcm
+	static void ConvertSamples(const short* samples, const uint8_t* sm24, float* dst, uint32_t size)
+	{
 		if (sm24 == nullptr)
 		{
-			for (uint32_t i = 0; i < size; i++)
-				pcm[i] = samples[i] / 32767.0f * 0.7f;
+			ConvertShortToFloat(samples, dst, size, 0.7f / 32767.0f);
 		}
 		else
 		{
 			for (uint32_t i = 0; i < size; i++)
 			{
-				pcm[i] = (samples[i] << 8 | sm24[i]) / 32767.0f * 0.7f;
+				dst[i] = (samples[i] << 8 | sm24[i]) / 32767.0f * 0.7f;
 			}
 		}
 	}
+
+	// 设置样本
+	void Sample::SetSamples(short* samples, uint32_t size, uint8_t* sm24)
+	{
+		this->size = size;
+		pcm = (float*)malloc(size * sizeof(float));
+		ConvertSamples(samples, sm24, pcm, size);
+	}
+
+	// 设置为流式样本
+	void Sample::SetStreamHead(uint32_t size, float* head, uint32_t headSize,
+		float* loopHead, uint32_t loopHeadStart, uint32_t loopHeadSize,
+		SampleStreamSource* source)
+	{
+		if (!isExternalPcm)
+			free(pcm);
+
+		this->size = size;
+		pcm = head;
+		isExternalPcm = false;
+
+		isStreaming = true;
+		streamHeadSize = headSize;
+		streamLoopHead = loopHead;
+		streamLoopHeadStart = loopHeadStart;
+		streamLoopHeadSize = loopHeadSize;
+		streamSource = source;
+	}
+
+	// 分配pcm空间，由调用者直接填充已解码的样本
+	float* Sample::AllocPcm(uint32_t size)
+	{
+		if (!isExternalPcm)
+			free(pcm);
+
+		this->size = size;
+		pcm = (float*)malloc(size * sizeof(float));
+		isExternalPcm = false;
+		return pcm;
+	}
+
+	// 设置原始样本源(不立即解码，由SampleStore按需解码)
+	void Sample::SetSourceSamples(short* samples, uint32_t size, uint8_t* sm24)
+	{
+		this->size = size;
+		srcSamples = (short*)malloc(size * sizeof(short));
+		memcpy(srcSamples, samples, size * sizeof(short));
+
+		if (sm24 != nullptr)
+		{
+			srcSm24 = (uint8_t*)malloc(size);
+			memcpy(srcSm24, sm24, size);
+		}
+	}
+
+	// 由原始样本源解码出pcm
+	void Sample::DecodePcm()
+	{
+		if (pcm != nullptr || srcSamples == nullptr)
+			return;
+
+		uint32_t sz = (uint32_t)size;
+		SetSamples(srcSamples, sz, srcSm24);
+	}
+
+	// 由原始样本源解码出一份新的pcm(不修改样本，由调用者设置到pcm)
+	float* Sample::DecodeToNewPcm()
+	{
+		if (srcSamples == nullptr)
+			return nullptr;
+
+		float* newPcm = (float*)malloc(size * sizeof(float));
+		ConvertSamples(srcSamples, srcSm24, newPcm, (uint32_t)size);
+		return newPcm;
+	}
+
+	// 释放已解码的pcm(保留原始样本源)
+	void Sample::FreePcm()
+	{
+		if (srcSamples == nullptr)
+			return;
+
+		free(pcm);
+		pcm = nullptr;
+	}
+
+	// 由原始样本源解码出pcm，并释放原始样本源
+	void Sample::ResolveSourceSamples()
+	{
+		if (srcSamples == nullptr)
+			return;
+
+		DecodePcm();
+
+		free(srcSamples);
+		free(srcSm24);
+		srcSamples = nullptr;
+		srcSm24 = nullptr;
+	}
 }
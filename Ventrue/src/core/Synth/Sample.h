@@ -5,6 +5,23 @@
 
 namespace ventrue
 {
+	// 流式样本在磁盘文件中的数据源
+	struct SampleStreamSource
+	{
+		// 文件路径
+		string filePath;
+		// 第一个采样帧(所需声道)在文件中的字节偏移
+		uint64_t dataOffset = 0;
+		// 每帧的字节数
+		int blockAlign = 2;
+		// 每个采样的bit数
+		int bitsPerSample = 16;
+		// 是否为浮点格式
+		bool isFloat = false;
+		// 转换到pcm时的幅值缩放
+		float scale = 1.0f;
+	};
+
 	//by cymheart, 2020--2021.
 	class Sample
 	{
@@ -14,6 +31,43 @@ namespace ventrue
 		// 设置样本
 		void SetSamples(short* samples, uint32_t size, uint8_t* sm24 = nullptr);
 
+		// 分配pcm空间，由调用者直接填充已解码的样本
+		float* AllocPcm(uint32_t size);
+
+		// 设置原始样本源(不立即解码，由SampleStore按需解码)
+		void SetSourceSamples(short* samples, uint32_t size, uint8_t* sm24 = nullptr);
+
+		// 由原始样本源解码出pcm
+		void DecodePcm();
+
+		// 由原始样本源解码出一份新的pcm(不修改样本，由调用者设置到pcm)
+		float* DecodeToNewPcm();
+
+		// 释放已解码的pcm(保留原始样本源)
+		void FreePcm();
+
+		// 由原始样本源解码出pcm，并释放原始样本源(之后按已解码的普通样本使用)
+		void ResolveSourceSamples();
+
+		// 设置为流式样本
+		// 只保留开头的headSize个采样点和循环起始处的loopHeadSize个采样点在内存中，
+		// 其余数据由SampleStreamer在后台线程中从source读取
+		void SetStreamHead(uint32_t size, float* head, uint32_t headSize,
+			float* loopHead, uint32_t loopHeadStart, uint32_t loopHeadSize,
+			SampleStreamSource* source);
+
+		// 是否已解码
+		inline bool IsDecoded()
+		{
+			return pcm != nullptr;
+		}
+
+		// 解码后pcm所占字节数
+		inline size_t GetPcmByteSize()
+		{
+			return size * sizeof(float);
+		}
+
 		// 设置原始音调
 		inline void SetOriginalPitch(float pitch)
 		{
@@ -83,6 +137,45 @@ namespace ventrue
 		// 连接的样本
 		Sample* sampleLink = nullptr;
 
+		// 原始样本源(按需解码模式下保留)
+		short* srcSamples = nullptr;
+		uint8_t* srcSm24 = nullptr;
+
+		// pcm是否由外部持有(如内存映射的缓存文件)，此时不负责释放
+		bool isExternalPcm = false;
+
+		// 正在使用此样本的发声区域数量
+		int playingCount = 0;
+
+		// 固定驻留计数(大于0时不会被淘汰)
+		int pinCount = 0;
+
+		// 管理此样本按需解码的样本存储(只有保留了原始样本源的样本才有)
+		// 共享音源的样本由音源自己的样本存储管理，不进入各个Ventrue的样本存储
+		SampleStore* store = nullptr;
+
+		// 是否在SampleStore的LRU列表中
+		// LRU列表直接链接样本，在渲染线程中调整列表时不需要分配内存
+		bool isInLru = false;
+		Sample* lruPrev = nullptr;
+		Sample* lruNext = nullptr;
+
+		// 是否已请求SampleStore的加载线程解码
+		bool isDecodeRequested = false;
+		Sample* nextDecodeRequest = nullptr;
+
+		// 是否为流式样本(此时pcm只包含开头的streamHeadSize个采样点)
+		bool isStreaming = false;
+		uint32_t streamHeadSize = 0;
+
+		// 常驻内存的循环起始处数据
+		float* streamLoopHead = nullptr;
+		uint32_t streamLoopHeadStart = 0;
+		uint32_t streamLoopHeadSize = 0;
+
+		// 流式数据源
+		SampleStreamSource* streamSource = nullptr;
+
 		// PCM流采样点起始点位置
 		int startIdx = 0;
 
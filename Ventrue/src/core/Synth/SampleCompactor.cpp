@@ -0,0 +1,242 @@
+﻿#include"SampleCompactor.h"
+#include"Sample.h"
+#include"Instrument.h"
+#include"Preset.h"
+#include"Region.h"
+#include"Generator.h"
+#include"Modulator.h"
+
+namespace ventrue
+{
+	//裁剪时在循环结束点之后额外保留的采样点数量
+	static const int64_t TRIM_GUARD_SIZE = 8;
+
+	//紧凑内存中每个样本的起始位置按4个采样点对齐
+	static const size_t ARENA_ALIGN = 4;
+
+	SampleCompactor::SampleCompactor(bool isTrimLoopTail)
+	{
+		this->isTrimLoopTail = isTrimLoopTail;
+	}
+
+	SampleCompactor::~SampleCompactor()
+	{
+	}
+
+	// 整理样本
+	float* SampleCompactor::Compact(SampleList* samples, InstrumentList* insts, PresetList* presets, SampleCompactReport& report)
+	{
+		report = SampleCompactReport();
+
+		vector<Sample*> candidates;
+		for (int i = 0; i < samples->size(); i++)
+		{
+			Sample* sample = (*samples)[i];
+			if (sample->pcm == nullptr || sample->size == 0 ||
+				sample->isExternalPcm || sample->isStreaming ||
+				sample->srcSamples != nullptr)
+				continue;
+
+			candidates.push_back(sample);
+			report.orgBytes += sample->GetPcmByteSize();
+		}
+
+		report.sampleCount = (int)candidates.size();
+		if (candidates.empty())
+			return nullptr;
+
+		keepSizes.clear();
+		if (isTrimLoopTail)
+			ComputeKeepSizes(samples, insts, presets);
+
+		//计算每个样本保留的长度，并找出内容相同的样本
+		vector<size_t> sizes(candidates.size());
+		vector<int> uniqueIdxs(candidates.size());
+		unordered_map<uint64_t, vector<int>> hashMap;
+		size_t arenaSize = 0;
+
+		for (int i = 0; i < candidates.size(); i++)
+		{
+			Sample* sample = candidates[i];
+			size_t size = sample->size;
+
+			auto it = keepSizes.find(sample);
+			if (it != keepSizes.end() && it->second > 0 && (size_t)it->second < size)
+			{
+				report.trimSavedBytes += (size - it->second) * sizeof(float);
+				report.trimCount++;
+				size = (size_t)it->second;
+			}
+
+			sizes[i] = size;
+			uniqueIdxs[i] = i;
+
+			vector<int>& sameHashs = hashMap[Hash(sample->pcm, size)];
+			for (int j = 0; j < sameHashs.size(); j++)
+			{
+				int idx = sameHashs[j];
+				if (sizes[idx] == size &&
+					memcmp(candidates[idx]->pcm, sample->pcm, size * sizeof(float)) == 0)
+				{
+					uniqueIdxs[i] = idx;
+					break;
+				}
+			}
+
+			if (uniqueIdxs[i] != i) {
+				report.dedupSavedBytes += size * sizeof(float);
+				report.dedupCount++;
+				continue;
+			}
+
+			sameHashs.push_back(i);
+			report.compactBytes += size * sizeof(float);
+			arenaSize += (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+		}
+
+		//复制到连续内存中
+		float* arena = (float*)malloc(arenaSize * sizeof(float));
+		vector<float*> newPcms(candidates.size());
+		size_t pos = 0;
+		for (int i = 0; i < candidates.size(); i++)
+		{
+			if (uniqueIdxs[i] != i) {
+				newPcms[i] = newPcms[uniqueIdxs[i]];
+				continue;
+			}
+
+			newPcms[i] = arena + pos;
+			memcpy(newPcms[i], candidates[i]->pcm, sizes[i] * sizeof(float));
+			pos += (sizes[i] + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+		}
+
+		for (int i = 0; i < candidates.size(); i++)
+		{
+			Sample* sample = candidates[i];
+			free(sample->pcm);
+			sample->pcm = newPcms[i];
+			sample->size = sizes[i];
+			sample->isExternalPcm = true;
+
+			if (sample->endIdx > (int)sizes[i] - 1)
+				sample->endIdx = (int)sizes[i] - 1;
+		}
+
+		return arena;
+	}
+
+	// 计算每个样本需要保留的采样点数量
+	// 只有使用样本的所有乐器区域都是连续循环播放模式，且没有调制器会改变采样模式和循环结束位置时，
+	// 循环结束点之后的数据才不会被播放
+	void SampleCompactor::ComputeKeepSizes(SampleList* samples, InstrumentList* insts, PresetList* presets)
+	{
+		//预设区域中存在相关调制器时，不进行裁剪
+		for (int i = 0; i < presets->size(); i++)
+		{
+			Preset* preset = (*presets)[i];
+			if (HasLoopModulator(preset->GetGlobalRegion()))
+				return;
+
+			InstLinkToPresetRegionInfoList* presetInfos = preset->GetPresetRegionLinkInfoList();
+			for (int j = 0; j < presetInfos->size(); j++)
+			{
+				if (HasLoopModulator((*presetInfos)[j].region))
+					return;
+			}
+		}
+
+		//
+		for (int i = 0; i < insts->size(); i++)
+		{
+			Instrument* inst = (*insts)[i];
+			Region* globalRegion = inst->GetGlobalRegion();
+			bool hasGlobalLoopMod = HasLoopModulator(globalRegion);
+
+			SamplesLinkToInstRegionInfoList* instInfos = inst->GetInstRegionLinkInfoList();
+			for (int j = 0; j < instInfos->size(); j++)
+			{
+				Region* region = (*instInfos)[j].region;
+				Sample* sample = (*instInfos)[j].linkSample;
+				if (sample == nullptr)
+					continue;
+
+				int64_t& keepSize = keepSizes.insert(make_pair(sample, (int64_t)0)).first->second;
+				if (keepSize < 0)
+					continue;
+
+				int64_t startLoop = sample->startloopIdx
+					+ (int64_t)GetInstGenAmount(region, globalRegion, GeneratorType::StartloopAddrsOffset)
+					+ (int64_t)GetInstGenAmount(region, globalRegion, GeneratorType::StartloopAddrsCoarseOffset) * 32768;
+
+				int64_t endLoop = sample->endloopIdx
+					+ (int64_t)GetInstGenAmount(region, globalRegion, GeneratorType::EndloopAddrsOffset)
+					+ (int64_t)GetInstGenAmount(region, globalRegion, GeneratorType::EndloopAddrsCoarseOffset) * 32768;
+
+				LoopPlayBackMode mode = (LoopPlayBackMode)(int)GetInstGenAmount(region, globalRegion, GeneratorType::SampleModes);
+
+				if (mode != LoopPlayBackMode::Loop ||
+					endLoop - startLoop <= 0 ||
+					hasGlobalLoopMod ||
+					HasLoopModulator(region))
+				{
+					keepSize = -1;
+					continue;
+				}
+
+				keepSize = max(keepSize, endLoop + 1 + TRIM_GUARD_SIZE);
+			}
+		}
+	}
+
+	// 获取乐器区域生成器的值(区域中没有时使用乐器全局区域的值)
+	float SampleCompactor::GetInstGenAmount(Region* region, Region* globalRegion, GeneratorType type)
+	{
+		GeneratorList* genList = region->GetGenList();
+		if (!genList->IsEmpty(type) || globalRegion == nullptr)
+			return genList->GetAmount(type);
+
+		return globalRegion->GetGenList()->GetAmount(type);
+	}
+
+	// 区域是否有调制器会改变采样模式或循环结束位置
+	bool SampleCompactor::HasLoopModulator(Region* region)
+	{
+		if (region == nullptr)
+			return false;
+
+		ModulatorVec* mods = region->GetModulators();
+		if (mods == nullptr)
+			return false;
+
+		for (int i = 0; i < mods->size(); i++)
+		{
+			switch ((*mods)[i]->GetOutTargetGeneratorType())
+			{
+			case GeneratorType::SampleModes:
+			case GeneratorType::StartloopAddrsOffset:
+			case GeneratorType::StartloopAddrsCoarseOffset:
+			case GeneratorType::EndloopAddrsOffset:
+			case GeneratorType::EndloopAddrsCoarseOffset:
+				return true;
+			default:
+				break;
+			}
+		}
+
+		return false;
+	}
+
+	uint64_t SampleCompactor::Hash(const float* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		const uint8_t* bytes = (const uint8_t*)data;
+		size_t byteSize = size * sizeof(float);
+		for (size_t i = 0; i < byteSize; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+}
@@ -0,0 +1,74 @@
+﻿#ifndef _SampleCompactor_h_
+#define _SampleCompactor_h_
+
+#include "VentrueTypes.h"
+
+namespace ventrue
+{
+	// 样本压缩整理结果
+	struct SampleCompactReport
+	{
+		// 参与整理的样本数量
+		int sampleCount = 0;
+		// 与其它样本内容相同而共用数据的样本数量
+		int dedupCount = 0;
+		// 裁剪了循环结束点之后数据的样本数量
+		int trimCount = 0;
+
+		// 整理前的pcm字节数
+		size_t orgBytes = 0;
+		// 整理后的pcm字节数
+		size_t compactBytes = 0;
+		// 去重节省的字节数
+		size_t dedupSavedBytes = 0;
+		// 裁剪节省的字节数
+		size_t trimSavedBytes = 0;
+
+		// 总共节省的字节数
+		inline size_t GetSavedBytes()
+		{
+			return orgBytes - compactBytes;
+		}
+	};
+
+	/*
+	* 样本压缩整理
+	* 在音源加载完成后对已解码样本进行一次整理:
+	* 1.裁剪: 所有使用者都是连续循环播放模式的样本，循环结束点之后的数据不会被播放，直接裁剪掉
+	* 2.去重: 内容完全相同的样本共用同一份pcm数据
+	* 3.紧凑: 所有保留的pcm数据复制到一块连续内存中，样本的pcm指向其中
+	* 流式样本，按需解码的样本，以及pcm由外部持有的样本不参与整理
+	* by cymheart, 2020--2021.
+	*/
+	class SampleCompactor
+	{
+	public:
+		// isTrimLoopTail: 是否裁剪循环结束点之后的数据
+		SampleCompactor(bool isTrimLoopTail = true);
+		~SampleCompactor();
+
+		// 整理样本，返回整理后pcm数据所在的连续内存(由调用者使用free释放，没有可整理的样本时为nullptr)
+		float* Compact(SampleList* samples, InstrumentList* insts, PresetList* presets, SampleCompactReport& report);
+
+	private:
+
+		// 计算每个样本需要保留的采样点数量
+		void ComputeKeepSizes(SampleList* samples, InstrumentList* insts, PresetList* presets);
+
+		// 获取乐器区域生成器的值(区域中没有时使用乐器全局区域的值)
+		static float GetInstGenAmount(Region* region, Region* globalRegion, GeneratorType type);
+
+		// 区域是否有调制器会改变采样模式或循环结束位置
+		static bool HasLoopModulator(Region* region);
+
+		static uint64_t Hash(const float* data, size_t size);
+
+	private:
+		bool isTrimLoopTail = true;
+
+		// 样本需要保留的采样点数量(-1: 不能裁剪)
+		unordered_map<Sample*, int64_t> keepSizes;
+	};
+}
+
+#endif
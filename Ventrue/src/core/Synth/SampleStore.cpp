@@ -0,0 +1,373 @@
+﻿#include"SampleStore.h"
+#include"Sample.h"
+#include"Preset.h"
+#include"Instrument.h"
+#include"Region.h"
+
+namespace ventrue
+{
+	SampleStore::SampleStore()
+		:isStop(false)
+	{
+		ResetCounters();
+	}
+
+	SampleStore::~SampleStore()
+	{
+		Stop();
+	}
+
+	// 启动加载线程
+	void SampleStore::Start()
+	{
+		if (isRunning)
+			return;
+
+		isStop = false;
+		isRunning = true;
+		loadThread = thread(&SampleStore::Run, this);
+	}
+
+	// 停止加载线程
+	void SampleStore::Stop()
+	{
+		if (!isRunning)
+			return;
+
+		isStop = true;
+		waitSem.set();
+		loadThread.join();
+		isRunning = false;
+	}
+
+	void SampleStore::Run()
+	{
+		while (!isStop)
+		{
+			ProcessDecodeRequests();
+			Evict();
+			waitSem.wait_for(2);
+		}
+	}
+
+	// 设置内存预算(单位:字节, 0:不限制)
+	void SampleStore::SetBudget(size_t bytes)
+	{
+		lock.lock();
+		budget = bytes;
+
+		//按需解码的样本由加载线程解码，之后即使取消预算也需要保留
+		if (budget > 0)
+			Start();
+
+		lock.unlock();
+		Evict();
+	}
+
+	// 设置样本数据
+	void SampleStore::SetSamples(Sample* sample, short* samples, uint32_t size, uint8_t* sm24)
+	{
+		if (!IsOnDemand() && !isDeferred)
+		{
+			sample->SetSamples(samples, size, sm24);
+			return;
+		}
+
+		sample->SetSourceSamples(samples, size, sm24);
+		sample->store = this;
+	}
+
+	// 检查样本是否已可以发声(在渲染线程中调用)
+	bool SampleStore::Request(Sample* sample)
+	{
+		if (sample == nullptr || sample->srcSamples == nullptr)
+			return true;
+
+		//存储正被其它线程占用时，下一帧再检查
+		if (!lock.try_lock())
+			return false;
+
+		bool isDecoded = sample->IsDecoded();
+		if (!isDecoded)
+			PushDecodeRequest(sample);
+
+		lock.unlock();
+		return isDecoded;
+	}
+
+	// 开始使用样本(发声时调用)，返回解码后的pcm
+	float* SampleStore::Acquire(Sample* sample)
+	{
+		//没有原始样本源的样本已全部解码且不会被淘汰，不需要记录使用状态
+		if (sample->srcSamples == nullptr)
+		{
+			hitCount++;
+			return sample->pcm;
+		}
+
+		if (!lock.try_lock()) {
+			missCount++;
+			return nullptr;
+		}
+
+		float* pcm = nullptr;
+		if (sample->IsDecoded()) {
+			hitCount++;
+			RemoveFromLru(sample);
+			sample->playingCount++;
+			pcm = sample->pcm;
+		}
+		else {
+			missCount++;
+			PushDecodeRequest(sample);
+		}
+
+		lock.unlock();
+		return pcm;
+	}
+
+	// 结束使用样本
+	// 临界区内只有计数和链表操作，超出预算的淘汰由加载线程处理
+	void SampleStore::Release(Sample* sample)
+	{
+		if (sample->srcSamples == nullptr)
+			return;
+
+		lock.lock();
+
+		if (sample->playingCount > 0)
+			sample->playingCount--;
+
+		TouchLru(sample);
+
+		lock.unlock();
+	}
+
+	// 固定样本使其常驻内存
+	void SampleStore::Pin(Sample* sample)
+	{
+		if (sample == nullptr || sample->srcSamples == nullptr)
+			return;
+
+		lock.lock();
+		sample->pinCount++;
+		RemoveFromLru(sample);
+		lock.unlock();
+
+		Decode(sample);
+		Evict();
+	}
+
+	// 取消固定样本
+	void SampleStore::Unpin(Sample* sample)
+	{
+		if (sample == nullptr || sample->srcSamples == nullptr)
+			return;
+
+		lock.lock();
+
+		if (sample->pinCount > 0)
+			sample->pinCount--;
+
+		TouchLru(sample);
+
+		lock.unlock();
+		Evict();
+	}
+
+	// 固定预设所使用的所有样本
+	void SampleStore::PinPreset(Preset* preset)
+	{
+		if (preset == nullptr)
+			return;
+
+		InstLinkToPresetRegionInfoList* presetInfos = preset->GetPresetRegionLinkInfoList();
+		for (int i = 0; i < presetInfos->size(); i++)
+		{
+			SamplesLinkToInstRegionInfoList* instInfos = (*presetInfos)[i].linkInst->GetInstRegionLinkInfoList();
+			for (int j = 0; j < instInfos->size(); j++)
+				Pin((*instInfos)[j].linkSample);
+		}
+	}
+
+	// 取消固定预设所使用的所有样本
+	void SampleStore::UnpinPreset(Preset* preset)
+	{
+		if (preset == nullptr)
+			return;
+
+		InstLinkToPresetRegionInfoList* presetInfos = preset->GetPresetRegionLinkInfoList();
+		for (int i = 0; i < presetInfos->size(); i++)
+		{
+			SamplesLinkToInstRegionInfoList* instInfos = (*presetInfos)[i].linkInst->GetInstRegionLinkInfoList();
+			for (int j = 0; j < instInfos->size(); j++)
+				Unpin((*instInfos)[j].linkSample);
+		}
+	}
+
+	// 从存储中移除样本
+	void SampleStore::Remove(Sample* sample)
+	{
+		if (sample->srcSamples == nullptr)
+			return;
+
+		lock_guard<mutex> decodeGuard(decodeLock);
+		lock.lock();
+
+		RemoveFromLru(sample);
+		RemoveDecodeRequest(sample);
+		if (sample->IsDecoded())
+		{
+			usedBytes -= sample->GetPcmByteSize();
+			sample->FreePcm();
+		}
+
+		lock.unlock();
+	}
+
+	// 重置统计计数
+	void SampleStore::ResetCounters()
+	{
+		hitCount = 0;
+		missCount = 0;
+		evictCount = 0;
+	}
+
+	// 解码样本(在锁外进行)
+	void SampleStore::Decode(Sample* sample)
+	{
+		lock_guard<mutex> decodeGuard(decodeLock);
+
+		lock.lock();
+		bool isNeedDecode = !sample->IsDecoded() && sample->srcSamples != nullptr;
+		lock.unlock();
+
+		if (!isNeedDecode)
+			return;
+
+		float* pcm = sample->DecodeToNewPcm();
+
+		lock.lock();
+		sample->pcm = pcm;
+		usedBytes += sample->GetPcmByteSize();
+		TouchLru(sample);
+		lock.unlock();
+	}
+
+	// 解码所有已请求的样本
+	void SampleStore::ProcessDecodeRequests()
+	{
+		for (;;)
+		{
+			lock.lock();
+			Sample* sample = decodeRequests;
+			if (sample != nullptr)
+			{
+				decodeRequests = sample->nextDecodeRequest;
+				sample->nextDecodeRequest = nullptr;
+				sample->isDecodeRequested = false;
+			}
+			lock.unlock();
+
+			if (sample == nullptr)
+				break;
+
+			Decode(sample);
+		}
+	}
+
+	//请求加载线程解码样本(需持有锁)
+	void SampleStore::PushDecodeRequest(Sample* sample)
+	{
+		//没有加载线程时(推迟解码模式)，样本由音源加载线程解码
+		if (!isRunning || sample->isDecodeRequested)
+			return;
+
+		sample->isDecodeRequested = true;
+		sample->nextDecodeRequest = decodeRequests;
+		decodeRequests = sample;
+	}
+
+	void SampleStore::RemoveDecodeRequest(Sample* sample)
+	{
+		if (!sample->isDecodeRequested)
+			return;
+
+		Sample** link = &decodeRequests;
+		while (*link != nullptr && *link != sample)
+			link = &(*link)->nextDecodeRequest;
+
+		if (*link != nullptr)
+			*link = sample->nextDecodeRequest;
+
+		sample->nextDecodeRequest = nullptr;
+		sample->isDecodeRequested = false;
+	}
+
+	//未在发声且未被固定的已解码样本，移至LRU列表最前端
+	void SampleStore::TouchLru(Sample* sample)
+	{
+		RemoveFromLru(sample);
+
+		if (!sample->IsDecoded() ||
+			sample->playingCount > 0 ||
+			sample->pinCount > 0)
+			return;
+
+		sample->lruPrev = nullptr;
+		sample->lruNext = lruHead;
+		if (lruHead != nullptr)
+			lruHead->lruPrev = sample;
+		else
+			lruTail = sample;
+
+		lruHead = sample;
+		sample->isInLru = true;
+	}
+
+	void SampleStore::RemoveFromLru(Sample* sample)
+	{
+		if (!sample->isInLru)
+			return;
+
+		if (sample->lruPrev != nullptr)
+			sample->lruPrev->lruNext = sample->lruNext;
+		else
+			lruHead = sample->lruNext;
+
+		if (sample->lruNext != nullptr)
+			sample->lruNext->lruPrev = sample->lruPrev;
+		else
+			lruTail = sample->lruPrev;
+
+		sample->lruPrev = nullptr;
+		sample->lruNext = nullptr;
+		sample->isInLru = false;
+	}
+
+	//超出预算时，从最久未使用的样本开始淘汰
+	//每次只在锁内摘下一个样本，pcm在锁外释放
+	void SampleStore::Evict()
+	{
+		for (;;)
+		{
+			lock.lock();
+			if (budget == 0 || usedBytes <= budget || lruTail == nullptr)
+			{
+				lock.unlock();
+				break;
+			}
+
+			Sample* sample = lruTail;
+			RemoveFromLru(sample);
+
+			float* pcm = sample->pcm;
+			sample->pcm = nullptr;
+			usedBytes -= sample->GetPcmByteSize();
+			evictCount++;
+			lock.unlock();
+
+			free(pcm);
+		}
+	}
+}
\ No newline at end of file
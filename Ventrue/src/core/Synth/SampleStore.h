@@ -0,0 +1,163 @@
+﻿#ifndef _SampleStore_h_
+#define _SampleStore_h_
+
+#include "VentrueTypes.h"
+
+namespace ventrue
+{
+	/*
+	* 样本存储
+	* 在设置了内存预算(字节)的情况下，样本只保留原始数据，在发声时按需解码为pcm,
+	* 当解码后的总字节数超过预算时，按最近最少使用(LRU)原则淘汰当前未发声且未被固定的样本
+	* 预算为0时不限制，样本在加载时即全部解码(与原有行为一致)
+	* 按需解码和淘汰都在存储自己的加载线程中进行，渲染线程只尝试加锁记录使用状态，
+	* 从不解码或分配内存，样本未解码时按未就绪处理
+	* by cymheart, 2020--2021.
+	*/
+	class SampleStore
+	{
+	public:
+		SampleStore();
+		~SampleStore();
+
+		// 设置内存预算(单位:字节, 0:不限制)
+		// 需要在解析音源之前设置
+		void SetBudget(size_t bytes);
+
+		inline size_t GetBudget()
+		{
+			return budget;
+		}
+
+		// 是否为按需解码模式
+		inline bool IsOnDemand()
+		{
+			return budget > 0;
+		}
+
+		// 设置是否推迟解码
+		// 推迟解码时样本只保留原始数据，由加载线程之后逐个调用Sample::ResolveSourceSamples()解码
+		inline void SetDeferred(bool deferred)
+		{
+			isDeferred = deferred;
+		}
+
+		inline bool IsDeferred()
+		{
+			return isDeferred;
+		}
+
+		// 设置样本数据
+		void SetSamples(Sample* sample, short* samples, uint32_t size, uint8_t* sm24 = nullptr);
+
+		// 检查样本是否已可以发声(在渲染线程中调用)
+		// 未解码时请求加载线程解码并返回false
+		bool Request(Sample* sample);
+
+		// 开始使用样本(发声时调用)，返回解码后的pcm
+		// 样本未解码或存储正被其它线程占用时返回nullptr
+		float* Acquire(Sample* sample);
+
+		// 结束使用样本
+		void Release(Sample* sample);
+
+		// 固定样本使其常驻内存
+		void Pin(Sample* sample);
+
+		// 取消固定样本
+		void Unpin(Sample* sample);
+
+		// 固定预设所使用的所有样本
+		void PinPreset(Preset* preset);
+
+		// 取消固定预设所使用的所有样本
+		void UnpinPreset(Preset* preset);
+
+		// 从存储中移除样本
+		void Remove(Sample* sample);
+
+		// 获取命中次数
+		inline uint64_t GetHitCount()
+		{
+			return hitCount;
+		}
+
+		// 获取未命中次数
+		inline uint64_t GetMissCount()
+		{
+			return missCount;
+		}
+
+		// 获取淘汰次数
+		inline uint64_t GetEvictCount()
+		{
+			return evictCount;
+		}
+
+		// 获取当前已解码样本所占字节数
+		inline size_t GetUsedBytes()
+		{
+			return usedBytes;
+		}
+
+		// 重置统计计数
+		void ResetCounters();
+
+	private:
+		// 启动加载线程
+		void Start();
+
+		// 停止加载线程
+		void Stop();
+
+		void Run();
+
+		// 解码样本(在锁外进行)
+		void Decode(Sample* sample);
+
+		// 解码所有已请求的样本
+		void ProcessDecodeRequests();
+
+		void PushDecodeRequest(Sample* sample);
+		void RemoveDecodeRequest(Sample* sample);
+
+		void TouchLru(Sample* sample);
+		void RemoveFromLru(Sample* sample);
+		void Evict();
+
+	private:
+
+		//内存预算
+		size_t budget = 0;
+
+		//是否推迟解码
+		bool isDeferred = false;
+
+		//已解码样本所占字节数
+		size_t usedBytes = 0;
+
+		//未使用的已解码样本，越靠前越近使用
+		Sample* lruHead = nullptr;
+		Sample* lruTail = nullptr;
+
+		//等待解码的样本
+		Sample* decodeRequests = nullptr;
+
+		//共享音源的样本存储会被多个渲染线程同时访问
+		atomic<uint64_t> hitCount;
+		atomic<uint64_t> missCount;
+		atomic<uint64_t> evictCount;
+
+		mutex lock;
+
+		//解码期间持有，移除样本时等待正在进行的解码结束
+		mutex decodeLock;
+
+		thread loadThread;
+		Semaphore waitSem;
+		atomic<bool> isStop;
+		bool isRunning = false;
+	};
+}
+
+#endif
@@ -0,0 +1,272 @@
+﻿#include"SampleStreamer.h"
+#include"SoundFormat/Wav/WavReader.h"
+
+namespace ventrue
+{
+	//每次从文件读取的最大采样点数量
+	static const uint32_t STREAM_READ_CHUNK = 8192;
+
+	//填充时在环形缓存中为播放位置之前的数据保留的采样点数量
+	static const uint32_t STREAM_RING_GUARD = 1024;
+
+	static int SeekFile(FILE* fp, uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(fp, (long long)offset, SEEK_SET);
+#else
+		return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+	}
+
+	SampleStreamBuffer::SampleStreamBuffer(uint32_t ringSize, atomic<uint64_t>* underrunCount)
+		:state((int)StreamBufferState::Free)
+		, winStart(0)
+		, winEnd(0)
+		, playPos(0)
+		, limitEnd(0)
+	{
+		this->ringSize = ringSize;
+		ringMask = ringSize - 1;
+		ring = (float*)malloc(ringSize * sizeof(float));
+		this->underrunCount = underrunCount;
+	}
+
+	SampleStreamBuffer::~SampleStreamBuffer()
+	{
+		free(ring);
+	}
+
+	SampleStreamer::SampleStreamer(int maxStreams, uint32_t ringSize)
+		:underrunCount(0)
+		, isStop(false)
+		, hasNewStream(false)
+	{
+		//环形缓存的大小调整为2的幂
+		uint32_t size = STREAM_RING_GUARD * 2;
+		while (size < ringSize)
+			size <<= 1;
+		this->ringSize = size;
+
+		for (int i = 0; i < maxStreams; i++)
+			buffers.push_back(new SampleStreamBuffer(this->ringSize, &underrunCount));
+	}
+
+	SampleStreamer::~SampleStreamer()
+	{
+		Stop();
+
+		for (int i = 0; i < buffers.size(); i++)
+			DEL(buffers[i]);
+	}
+
+	// 启动I/O线程
+	void SampleStreamer::Start()
+	{
+		if (isRunning)
+			return;
+
+		isStop = false;
+		isRunning = true;
+		ioThread = thread(&SampleStreamer::Run, this);
+	}
+
+	// 停止I/O线程
+	void SampleStreamer::Stop()
+	{
+		if (!isRunning)
+			return;
+
+		isStop = true;
+		waitSem.set();
+		ioThread.join();
+		isRunning = false;
+
+		CloseFiles();
+	}
+
+	// 为发声区域分配一个流缓存
+	SampleStreamBuffer* SampleStreamer::Acquire(Sample* sample, uint32_t startPos)
+	{
+		for (int i = 0; i < buffers.size(); i++)
+		{
+			SampleStreamBuffer* buffer = buffers[i];
+			int freeState = (int)StreamBufferState::Free;
+			if (buffer->state.load(memory_order_acquire) != freeState)
+				continue;
+
+			//只有渲染线程会把空闲缓存设置为发声状态,
+			//I/O线程只处理发声状态和回收状态的缓存，因此这里不会产生竞争
+			//acquire读取保证I/O线程回收时对缓存的写入已经可见
+			buffer->sample = sample;
+			buffer->winStart.store(0, memory_order_relaxed);
+			buffer->winEnd.store(0, memory_order_relaxed);
+			buffer->SetPlayPos(startPos, (uint32_t)sample->size);
+			buffer->state.store((int)StreamBufferState::Active, memory_order_release);
+
+			//渲染线程中只设置标志，由I/O线程轮询，不调用信号量
+			hasNewStream.store(true, memory_order_release);
+			return buffer;
+		}
+
+		return nullptr;
+	}
+
+	// 结束发声区域对流缓存的使用
+	void SampleStreamer::Release(SampleStreamBuffer* buffer)
+	{
+		if (buffer == nullptr)
+			return;
+
+		buffer->state.store((int)StreamBufferState::Releasing, memory_order_release);
+	}
+
+	void SampleStreamer::Run()
+	{
+		while (!isStop)
+		{
+			for (int i = 0; i < buffers.size(); i++)
+			{
+				SampleStreamBuffer* buffer = buffers[i];
+				int state = buffer->state.load(memory_order_acquire);
+
+				if (state == (int)StreamBufferState::Releasing)
+				{
+					buffer->sample = nullptr;
+					buffer->state.store((int)StreamBufferState::Free, memory_order_release);
+				}
+				else if (state == (int)StreamBufferState::Active)
+				{
+					Fill(buffer);
+				}
+			}
+
+			//有新的流缓存时立即开始下一轮填充
+			if (hasNewStream.exchange(false, memory_order_acquire))
+				continue;
+
+			waitSem.wait_for(2);
+		}
+	}
+
+	// 填充一个流缓存
+	void SampleStreamer::Fill(SampleStreamBuffer* buffer)
+	{
+		Sample* sample = buffer->sample;
+		uint32_t playPos = buffer->playPos.load(memory_order_relaxed);
+		uint32_t limitEnd = buffer->limitEnd.load(memory_order_relaxed);
+		if (limitEnd > sample->size)
+			limitEnd = (uint32_t)sample->size;
+
+		uint32_t start = FirstNonResident(sample, playPos);
+		uint32_t winStart = buffer->winStart.load(memory_order_relaxed);
+		uint32_t winEnd = buffer->winEnd.load(memory_order_relaxed);
+
+		//播放位置发生了跳转(如循环回到循环起始点)，重新定位缓存窗口
+		if (start < winStart || start > winEnd)
+		{
+			buffer->winEnd.store(winStart, memory_order_release);
+			buffer->winStart.store(start, memory_order_release);
+			buffer->winEnd.store(start, memory_order_release);
+			winStart = winEnd = start;
+		}
+
+		uint32_t targetEnd = playPos + ringSize - STREAM_RING_GUARD;
+		if (targetEnd > limitEnd)
+			targetEnd = limitEnd;
+
+		while (winEnd < targetEnd)
+		{
+			uint32_t count = targetEnd - winEnd;
+			if (count > STREAM_READ_CHUNK)
+				count = STREAM_READ_CHUNK;
+
+			//写入位置不跨越环形缓存的末尾
+			uint32_t ringPos = winEnd & buffer->ringMask;
+			if (count > ringSize - ringPos)
+				count = ringSize - ringPos;
+
+			//先使即将被覆盖的旧数据失效
+			if (winEnd + count > winStart + ringSize)
+			{
+				winStart = winEnd + count - ringSize;
+				buffer->winStart.store(winStart, memory_order_release);
+			}
+
+			if (!ReadSource(sample->streamSource, winEnd, count, buffer->ring + ringPos))
+				break;
+
+			winEnd += count;
+			buffer->winEnd.store(winEnd, memory_order_release);
+
+			if (isStop ||
+				buffer->state.load(memory_order_acquire) != (int)StreamBufferState::Active)
+				break;
+		}
+	}
+
+	// 从文件中读取样本索引[start, start + count)的数据到dst
+	bool SampleStreamer::ReadSource(SampleStreamSource* source, uint32_t start, uint32_t count, float* dst)
+	{
+		if (source == nullptr)
+			return false;
+
+		FILE* fp;
+		auto it = files.find(source->filePath);
+		if (it != files.end())
+		{
+			fp = it->second;
+		}
+		else
+		{
+			fp = fopen(source->filePath.c_str(), "rb");
+			files[source->filePath] = fp;
+		}
+
+		if (fp == nullptr)
+			return false;
+
+		size_t byteSize = (size_t)count * source->blockAlign;
+		if (readBuf.size() < byteSize)
+			readBuf.resize(byteSize);
+
+		uint64_t offset = source->dataOffset + (uint64_t)start * source->blockAlign;
+		if (SeekFile(fp, offset) != 0)
+			return false;
+
+		//文件末尾不完整的帧按0处理
+		size_t readSize = fread(readBuf.data(), 1, byteSize, fp);
+		if (readSize < byteSize)
+			memset(readBuf.data() + readSize, 0, byteSize - readSize);
+
+		WavReader::ConvertToFloat(
+			readBuf.data(), count, source->blockAlign,
+			source->bitsPerSample, source->isFloat, dst, source->scale);
+
+		return true;
+	}
+
+	// 获取pos及之后第一个不在内存中的样本索引
+	uint32_t SampleStreamer::FirstNonResident(Sample* sample, uint32_t pos)
+	{
+		for (;;)
+		{
+			if (pos < sample->streamHeadSize)
+				pos = sample->streamHeadSize;
+			else if (pos - sample->streamLoopHeadStart < sample->streamLoopHeadSize)
+				pos = sample->streamLoopHeadStart + sample->streamLoopHeadSize;
+			else
+				return pos;
+		}
+	}
+
+	void SampleStreamer::CloseFiles()
+	{
+		for (auto it = files.begin(); it != files.end(); it++)
+		{
+			if (it->second != nullptr)
+				fclose(it->second);
+		}
+
+		files.clear();
+	}
+}
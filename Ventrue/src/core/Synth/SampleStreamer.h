@@ -0,0 +1,153 @@
+﻿#ifndef _SampleStreamer_h_
+#define _SampleStreamer_h_
+
+#include "VentrueTypes.h"
+#include "Sample.h"
+
+namespace ventrue
+{
+	// 流缓存状态
+	enum class StreamBufferState
+	{
+		// 空闲
+		Free,
+		// 发声中
+		Active,
+		// 发声已结束，等待I/O线程回收
+		Releasing
+	};
+
+	/*
+	* 发声区域的样本流缓存
+	* 环形缓存中保存了样本索引在[winStart, winEnd)范围内的数据，
+	* 由I/O线程根据播放位置playPos向前填充，渲染线程只读取
+	* by cymheart, 2020--2021.
+	*/
+	class SampleStreamBuffer
+	{
+	public:
+		SampleStreamBuffer(uint32_t ringSize, atomic<uint64_t>* underrunCount);
+		~SampleStreamBuffer();
+
+		// 读取样本索引为idx的采样点
+		// 常驻内存的数据直接读取，其余从环形缓存中读取，数据未就绪时返回0并计数
+		inline float Read(uint32_t idx)
+		{
+			if (idx < sample->streamHeadSize)
+				return sample->pcm[idx];
+
+			uint32_t loopOffset = idx - sample->streamLoopHeadStart;
+			if (loopOffset < sample->streamLoopHeadSize)
+				return sample->streamLoopHead[loopOffset];
+
+			if (idx >= winStart.load(memory_order_acquire) &&
+				idx < winEnd.load(memory_order_acquire))
+				return ring[idx & ringMask];
+
+			underrunCount->fetch_add(1, memory_order_relaxed);
+			return 0;
+		}
+
+		// 设置当前播放位置和需要数据的结束位置
+		inline void SetPlayPos(uint32_t pos, uint32_t endPos)
+		{
+			playPos.store(pos, memory_order_relaxed);
+			limitEnd.store(endPos, memory_order_relaxed);
+		}
+
+	private:
+		friend class SampleStreamer;
+
+		Sample* sample = nullptr;
+
+		float* ring = nullptr;
+		uint32_t ringSize = 0;
+		uint32_t ringMask = 0;
+
+		atomic<int> state;
+		atomic<uint32_t> winStart;
+		atomic<uint32_t> winEnd;
+		atomic<uint32_t> playPos;
+		atomic<uint32_t> limitEnd;
+
+		atomic<uint64_t>* underrunCount = nullptr;
+	};
+
+	/*
+	* 样本流读取器
+	* 对于超大的样本库，流式样本只有开头部分常驻内存，
+	* 后台I/O线程负责把每个发声区域播放位置之后的数据提前读入其环形缓存,
+	* 渲染线程从不进行文件读取
+	* by cymheart, 2020--2021.
+	*/
+	class SampleStreamer
+	{
+	public:
+		// maxStreams: 同时流式发声的最大区域数量
+		// ringSize: 每个发声区域环形缓存的采样点数量(会调整为2的幂)
+		SampleStreamer(int maxStreams = 256, uint32_t ringSize = 65536);
+		~SampleStreamer();
+
+		// 启动I/O线程
+		void Start();
+
+		// 停止I/O线程
+		void Stop();
+
+		inline bool IsRunning()
+		{
+			return isRunning;
+		}
+
+		// 为发声区域分配一个流缓存(在渲染线程中调用，不会进行文件读取)
+		// 没有空闲缓存时返回nullptr
+		SampleStreamBuffer* Acquire(Sample* sample, uint32_t startPos);
+
+		// 结束发声区域对流缓存的使用
+		void Release(SampleStreamBuffer* buffer);
+
+		// 获取数据未能及时读取的采样点数量
+		inline uint64_t GetUnderrunCount()
+		{
+			return underrunCount.load(memory_order_relaxed);
+		}
+
+		inline void ResetUnderrunCount()
+		{
+			underrunCount = 0;
+		}
+
+	private:
+		void Run();
+
+		// 填充一个流缓存
+		void Fill(SampleStreamBuffer* buffer);
+
+		// 从文件中读取样本索引[start, start + count)的数据到dst
+		bool ReadSource(SampleStreamSource* source, uint32_t start, uint32_t count, float* dst);
+
+		// 获取pos及之后第一个不在内存中的样本索引
+		static uint32_t FirstNonResident(Sample* sample, uint32_t pos);
+
+		void CloseFiles();
+
+	private:
+		vector<SampleStreamBuffer*> buffers;
+		uint32_t ringSize;
+
+		atomic<uint64_t> underrunCount;
+
+		thread ioThread;
+		Semaphore waitSem;
+		atomic<bool> isStop;
+		// 有新的流缓存需要填充(由渲染线程设置，不唤醒信号量)
+		atomic<bool> hasNewStream;
+		bool isRunning = false;
+
+		// I/O线程中使用的已打开文件
+		unordered_map<string, FILE*> files;
+		vector<uint8_t> readBuf;
+	};
+}
+
+#endif
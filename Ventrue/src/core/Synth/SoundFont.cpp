@@ -0,0 +1,70 @@
+﻿#include"SoundFont.h"
+#include"Sample.h"
+#include"SampleStore.h"
+#include"Instrument.h"
+#include"Preset.h"
+#include"Region.h"
+#include <algorithm>
+
+namespace ventrue
+{
+	SoundFont::SoundFont(string path, uint64_t hash)
+		:voiceCount(0)
+	{
+		this->path = path;
+		this->hash = hash;
+
+		sampleList = new SampleList;
+		instList = new InstrumentList;
+		presetList = new PresetList;
+		presetBankDict = new PresetMap;
+		sampleStore = new SampleStore;
+	}
+
+	SoundFont::~SoundFont()
+	{
+		//先停止样本存储的加载线程，再释放样本
+		DEL(sampleStore);
+		DEL_OBJS_VECTOR(sampleList);
+		DEL_OBJS_VECTOR(instList);
+		DEL_OBJS_VECTOR(presetList);
+		DEL(presetBankDict);
+
+		for (int i = 0; i < mappedFiles.size(); i++)
+			DEL(mappedFiles[i]);
+		mappedFiles.clear();
+	}
+
+	//持有样本数据所在的映射文件，在音源销毁时一同释放
+	void SoundFont::AddMappedFile(MappedFile* mappedFile)
+	{
+		mappedFiles.push_back(mappedFile);
+	}
+
+	//预设使用的样本是否都已加载完成
+	bool SoundFont::IsPresetSamplesLoaded(Preset* preset)
+	{
+		vector<Sample*> samples;
+		GetPresetUnloadedSamples(preset, samples);
+		return samples.empty();
+	}
+
+	//获取预设使用的尚未加载完成的样本(只保留了原始样本数据的样本)
+	void SoundFont::GetPresetUnloadedSamples(Preset* preset, vector<Sample*>& samples)
+	{
+		InstLinkToPresetRegionInfoList* presetInfos = preset->GetPresetRegionLinkInfoList();
+		for (int i = 0; i < presetInfos->size(); i++)
+		{
+			SamplesLinkToInstRegionInfoList* instInfos = (*presetInfos)[i].linkInst->GetInstRegionLinkInfoList();
+			for (int j = 0; j < instInfos->size(); j++)
+			{
+				Sample* sample = (*instInfos)[j].linkSample;
+				if (sample == nullptr || sample->srcSamples == nullptr)
+					continue;
+
+				if (find(samples.begin(), samples.end(), sample) == samples.end())
+					samples.push_back(sample);
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+﻿#ifndef _SoundFont_h_
+#define _SoundFont_h_
+
+#include "VentrueTypes.h"
+#include "scutils/MappedFile.h"
+
+namespace ventrue
+{
+	/*
+	* 音源数据
+	* 持有一个音源文件解析出的所有样本，乐器，预设，
+	* 由SoundFontRepository管理，加载完成后只读，可在多个Ventrue之间共享
+	* by cymheart, 2020--2021.
+	*/
+	class SoundFont
+	{
+	public:
+		SoundFont(string path, uint64_t hash);
+		~SoundFont();
+
+		inline string& GetPath()
+		{
+			return path;
+		}
+
+		inline uint64_t GetHash()
+		{
+			return hash;
+		}
+
+		inline SampleList* GetSampleList()
+		{
+			return sampleList;
+		}
+
+		inline InstrumentList* GetInstrumentList()
+		{
+			return instList;
+		}
+
+		inline PresetList* GetPresetList()
+		{
+			return presetList;
+		}
+
+		inline PresetMap* GetPresetBankDict()
+		{
+			return presetBankDict;
+		}
+
+		//加载时使用的样本存储(除渐进加载外，总是在加载时全部解码)
+		inline SampleStore* GetSampleStore()
+		{
+			return sampleStore;
+		}
+
+		//持有样本数据所在的映射文件，在音源销毁时一同释放
+		void AddMappedFile(MappedFile* mappedFile);
+
+		//预设使用的样本是否都已加载完成
+		bool IsPresetSamplesLoaded(Preset* preset);
+
+		//获取预设使用的尚未加载完成的样本
+		void GetPresetUnloadedSamples(Preset* preset, vector<Sample*>& samples);
+
+		//增加一个使用此音源的发声或虚拟乐器
+		inline void AddVoiceRef()
+		{
+			voiceCount.fetch_add(1, memory_order_relaxed);
+		}
+
+		//减少一个使用此音源的发声或虚拟乐器
+		//release保证释放前对音源的访问都先于回收线程的释放完成
+		inline void ReleaseVoiceRef()
+		{
+			voiceCount.fetch_sub(1, memory_order_release);
+		}
+
+		//获取正在使用此音源的发声和虚拟乐器数量
+		inline int GetVoiceCount()
+		{
+			return voiceCount.load(memory_order_acquire);
+		}
+
+	private:
+		friend class SoundFontRepository;
+
+		string path;
+		uint64_t hash = 0;
+
+		//在SoundFontRepository中对应的路径键值和内容哈希键值
+		vector<string> keys;
+		string hashKey;
+		int refCount = 0;
+
+		//正在使用此音源的发声数量
+		atomic<int> voiceCount;
+
+		SampleList* sampleList = nullptr;
+		InstrumentList* instList = nullptr;
+		PresetList* presetList = nullptr;
+		PresetMap* presetBankDict = nullptr;
+		SampleStore* sampleStore = nullptr;
+		vector<MappedFile*> mappedFiles;
+	};
+}
+
+#endif
@@ -22,8 +22,21 @@ namespace ventrue
 
 		virtual	void Parse(string path) = 0;
 
+		//生成一个同类型的新解析器
+		//后台加载音源时每次使用独立的解析器，不与ventrue的解析器共享解析状态
+		virtual SoundFontParser* NewInstance(Ventrue* ventrue) = 0;
+
+		//设置解析的目标音源(nullptr:解析到ventrue自身)
+		inline void SetSoundFont(SoundFont* soundFont)
+		{
+			this->soundFont = soundFont;
+		}
+
 	protected:
 		Ventrue* ventrue;
+
+		//解析的目标音源
+		SoundFont* soundFont = nullptr;
 	};
 
 }
@@ -0,0 +1,165 @@
+﻿#include"SoundFontRepository.h"
+#include"SoundFont.h"
+#include"Ventrue.h"
+#include"scutils/MappedFile.h"
+#include <sys/stat.h>
+
+namespace ventrue
+{
+	BUILD_SHARE(SoundFontRepository)
+
+	SoundFontRepository::SoundFontRepository()
+	{
+	}
+
+	SoundFontRepository::~SoundFontRepository()
+	{
+		//多个路径键值可能对应同一音源，按内容哈希键值释放
+		for (auto it = hashMap.begin(); it != hashMap.end(); it++)
+			DEL(it->second);
+		hashMap.clear();
+		soundFontMap.clear();
+	}
+
+	// 获取共享音源，引用计数加1
+	SoundFont* SoundFontRepository::Acquire(Ventrue* ventrue, string formatName, string path)
+	{
+		//以路径，文件大小和修改时间作为键值，只在库中没有时才计算文件内容哈希
+		uint64_t fileSize = 0;
+		int64_t modifyTime = 0;
+		if (!GetFileStamp(path, fileSize, modifyTime))
+			return nullptr;
+
+		char stampStr[64];
+		sprintf(stampStr, "%llu:%lld", (unsigned long long)fileSize, (long long)modifyTime);
+		string key = formatName + ":" + path + ":" + stampStr;
+
+		unique_lock<mutex> lk(lock);
+
+		WaitLoading(lk, key);
+		auto it = soundFontMap.find(key);
+		if (it != soundFontMap.end())
+		{
+			it->second->refCount++;
+			return it->second;
+		}
+
+		//占用此键值，在锁外计算哈希和解析
+		loadingKeys.insert(key);
+		lk.unlock();
+
+		uint64_t hash = HashFile(path);
+		char hashStr[32];
+		sprintf(hashStr, "%016llx", (unsigned long long)hash);
+		string hashKey = formatName + ":#" + hashStr;
+
+		lk.lock();
+
+		//内容相同的音源已由其它路径加载时直接共享
+		WaitLoading(lk, hashKey);
+		auto hashIt = hashMap.find(hashKey);
+		if (hashIt != hashMap.end())
+		{
+			SoundFont* soundFont = hashIt->second;
+			soundFont->refCount++;
+			soundFont->keys.push_back(key);
+			soundFontMap[key] = soundFont;
+			EndLoading(key);
+			return soundFont;
+		}
+
+		loadingKeys.insert(hashKey);
+		lk.unlock();
+
+		SoundFont* soundFont = new SoundFont(path, hash);
+		ventrue->ParseSoundFont(formatName, path, soundFont);
+		if (soundFont->GetPresetList()->empty())
+			DEL(soundFont);
+
+		lk.lock();
+
+		if (soundFont != nullptr)
+		{
+			soundFont->keys.push_back(key);
+			soundFont->hashKey = hashKey;
+			soundFont->refCount = 1;
+			soundFontMap[key] = soundFont;
+			hashMap[hashKey] = soundFont;
+		}
+
+		EndLoading(key);
+		EndLoading(hashKey);
+		return soundFont;
+	}
+
+	// 等待正在加载的键值完成
+	void SoundFontRepository::WaitLoading(unique_lock<mutex>& lk, const string& key)
+	{
+		while (loadingKeys.find(key) != loadingKeys.end())
+			loadedCond.wait(lk);
+	}
+
+	// 结束键值的加载，唤醒等待者
+	//加载失败时等待者会重新尝试加载
+	void SoundFontRepository::EndLoading(const string& key)
+	{
+		loadingKeys.erase(key);
+		loadedCond.notify_all();
+	}
+
+	// 释放共享音源，引用计数减1，为0时销毁
+	void SoundFontRepository::Release(SoundFont* soundFont)
+	{
+		if (soundFont == nullptr)
+			return;
+
+		lock_guard<mutex> lockGuard(lock);
+
+		if (--soundFont->refCount > 0)
+			return;
+
+		for (size_t i = 0; i < soundFont->keys.size(); i++)
+			soundFontMap.erase(soundFont->keys[i]);
+		hashMap.erase(soundFont->hashKey);
+		DEL(soundFont);
+	}
+
+	// 获取库中的音源数量
+	size_t SoundFontRepository::GetSoundFontCount()
+	{
+		lock_guard<mutex> lockGuard(lock);
+		return soundFontMap.size();
+	}
+
+	// 获取文件大小和修改时间
+	bool SoundFontRepository::GetFileStamp(string path, uint64_t& fileSize, int64_t& modifyTime)
+	{
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			return false;
+
+		fileSize = (uint64_t)st.st_size;
+		modifyTime = (int64_t)st.st_mtime;
+		return true;
+	}
+
+	// 计算文件内容的哈希值(FNV-1a 64)
+	uint64_t SoundFontRepository::HashFile(string path)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+
+		MappedFile file;
+		if (!file.Open(path))
+			return hash;
+
+		const uint8_t* data = file.GetData();
+		size_t size = file.GetSize();
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+}
@@ -0,0 +1,64 @@
+﻿#ifndef _SoundFontRepository_h_
+#define _SoundFontRepository_h_
+
+#include "VentrueTypes.h"
+#include "scutils/SingletonDefine.h"
+#include <condition_variable>
+
+namespace ventrue
+{
+	/*
+	* 进程内共享的音源库
+	* 以文件路径，文件大小和修改时间作为键值，同一音源在进程中只加载一份，
+	* 不同路径下内容相同的文件通过内容哈希共享同一份音源，
+	* 多个Ventrue以只读方式共享其样本，乐器，预设，
+	* 使用引用计数管理，最后一个使用者释放后才销毁
+	* by cymheart, 2020--2021.
+	*/
+	class SoundFontRepository
+	{
+		SINGLETON(SoundFontRepository)
+
+	public:
+
+		// 获取共享音源，引用计数加1
+		// 音源不在库中时，使用ventrue中formatName对应的解析器加载
+		// 加载失败时返回nullptr
+		SoundFont* Acquire(Ventrue* ventrue, string formatName, string path);
+
+		// 释放共享音源，引用计数减1，为0时销毁
+		void Release(SoundFont* soundFont);
+
+		// 获取库中的音源数量
+		size_t GetSoundFontCount();
+
+		// 计算文件内容的哈希值(FNV-1a 64)
+		static uint64_t HashFile(string path);
+
+		// 获取文件大小和修改时间
+		static bool GetFileStamp(string path, uint64_t& fileSize, int64_t& modifyTime);
+
+	private:
+		//等待正在加载的键值完成
+		void WaitLoading(unique_lock<mutex>& lk, const string& key);
+
+		//结束键值的加载，唤醒等待者
+		void EndLoading(const string& key);
+
+	private:
+		mutex lock;
+
+		//路径键值到音源
+		unordered_map<string, SoundFont*> soundFontMap;
+
+		//内容哈希键值到音源
+		unordered_map<string, SoundFont*> hashMap;
+
+		//正在加载的路径键值和内容哈希键值
+		//加载在锁外进行，同一键值的其它请求等待加载完成
+		unordered_set<string> loadingKeys;
+		condition_variable loadedCond;
+	};
+}
+
+#endif
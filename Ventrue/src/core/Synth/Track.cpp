@@ -54,6 +54,52 @@ namespace ventrue
 	}
 
 
+	//保存播放状态
+	void Track::SaveState(TrackState& state, uint16_t channelMask)
+	{
+		state.eventOffsetIdx = eventOffsetIdx;
+		state.isEnded = isEnded;
+		state.msPerTick = msPerTick;
+		state.BPM = BPM;
+		state.baseTickCount = baseTickCount;
+		state.baseTickTime = baseTickTime;
+		state.curtTickCount = curtTickCount;
+		state.tempoSettingQue = tempoSettingQue;
+
+		state.channelMask = channelMask;
+		state.channelStates.clear();
+		for (int i = 0; i < 16; i++)
+		{
+			if ((channelMask & (1 << i)) == 0)
+				continue;
+
+			state.channelStates.emplace_back();
+			channels[i]->SaveState(state.channelStates.back());
+		}
+	}
+
+	//恢复播放状态
+	void Track::RestoreState(TrackState& state, double timeOffset)
+	{
+		eventOffsetIdx = state.eventOffsetIdx;
+		isEnded = state.isEnded;
+		msPerTick = state.msPerTick;
+		BPM = state.BPM;
+		baseTickCount = state.baseTickCount;
+		baseTickTime = state.baseTickTime + timeOffset;
+		curtTickCount = state.curtTickCount;
+		tempoSettingQue = state.tempoSettingQue;
+
+		int n = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			if ((state.channelMask & (1 << i)) == 0)
+				continue;
+
+			channels[i]->RestoreState(state.channelStates[n++]);
+		}
+	}
+
 	Channel* Track::operator[] (int n)
 	{
 		return channels[n];
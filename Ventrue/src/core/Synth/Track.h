@@ -2,6 +2,7 @@
 #define _Track_h_
 
 #include "VentrueTypes.h"
+#include "Channel.h"
 
 namespace ventrue
 {
@@ -12,6 +13,23 @@ namespace ventrue
 		int startTickCount = 0;
 	};
 
+	// 音轨的播放状态
+	struct TrackState
+	{
+		int eventOffsetIdx = 0;
+		bool isEnded = false;
+		float msPerTick = 4.166f;
+		float BPM = 120;
+		uint32_t baseTickCount = 0;
+		double baseTickTime = 0;
+		uint32_t curtTickCount = 0;
+		queue<TempoSetting> tempoSettingQue;
+
+		//保存了状态的通道(按位标记)
+		uint16_t channelMask = 0;
+		vector<ChannelState> channelStates;
+	};
+
 	// 演奏音轨
 	//by cymheart, 2020--2021.
 	class Track
@@ -77,6 +95,14 @@ namespace ventrue
 		//设置打击乐号
 		void SetPercussionProgramNum(int num);
 
+		//保存播放状态
+		//channelMask: 需要保存状态的通道(按位标记)
+		void SaveState(TrackState& state, uint16_t channelMask);
+
+		//恢复播放状态
+		//timeOffset: 保存状态时的时间起点到当前时间起点的偏移
+		void RestoreState(TrackState& state, double timeOffset);
+
 
 	public:
 
@@ -104,10 +130,6 @@ namespace ventrue
 		/// 对应音轨事件队列的当前处理位置
 		/// </summary>
 		int eventOffsetIdx = 0;
-		// <summary>
-		/// 对应音轨事件队列的当前处理位置
-		/// </summary>
-		list<MidiEvent*>::iterator eventOffsetIter;
 
 		//是否播放结束
 		bool isEnded = false;
@@ -1,5 +1,11 @@
 ﻿#include"Ventrue.h"
 #include"Sample.h"
+#include"SampleStore.h"
+#include"SampleStreamer.h"
+#include"MidiRecorder.h"
+#include"MidiInput.h"
+#include"SoundFont.h"
+#include"SoundFontRepository.h"
 #include"RegionSounderThread.h"
 #include"Instrument.h"
 #include"KeySounder.h"
@@ -13,6 +19,7 @@
 #include"SoundFontParser.h"
 #include"SoundFontFormat/SF2/SF2Parser.h"
 #include"SoundFontFormat/VentrueFont/VentrueFont.h"
+#include"SoundFontFormat/Cache/SoundFontCache.h"
 #include"Channel.h"
 #include"VentrueCmd.h"
 #include "Audio/AudioSDL/Audio_SDL.h"
@@ -20,6 +27,7 @@
 #include"dsignal/Bode.h"
 #include"Effect/EffectEqualizer.h"
 #include <Effect\EffectCompressor.h>
+#include"scutils/ParallelJobs.h"
 #include<algorithm>
 
 
@@ -36,17 +44,26 @@ namespace ventrue {
 		cmd = new VentrueCmd(this);
 		openedAudioTime = new clock::time_point;
 		isFrameRenderCompleted = true;
+		isStopSoundFontLoad = false;
 		cmdLock = new mutex();
 		waitSem = new Semaphore();
 		sampleList = new SampleList;
+		sampleStore = new SampleStore;
+		sampleStreamer = new SampleStreamer;
+		midiRecorder = new MidiRecorder;
+		midiInput = new MidiInput;
 		instList = new InstrumentList;
 		presetList = new PresetList;
 		presetBankDict = new PresetMap;
+		sharedSoundFonts = new vector<SoundFont*>;
+		sampleArenas = new vector<float*>;
+		retiredSoundFonts = new vector<SoundFont*>;
 		presetBankReplaceMap = new unordered_map<uint32_t, uint32_t>;
 		virInstList = new vector<VirInstrument*>;
 		virInsts = new vector<VirInstrument*>;
 		taskProcesser = new TaskProcesser;
 		realtimeKeyOpTaskProcesser = new TaskProcesser;
+		soundFontTaskProcesser = new TaskProcesser;
 		realtimeKeyEventList = new RealtimeKeyEventList;
 
 		regionSounderThreadPool = new RegionSounderThread;
@@ -79,27 +96,56 @@ namespace ventrue {
 		EffectCompressor* compressor = new EffectCompressor();
 		effects->AppendEffect(compressor);
 
+		//全局混音和声发送总线(总线上只输出效果声)
+		reverbBus = new EffectFreeVerb();
+		reverbBus->SetRoomSize(0.8f);
+		reverbBus->SetWidth(0.2f);
+		reverbBus->SetDamping(0.5f);
+		reverbBus->SetEffectMix(1);
+
+		chorusBus = new EffectChorus();
+		chorusBus->SetModDepth(1);
+		chorusBus->SetModFrequency(0.02f);
+		chorusBus->SetEffectMix(1);
+		AllocEffectSendSamples();
+
 #ifdef _WIN32
 		timeBeginPeriod(1);
 #endif
 
 		taskProcesser->Start();
 		realtimeKeyOpTaskProcesser->Start();
+		soundFontTaskProcesser->Start();
+
+		//删除乐器时移除的录制由录制线程释放，需一直运行
+		midiRecorder->Start();
 	}
 
 	Ventrue::~Ventrue()
 	{
 		DEL(cmd);
 
+		//音源加载线程可能正在等待渲染线程切换音源，需在渲染线程之前停止
+		isStopSoundFontLoad = true;
+		soundFontTaskProcesser->Stop();
+
 		//注意，必须首先停止audio的回调运作
 		DEL(audio);
 		DEL(synthSampleRingBuffer);
 		regionSounderThreadPool->Stop();
 		taskProcesser->Stop();
 		realtimeKeyOpTaskProcesser->Stop();
+		DEL(sampleStreamer);
+		midiRecorder->Stop();
 
 		//
+		//先停止样本存储的加载线程，再释放样本
+		DEL(sampleStore);
 		DEL_OBJS_VECTOR(sampleList);
+
+		for (int i = 0; i < sampleArenas->size(); i++)
+			free((*sampleArenas)[i]);
+		DEL(sampleArenas);
 		DEL_OBJS_VECTOR(instList);
 		DEL_OBJS_VECTOR(presetList);
 		DEL(midiFilePaths);
@@ -109,16 +155,25 @@ namespace ventrue {
 		DEL(presetBankReplaceMap);
 		DEL(deviceChannelMap);
 		DEL_OBJS_VECTOR(virInstList);
+		DEL(midiRecorder);
+		DEL(midiInput);
 		DEL(realtimeKeyEventList);
 		DEL(openedAudioTime);
 
 		//
 		DEL(taskProcesser);
 		DEL(realtimeKeyOpTaskProcesser);
+		DEL(soundFontTaskProcesser);
 		DEL(regionSounderThreadPool);
 
 		//
 		DEL(effects);
+		DEL(reverbBus);
+		DEL(chorusBus);
+		DEL_ARRAY(reverbSendLeftSamples);
+		DEL_ARRAY(reverbSendRightSamples);
+		DEL_ARRAY(chorusSendLeftSamples);
+		DEL_ARRAY(chorusSendRightSamples);
 
 		DEL(cmdLock);
 		DEL(waitSem);
@@ -136,6 +191,14 @@ namespace ventrue {
 			DEL(it->second);
 		DEL(sfParserMap);
 
+		//共享音源需在乐器和解析器之后释放
+		for (int i = 0; i < sharedSoundFonts->size(); i++)
+			SoundFontRepository::GetInstance().Release((*sharedSoundFonts)[i]);
+		DEL(sharedSoundFonts);
+
+		DEL(swapSoundFont);
+		DEL_OBJS_VECTOR(retiredSoundFonts);
+
 
 #ifdef _WIN32
 		timeEndPeriod(1);
@@ -180,6 +243,21 @@ namespace ventrue {
 		else if (childFrameSampleCount < 1)childFrameSampleCount = 1;
 
 		effects->Set(leftChannelSamples, rightChannelSamples, frameSampleCount);
+		AllocEffectSendSamples();
+	}
+
+	//按帧样本数量分配发送总线采样点
+	void Ventrue::AllocEffectSendSamples()
+	{
+		DEL_ARRAY(reverbSendLeftSamples);
+		DEL_ARRAY(reverbSendRightSamples);
+		DEL_ARRAY(chorusSendLeftSamples);
+		DEL_ARRAY(chorusSendRightSamples);
+
+		reverbSendLeftSamples = new float[frameSampleCount]();
+		reverbSendRightSamples = new float[frameSampleCount]();
+		chorusSendLeftSamples = new float[frameSampleCount]();
+		chorusSendRightSamples = new float[frameSampleCount]();
 	}
 
 
@@ -224,7 +302,16 @@ namespace ventrue {
 
 		//
 		MidiPlay* midiPlay = new MidiPlay(this);
-		midiPlay->ParseMidiFile((*midiFilePaths)[idx], GetTrackChannelMergeMode());
+		if (isMidiStreaming)
+		{
+			midiPlay->OpenMidiStream((*midiFilePaths)[idx]);
+		}
+		else
+		{
+			midiPlay->ParseMidiFile((*midiFilePaths)[idx], GetTrackChannelMergeMode(), isReleaseMidiEventObjects, &midiNoteCullOptions);
+			if (isUseMidiTimeline)
+				midiPlay->CompileTimeline(sampleProcessRate);
+		}
 		(*midiPlayMap)[idx] = midiPlay;
 	}
 
@@ -352,6 +439,7 @@ namespace ventrue {
 	{
 		AddSoundFontParser("VentrueFont", new VentrueFont(this));
 		AddSoundFontParser("SF2", new SF2Parser(this));
+		AddSoundFontParser("SoundFontCache", new SoundFontCache(this));
 	}
 
 	//增加一个解析格式类型
@@ -360,6 +448,13 @@ namespace ventrue {
 		(*sfParserMap)[formatName] = sfParser;
 	}
 
+	//保存当前已加载的所有样本，乐器，预设为预编译音源缓存文件
+	bool Ventrue::SaveSoundFontCache(string path)
+	{
+		SoundFontCache cache(this);
+		return cache.Save(path);
+	}
+
 	//根据格式类型,解析soundfont文件
 	void Ventrue::ParseSoundFont(string formatName, string path)
 	{
@@ -370,6 +465,293 @@ namespace ventrue {
 
 		if (sfParser)
 			sfParser->Parse(path);
+
+		BuildKeyRegionTables(*instList);
+	}
+
+	//使用独立的解析器实例，解析soundfont文件到指定的音源中
+	//可以在音源加载线程中执行，不会改变ventrue自身的解析状态
+	void Ventrue::ParseSoundFont(string formatName, string path, SoundFont* soundFont)
+	{
+		auto it = sfParserMap->find(formatName);
+		if (it == sfParserMap->end())
+			return;
+
+		SoundFontParser* sfParser = it->second->NewInstance(this);
+		sfParser->SetSoundFont(soundFont);
+		sfParser->Parse(path);
+		DEL(sfParser);
+
+		BuildKeyRegionTables(*soundFont->GetInstrumentList());
+	}
+
+	//为新解析的乐器建立按键查找表
+	void Ventrue::BuildKeyRegionTables(InstrumentList& insts)
+	{
+		for (int i = 0; i < insts.size(); i++)
+		{
+			if (!insts[i]->IsBuildedKeyRegionTable())
+				insts[i]->BuildKeyRegionTable();
+		}
+	}
+
+	//从进程内共享的音源库中加载音源
+	bool Ventrue::LoadSharedSoundFont(string formatName, string path)
+	{
+		SoundFont* soundFont = SoundFontRepository::GetInstance().Acquire(this, formatName, path);
+		if (soundFont == nullptr)
+			return false;
+
+		//预设表在渲染线程中查找，因此在渲染线程中加入共享音源
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = this;
+		ev->ptr = soundFont;
+		ev->processCallBack = _AddSharedSoundFont;
+		PostTask(ev);
+		return true;
+	}
+
+	void Ventrue::_AddSharedSoundFont(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+		SoundFont* soundFont = (SoundFont*)ventrueEvent->ptr;
+
+		//同一共享音源只保留一个引用
+		vector<SoundFont*>& soundFonts = *ventrue.sharedSoundFonts;
+		for (int i = 0; i < soundFonts.size(); i++)
+		{
+			if (soundFonts[i] == soundFont) {
+				SoundFontRepository::GetInstance().Release(soundFont);
+				return;
+			}
+		}
+
+		soundFonts.push_back(soundFont);
+	}
+
+	//在后台加载音源，加载完成后在两帧渲染之间替换当前的切换音源
+	void Ventrue::SwapSoundFont(string formatName, string path)
+	{
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = this;
+		ev->sfFormatName = formatName;
+		ev->sfPath = path;
+		ev->processCallBack = _LoadSwapSoundFont;
+		soundFontTaskProcesser->PostTask(ev);
+	}
+
+	//渐进加载音源(作为切换音源)
+	void Ventrue::LoadSoundFontAsync(string formatName, string path)
+	{
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = this;
+		ev->sfFormatName = formatName;
+		ev->sfPath = path;
+		ev->value = 1;
+		ev->processCallBack = _LoadSwapSoundFont;
+		soundFontTaskProcesser->PostTask(ev);
+	}
+
+	void Ventrue::_LoadSwapSoundFont(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+		ventrue.LoadSwapSoundFont(ventrueEvent->sfFormatName, ventrueEvent->sfPath, ventrueEvent->value == 1);
+	}
+
+	//加载切换音源(在音源加载线程中执行)
+	void Ventrue::LoadSwapSoundFont(string formatName, string path, bool isProgressive)
+	{
+		SoundFont* soundFont = new SoundFont(path, 0);
+
+		//渐进加载时解析只保留原始样本数据
+		soundFont->GetSampleStore()->SetDeferred(isProgressive);
+		ParseSoundFont(formatName, path, soundFont);
+		if (soundFont->GetPresetList()->empty()) {
+			DEL(soundFont);
+			return;
+		}
+
+		//标记样本尚未加载完成的预设
+		if (isProgressive)
+		{
+			PresetList& presets = *soundFont->GetPresetList();
+			for (int i = 0; i < presets.size(); i++)
+				presets[i]->SetReady(soundFont->IsPresetSamplesLoaded(presets[i]));
+		}
+
+		//在渲染线程中两帧之间替换，并取回旧音源
+		SoundFont* oldSoundFont = nullptr;
+		Semaphore waitSem;
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = this;
+		ev->ptr = soundFont;
+		ev->exPtr[0] = &oldSoundFont;
+		ev->sem = &waitSem;
+		ev->processCallBack = _SwapSoundFont;
+		PostTask(ev);
+		waitSem.wait();
+
+		if (oldSoundFont != nullptr) {
+			retiredSoundFonts->push_back(oldSoundFont);
+			ReclaimSoundFonts();
+		}
+
+		if (isProgressive)
+			LoadProgressiveSamples(soundFont);
+	}
+
+	//按预设逐个加载渐进音源的样本(在音源加载线程中执行)
+	//样本在预设标记为完成之前写入，渲染线程只在预设完成后才会读取其样本
+	void Ventrue::LoadProgressiveSamples(SoundFont* soundFont)
+	{
+		PresetList& presets = *soundFont->GetPresetList();
+		PresetMap& presetDict = *soundFont->GetPresetBankDict();
+
+		//已载入midi文件中会使用的预设排在前面
+		vector<Preset*> loadOrder;
+		unordered_set<Preset*> orderSet;
+		vector<int> usedKeys;
+		GetMidiUsedPresetKeys(usedKeys);
+		for (int i = 0; i < usedKeys.size(); i++)
+		{
+			auto it = presetDict.find(usedKeys[i]);
+			//与GetInstrumentPreset一样，找不到时忽略bankSelectLSB再查找
+			if (it == presetDict.end())
+				it = presetDict.find(usedKeys[i] & 0xff00ff);
+			if (it != presetDict.end() && orderSet.insert(it->second).second)
+				loadOrder.push_back(it->second);
+		}
+
+		for (int i = 0; i < presets.size(); i++)
+		{
+			if (orderSet.insert(presets[i]).second)
+				loadOrder.push_back(presets[i]);
+		}
+
+		//
+		ParallelJobs jobs;
+		vector<Sample*> samples;
+		for (int i = 0; i < loadOrder.size(); i++)
+		{
+			if (isStopSoundFontLoad)
+				return;
+
+			Preset* preset = loadOrder[i];
+			if (!preset->IsReady())
+			{
+				samples.clear();
+				soundFont->GetPresetUnloadedSamples(preset, samples);
+				jobs.Start(samples.size(), [&samples](size_t idx) { samples[idx]->ResolveSourceSamples(); });
+				jobs.Wait();
+
+				preset->SetReady(true);
+			}
+
+			if (presetReadyCallBack != nullptr)
+				presetReadyCallBack(this, preset, presetReadyCallBackData);
+		}
+	}
+
+	//获取已载入的midi文件中会使用的预设(不能在渲染线程中调用)
+	void Ventrue::GetMidiUsedPresetKeys(vector<int>& keys)
+	{
+		//midiPlayMap只在渲染线程中访问
+		Semaphore waitSem;
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = this;
+		ev->ptr = &keys;
+		ev->sem = &waitSem;
+		ev->processCallBack = _GetMidiUsedPresetKeys;
+		PostTask(ev);
+		waitSem.wait();
+	}
+
+	void Ventrue::_GetMidiUsedPresetKeys(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+		vector<int>& keys = *(vector<int>*)ventrueEvent->ptr;
+
+		for (auto it = ventrue.midiPlayMap->begin(); it != ventrue.midiPlayMap->end(); it++)
+			it->second->GetUsedPresetKeys(keys);
+
+		ventrueEvent->sem->set();
+	}
+
+	void Ventrue::_SwapSoundFont(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+
+		SoundFont* oldSoundFont = ventrue.swapSoundFont;
+		*((SoundFont**)ventrueEvent->exPtr[0]) = oldSoundFont;
+		ventrue.swapSoundFont = (SoundFont*)ventrueEvent->ptr;
+		ventrue.UpdateVirInstPresets(oldSoundFont);
+
+		ventrueEvent->sem->set();
+	}
+
+	//释放已没有发声和虚拟乐器使用的被替换音源(在音源加载线程中执行)
+	//替换之后新的发声不会再使用旧音源，因此引用数量为0时即可释放
+	void Ventrue::ReclaimSoundFonts()
+	{
+		vector<SoundFont*>::iterator it = retiredSoundFonts->begin();
+		for (; it != retiredSoundFonts->end(); )
+		{
+			if ((*it)->GetVoiceCount() == 0) {
+				DEL(*it);
+				it = retiredSoundFonts->erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+
+		//还有正在发声的音源时，稍后再检查
+		if (!retiredSoundFonts->empty() && !isReclaimPosted) {
+			isReclaimPosted = true;
+			soundFontTaskProcesser->PostTask(_ReclaimSoundFonts, this, 100);
+		}
+	}
+
+	void Ventrue::_ReclaimSoundFonts(Task* ev)
+	{
+		Ventrue& ventrue = *((Ventrue*)ev->data);
+		ventrue.isReclaimPosted = false;
+		ventrue.ReclaimSoundFonts();
+	}
+
+	//使虚拟乐器使用当前音源中对应的预设
+	//仍指向旧音源预设的乐器，在新音源中找不到对应预设时置空，等按键时再重新查找
+	void Ventrue::UpdateVirInstPresets(SoundFont* oldSoundFont)
+	{
+		for (int i = 0; i < virInstList->size(); i++)
+		{
+			VirInstrument* virInst = (*virInstList)[i];
+			Preset* virInstPreset = virInst->GetPreset();
+			bool isUseOldSoundFont =
+				oldSoundFont != nullptr && virInstPreset != nullptr &&
+				virInstPreset->soundFont == oldSoundFont;
+
+			Channel* channel = virInst->GetChannel();
+			if (virInst->IsRemove() || channel == nullptr)
+			{
+				if (isUseOldSoundFont)
+					virInst->SetPreset(nullptr);
+				continue;
+			}
+
+			Preset* preset = GetInstrumentPreset(channel->GetBankSelectMSB(), channel->GetBankSelectLSB(), channel->GetProgramNum());
+			if (preset == nullptr)
+				preset = GetInstrumentPreset(0, 0, channel->GetProgramNum());
+
+			if (preset != nullptr)
+				virInst->SetPreset(preset);
+			else if (isUseOldSoundFont)
+				virInst->SetPreset(nullptr);
+		}
 	}
 
 
@@ -398,38 +780,247 @@ namespace ventrue {
 		sampleProcessRate = (float)rate;
 		invSampleProcessRate = 1 / sampleProcessRate;
 		Stk::setSampleRate(sampleProcessRate);
+
+		//和声效果器的lfo和混响的延迟线长度按采样率计算，需要更新
+		chorusBus->SetSampleRate(sampleProcessRate);
+		reverbBus->SetSampleRate(sampleProcessRate);
+		for (int i = 0; i < virInstList->size(); i++)
+		{
+			EffectChorus* regionChorus = (*virInstList)[i]->regionChorus;
+			if (regionChorus != nullptr)
+				regionChorus->SetSampleRate(sampleProcessRate);
+
+			EffectFreeVerb* regionReverb = (*virInstList)[i]->regionReverb;
+			if (regionReverb != nullptr)
+				regionReverb->SetSampleRate(sampleProcessRate);
+		}
 	}
 
 	// 增加一个样本到样本列表
-	Sample* Ventrue::AddSample(string name, short* samples, size_t size, byte* sm24)
+	Sample* Ventrue::AddSample(string name, short* samples, size_t size, byte* sm24, SoundFont* soundFont)
+	{
+		Sample* sample = new Sample();
+		sample->name = name;
+		GetLoadSampleStore(soundFont)->SetSamples(sample, samples, (uint32_t)size, sm24);
+		GetSampleList(soundFont)->push_back(sample);
+		return sample;
+	}
+
+	// 增加一个空样本到样本列表(样本数据之后通过样本存储设置)
+	Sample* Ventrue::AddSample(string name, SoundFont* soundFont)
+	{
+		Sample* sample = new Sample();
+		sample->name = name;
+		GetSampleList(soundFont)->push_back(sample);
+		return sample;
+	}
+
+	// 增加一个已解码的样本到样本列表(pcm由外部持有，不复制)
+	Sample* Ventrue::AddSample(string name, float* pcm, size_t size, SoundFont* soundFont)
 	{
 		Sample* sample = new Sample();
 		sample->name = name;
-		sample->SetSamples(samples, (uint32_t)size, sm24);
-		sampleList->push_back(sample);
+		sample->pcm = pcm;
+		sample->size = size;
+		sample->isExternalPcm = true;
+		GetSampleList(soundFont)->push_back(sample);
 		return sample;
 	}
 
+	//获取样本列表
+	SampleList* Ventrue::GetSampleList(SoundFont* soundFont)
+	{
+		return (soundFont != nullptr ? soundFont->GetSampleList() : sampleList);
+	}
+
+	//获取解析音源时使用的样本存储
+	SampleStore* Ventrue::GetLoadSampleStore(SoundFont* soundFont)
+	{
+		return (soundFont != nullptr ? soundFont->GetSampleStore() : sampleStore);
+	}
+
+	//设置样本缓存内存预算(单位:字节, 0:不限制)
+	void Ventrue::SetSampleCacheBudget(size_t bytes)
+	{
+		sampleStore->SetBudget(bytes);
+	}
+
+	//预加载并固定预设所使用的样本，使其常驻内存
+	void Ventrue::PinPreset(int bankSelectMSB, int bankSelectLSB, int instrumentNum)
+	{
+		Preset* preset = GetInstrumentPreset(bankSelectMSB, bankSelectLSB, instrumentNum);
+		sampleStore->PinPreset(preset);
+	}
+
+	//在播放之前预加载预设
+	void Ventrue::PreloadPresets(vector<MidiProgramUse>& programs)
+	{
+		vector<int> keys;
+		for (int i = 0; i < programs.size(); i++)
+		{
+			keys.push_back(
+				programs[i].bankSelectMSB << 16 |
+				programs[i].bankSelectLSB << 8 |
+				programs[i].programNum);
+		}
+
+		PreloadPresetKeys(keys);
+	}
+
+	//预加载所有已载入的midi文件播放时会用到的预设
+	void Ventrue::PreloadMidiPresets()
+	{
+		vector<int> keys;
+		GetMidiUsedPresetKeys(keys);
+		PreloadPresetKeys(keys);
+	}
+
+	//预加载预设
+	void Ventrue::PreloadPresetKeys(vector<int>& keys)
+	{
+		//预设表在渲染线程中查找
+		vector<Preset*> presets;
+		Semaphore waitSem;
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = this;
+		ev->ptr = &keys;
+		ev->exPtr[0] = &presets;
+		ev->sem = &waitSem;
+		ev->processCallBack = _FindPresets;
+		PostTask(ev);
+		waitSem.wait();
+
+		//
+		int regionCount = 0;
+		for (int i = 0; i < presets.size(); i++)
+		{
+			Preset* preset = presets[i];
+
+			//共享音源和切换音源的样本在加载时已全部解码
+			if (preset->soundFont == nullptr)
+				sampleStore->PinPreset(preset);
+
+			InstLinkToPresetRegionInfoList* presetInfos = preset->GetPresetRegionLinkInfoList();
+			for (int j = 0; j < presetInfos->size(); j++)
+				regionCount += (int)(*presetInfos)[j].linkInst->GetInstRegionLinkInfoList()->size();
+		}
+
+		//对象池在回收时最多保留300个空闲对象
+		VentruePool& pool = VentruePool::GetInstance();
+		pool.KeySounderPool().Reserve(min((int)presets.size() * 16, 256));
+		pool.RegionSounderPool().Reserve(min(regionCount, 256));
+	}
+
+	void Ventrue::_FindPresets(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+		vector<int>& keys = *(vector<int>*)ventrueEvent->ptr;
+		vector<Preset*>& presets = *(vector<Preset*>*)ventrueEvent->exPtr[0];
+
+		for (int i = 0; i < keys.size(); i++)
+		{
+			int key = keys[i];
+			Preset* preset = ventrue.GetInstrumentPreset(key >> 16 & 0xff, key >> 8 & 0xff, key & 0xff);
+			if (preset == nullptr)
+				preset = ventrue.GetInstrumentPreset(0, 0, key & 0xff);
+
+			if (preset != nullptr && find(presets.begin(), presets.end(), preset) == presets.end())
+				presets.push_back(preset);
+		}
+
+		ventrueEvent->sem->set();
+	}
+
+	//取消固定预设所使用的样本
+	void Ventrue::UnpinPreset(int bankSelectMSB, int bankSelectLSB, int instrumentNum)
+	{
+		Preset* preset = GetInstrumentPreset(bankSelectMSB, bankSelectLSB, instrumentNum);
+		sampleStore->UnpinPreset(preset);
+	}
+
+	//获取样本缓存命中次数
+	uint64_t Ventrue::GetSampleCacheHitCount()
+	{
+		return sampleStore->GetHitCount();
+	}
+
+	//获取样本缓存未命中次数
+	uint64_t Ventrue::GetSampleCacheMissCount()
+	{
+		return sampleStore->GetMissCount();
+	}
+
+	//设置是否对大样本使用磁盘流式播放
+	void Ventrue::SetSampleStreaming(bool enable, uint32_t preloadFrames)
+	{
+		isSampleStreaming = enable;
+		sampleStreamPreloadFrames = preloadFrames;
+
+		if (enable)
+			sampleStreamer->Start();
+		else
+			sampleStreamer->Stop();
+	}
+
+	//获取流式样本数据未能及时读取的采样点数量
+	uint64_t Ventrue::GetSampleStreamUnderrunCount()
+	{
+		return sampleStreamer->GetUnderrunCount();
+	}
+
+	//整理自身解析的已解码样本
+	SampleCompactReport Ventrue::CompactSamples(bool isTrimLoopTail)
+	{
+		SampleCompactReport report;
+		SampleCompactor compactor(isTrimLoopTail);
+		float* arena = compactor.Compact(sampleList, instList, presetList, report);
+		if (arena != nullptr)
+			sampleArenas->push_back(arena);
+
+		return report;
+	}
+
 	// 增加一个乐器到乐器列表
-	Instrument* Ventrue::AddInstrument(string name)
+	Instrument* Ventrue::AddInstrument(string name, SoundFont* soundFont)
 	{
 		Instrument* inst = new Instrument();
 		inst->name = name;
-		instList->push_back(inst);
+		GetInstrumentList(soundFont)->push_back(inst);
 		return inst;
 	}
 
+	//获取乐器列表
+	InstrumentList* Ventrue::GetInstrumentList(SoundFont* soundFont)
+	{
+		return (soundFont != nullptr ? soundFont->GetInstrumentList() : instList);
+	}
+
 	// 增加一个预设到预设列表
-	Preset* Ventrue::AddPreset(string name, int bankSelectMSB, int bankSelectLSB, int instrumentNum)
+	Preset* Ventrue::AddPreset(string name, int bankSelectMSB, int bankSelectLSB, int instrumentNum, SoundFont* soundFont)
 	{
 		Preset* preset = new Preset();
 		preset->name = name;
 		preset->SetBankNum(bankSelectMSB, bankSelectLSB, instrumentNum);
+		if (soundFont != nullptr)
+		{
+			soundFont->GetPresetList()->push_back(preset);
+			(*soundFont->GetPresetBankDict())[preset->GetBankKey()] = preset;
+			preset->soundFont = soundFont;
+			return preset;
+		}
+
 		presetList->push_back(preset);
 		(*presetBankDict)[preset->GetBankKey()] = preset;
 		return preset;
 	}
 
+	//获取预设列表
+	PresetList* Ventrue::GetPresetList(SoundFont* soundFont)
+	{
+		return (soundFont != nullptr ? soundFont->GetPresetList() : presetList);
+	}
+
 	// 乐器绑定到预设上
 	Region* Ventrue::InstrumentBindToPreset(Instrument* inst, Preset* preset)
 	{
@@ -610,6 +1201,9 @@ namespace ventrue {
 			{
 				deviceChannelMap->erase(itc);
 				DEL(channel);
+
+				if (num < 16)
+					midiInputChannelMask &= ~(1 << num);
 			}
 		}
 
@@ -857,19 +1451,41 @@ namespace ventrue {
 	/// <param name="virInst">如果为null,将录制所有乐器</param>
 	/// <param name="bpm">录制的BPM</param>
 	/// <param name="tickForQuarterNote">一个四分音符发音的tick数</param>
-	void Ventrue::RecordMidi(VirInstrument* virInst, float bpm, float tickForQuarterNote)
+	/// <param name="startDatas">按乐器顺序预先分配的开始录制资源，可为nullptr</param>
+	void Ventrue::RecordMidi(VirInstrument* virInst, float bpm, float tickForQuarterNote, vector<MidiRecordStartData>* startDatas)
 	{
+		//没有预先准备时，在这里启动后台线程
+		if (startDatas == nullptr)
+			midiRecorder->Start();
+
 		if (virInst != nullptr) {
-			virInst->RecordMidi(bpm, tickForQuarterNote);
+			virInst->RecordMidi(bpm, tickForQuarterNote,
+				(startDatas != nullptr && !startDatas->empty()) ? &(*startDatas)[0] : nullptr);
 			return;
 		}
 
+		//乐器列表在准备之后发生变化时，多出的乐器在渲染线程中分配
 		for (int i = 0; i < virInstList->size(); i++)
 		{
-			(*virInstList)[i]->RecordMidi(bpm, tickForQuarterNote);
+			(*virInstList)[i]->RecordMidi(bpm, tickForQuarterNote,
+				(startDatas != nullptr && i < startDatas->size()) ? &(*startDatas)[i] : nullptr);
 		}
 	}
 
+	//获取开始录制指定乐器(为null时为所有乐器)需要预先分配的资源
+	void Ventrue::GetRecordMidiStartDatas(VirInstrument* virInst, vector<MidiRecordStartData>& startDatas)
+	{
+		if (virInst != nullptr) {
+			startDatas.resize(1);
+			startDatas[0].isNeedRing = !virInst->GetMidiTrackRecord()->IsRingAllocated();
+			return;
+		}
+
+		startDatas.resize(virInstList->size());
+		for (int i = 0; i < virInstList->size(); i++)
+			startDatas[i].isNeedRing = !(*virInstList)[i]->GetMidiTrackRecord()->IsRingAllocated();
+	}
+
 	/// 停止所有乐器midi的录制
 	void Ventrue::StopRecordMidi()
 	{
@@ -959,6 +1575,27 @@ namespace ventrue {
 		midiFile->SaveMidiFormatMemDataToDist(saveFilePath);
 	}
 
+	/// <summary>
+	/// 在后台线程中把已录制的midi保存到文件
+	/// </summary>
+	/// <param name="virInst">如果为null,将保存所有乐器</param>
+	/// <param name="saveFilePath">保存路径</param>
+	void Ventrue::SaveRecordMidiFile(VirInstrument* virInst, string saveFilePath)
+	{
+		vector<MidiTrackRecord*> records;
+		if (virInst != nullptr)
+		{
+			records.push_back(virInst->GetMidiTrackRecord());
+		}
+		else
+		{
+			for (int i = 0; i < virInstList->size(); i++)
+				records.push_back((*virInstList)[i]->GetMidiTrackRecord());
+		}
+
+		midiRecorder->SaveMidiFile(saveFilePath, records, recordMidiBPM, recordMidiTickForQuarterNote);
+	}
+
 	//添加替换乐器
 	void Ventrue::AppendReplaceInstrument(
 		int orgBankMSB, int orgBankLSB, int orgInstNum,
@@ -986,19 +1623,42 @@ namespace ventrue {
 			key = itReplace->second;
 		}
 
-		auto it = presetBankDict->find(key);
-		if (it != presetBankDict->end()) {
-			return it->second;
-		}
+		Preset* preset = FindPreset(key);
+		if (preset != nullptr)
+			return preset;
 
 		//
 		key &= 0xff00ff;  //bankSelectMSB << 16 | instrumentNum;
+		return FindPreset(key);
+	}
+
+	// 在自身和共享音源的预设表中查找预设
+	Preset* Ventrue::FindPreset(int key)
+	{
+		PresetMap::iterator it;
+		if (swapSoundFont != nullptr)
+		{
+			PresetMap* dict = swapSoundFont->GetPresetBankDict();
+			it = dict->find(key);
+			if (it != dict->end()) {
+				return it->second;
+			}
+		}
+
 		it = presetBankDict->find(key);
 		if (it != presetBankDict->end()) {
-			//cout << "使用乐器:"<<instrumentNum<<" " << it->second->name << endl;
 			return it->second;
 		}
 
+		for (int i = 0; i < sharedSoundFonts->size(); i++)
+		{
+			PresetMap* dict = (*sharedSoundFonts)[i]->GetPresetBankDict();
+			it = dict->find(key);
+			if (it != dict->end()) {
+				return it->second;
+			}
+		}
+
 		return nullptr;
 	}
 
@@ -1066,6 +1726,9 @@ namespace ventrue {
 		//清除通道buffer
 		ClearChannelBuffer();
 
+		//取出midi字节流输入的消息
+		midiInput->BeginBlock(curtSampleCount);
+
 		//
 		for (childFramePos = 0; childFramePos < frameSampleCount; childFramePos += childFrameSampleCount)
 		{
@@ -1076,6 +1739,7 @@ namespace ventrue {
 				renderTimeCallBack(sec, renderTimeCallBackData);
 
 			ProcessRealtimeKeyEvents();
+			ProcessMidiInputEvents();
 			ProcessMidiEvents();
 
 			//渲染虚拟乐器区域发声
@@ -1129,6 +1793,135 @@ namespace ventrue {
 		cmdLock->unlock();
 	}
 
+	// 输入midi原始字节流
+	void Ventrue::PushMidiBytes(const uint8_t* data, size_t size, int sampleOffset)
+	{
+		midiInput->Push(data, size, sampleOffset);
+	}
+
+	//获取因队列已满而丢弃的midi输入消息数量
+	uint64_t Ventrue::GetMidiInputDroppedCount()
+	{
+		return midiInput->GetDroppedCount();
+	}
+
+	// 处理midi字节流输入的消息
+	void Ventrue::ProcessMidiInputEvents()
+	{
+		MidiInputEvent ev;
+		while (midiInput->Pop(curtSampleCount, ev))
+			ProcessMidiInputEvent(ev);
+	}
+
+	// 获取midi字节流输入通道对应的设备通道(不存在时创建)
+	Channel* Ventrue::GetMidiInputChannel(int channelNum)
+	{
+		Channel* channel = GetDeviceChannel(channelNum);
+		if (channel == nullptr)
+		{
+			channel = new Channel(nullptr, channelNum);
+			(*deviceChannelMap)[channelNum] = channel;
+			midiInputChannelMask |= 1 << channelNum;
+			ResetMidiInputChannel(channel);
+		}
+
+		return channel;
+	}
+
+	// 复位midi字节流输入创建的设备通道
+	// 与midi文件的轨道通道相同，通道9为鼓点通道，使用打击乐库
+	void Ventrue::ResetMidiInputChannel(Channel* channel)
+	{
+		channel->Clear();
+		channel->SetPitchBend(8192);
+
+		if (channel->GetChannelNum() == 9)
+		{
+			channel->SetControllerValue(MidiControllerType::BankSelectMSB, 128);
+			channel->SetControllerValue(MidiControllerType::BankSelectLSB, 0);
+			channel->SetProgramNum(0);
+		}
+	}
+
+	// 处理一个midi字节流输入的消息
+	void Ventrue::ProcessMidiInputEvent(MidiInputEvent& ev)
+	{
+		//SysEx复位消息: 只复位midi字节流输入创建的设备通道
+		if (ev.status == 0xF0)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				if ((midiInputChannelMask & (1 << i)) == 0)
+					continue;
+
+				Channel* channel = GetDeviceChannel(i);
+				if (channel == nullptr)
+					continue;
+
+				ResetMidiInputChannel(channel);
+				ModulationVirInstParams(channel);
+			}
+			return;
+		}
+
+		int channelNum = ev.status & 0x0F;
+		Channel* channel = GetMidiInputChannel(channelNum);
+
+		switch (ev.status & 0xF0)
+		{
+		case 0x90: //NoteOn
+		case 0x80: //NoteOff
+		{
+			Preset* preset = GetInstrumentPreset(channel->GetBankSelectMSB(), channel->GetBankSelectLSB(), channel->GetProgramNum());
+			if (preset == nullptr)
+			{
+				preset = GetInstrumentPreset(0, 0, channel->GetProgramNum());
+				if (preset == nullptr)
+					return;
+			}
+
+			VirInstrument* virInst = EnableVirInstrument(preset, channel);
+			if ((ev.status & 0xF0) == 0x90 && ev.data2 > 0)
+				virInst->OnKey(ev.data1, (float)ev.data2);
+			else
+				virInst->OffKey(ev.data1, (float)ev.data2);
+		}
+		break;
+
+		case 0xB0: //Controller
+		{
+			//AllSoundOff, AllNotesOff
+			if (ev.data1 == 120 || ev.data1 == 123)
+			{
+				VirInstrument* virInst = GetVirInstrumentByChannel(channel);
+				if (virInst != nullptr)
+					virInst->OffAllKeys();
+				return;
+			}
+
+			channel->SetControllerValue((MidiControllerType)ev.data1, ev.data2);
+			ModulationVirInstParams(channel);
+		}
+		break;
+
+		case 0xC0: //ProgramChange
+			//通道9为鼓点音色，与midi文件播放相同不响应乐器更换
+			if (channelNum == 9)
+				return;
+
+			channel->SetProgramNum(ev.data1);
+			break;
+
+		case 0xE0: //PitchBend
+			channel->SetPitchBend(ev.data2 << 7 | ev.data1);
+			ModulationVirInstParams(channel);
+			break;
+
+		default:
+			break;
+		}
+	}
+
 	// 处理播放midi文件事件
 	void Ventrue::ProcessMidiEvents()
 	{
@@ -1255,6 +2048,9 @@ namespace ventrue {
 	void Ventrue::MixVirInstsSamplesToChannelBuffer()
 	{
 		isVirInstSoundEnd = true;
+		isReverbBusActive = false;
+		isChorusBusActive = false;
+
 		for (int i = 0; i < virInstList->size(); i++)
 		{
 			VirInstrument& virInst = *(*virInstList)[i];
@@ -1265,6 +2061,9 @@ namespace ventrue {
 			isSoundEnd = false;
 			virInst.ApplyEffectsToChannelBuffer();
 
+			if (isUseEffectSendBus)
+				SendVirInstSamplesToBus(virInst);
+
 			float* instLeftChannelSamples = virInst.GetLeftChannelSamples();
 			float* instRightChannelSamples = virInst.GetRightChannelSamples();
 
@@ -1284,6 +2083,113 @@ namespace ventrue {
 				break;
 			}
 		}
+
+		MixEffectSendBusToChannelBuffer();
+	}
+
+	//按乐器发送量累加到发送总线
+	void Ventrue::SendVirInstSamplesToBus(VirInstrument& virInst)
+	{
+		float* instLeftChannelSamples = virInst.GetLeftChannelSamples();
+		float* instRightChannelSamples = virInst.GetRightChannelSamples();
+
+		float reverbSend = virInst.GetReverbSend();
+		if (reverbSend > 0.001f)
+		{
+			if (!isReverbBusActive)
+			{
+				memset(reverbSendLeftSamples, 0, sizeof(float) * frameSampleCount);
+				memset(reverbSendRightSamples, 0, sizeof(float) * frameSampleCount);
+				isReverbBusActive = true;
+			}
+
+			for (int n = 0; n < frameSampleCount; n++)
+			{
+				reverbSendLeftSamples[n] += instLeftChannelSamples[n] * reverbSend;
+				reverbSendRightSamples[n] += instRightChannelSamples[n] * reverbSend;
+			}
+		}
+
+		float chorusSend = virInst.GetChorusSend();
+		if (chorusSend > 0.001f)
+		{
+			if (!isChorusBusActive)
+			{
+				memset(chorusSendLeftSamples, 0, sizeof(float) * frameSampleCount);
+				memset(chorusSendRightSamples, 0, sizeof(float) * frameSampleCount);
+				isChorusBusActive = true;
+			}
+
+			for (int n = 0; n < frameSampleCount; n++)
+			{
+				chorusSendLeftSamples[n] += instLeftChannelSamples[n] * chorusSend;
+				chorusSendRightSamples[n] += instRightChannelSamples[n] * chorusSend;
+			}
+		}
+	}
+
+	//处理发送总线效果器，并混合到声道buffer中
+	void Ventrue::MixEffectSendBusToChannelBuffer()
+	{
+		if (!isUseEffectSendBus)
+			return;
+
+		isReverbBusTail = ProcessEffectSendBus(
+			reverbBus, reverbSendLeftSamples, reverbSendRightSamples, isReverbBusActive, isReverbBusTail);
+
+		isChorusBusTail = ProcessEffectSendBus(
+			chorusBus, chorusSendLeftSamples, chorusSendRightSamples, isChorusBusActive, isChorusBusTail);
+
+		if (isReverbBusTail || isChorusBusTail)
+			isSoundEnd = false;
+	}
+
+	//处理一个发送总线
+	//返回总线是否还有尾音
+	bool Ventrue::ProcessEffectSendBus(VentrueEffect* bus, float* sendLeft, float* sendRight, bool isActive, bool isTail)
+	{
+		if (!isActive)
+		{
+			if (!isTail)
+				return false;
+
+			//没有输入时继续处理尾音
+			memset(sendLeft, 0, sizeof(float) * frameSampleCount);
+			memset(sendRight, 0, sizeof(float) * frameSampleCount);
+		}
+
+		bus->EffectProcess(sendLeft, sendRight, frameSampleCount);
+
+		switch (channelOutputMode)
+		{
+		case ChannelOutputMode::Stereo:
+			for (int n = 0; n < frameSampleCount; n++)
+			{
+				leftChannelSamples[n] += sendLeft[n];
+				rightChannelSamples[n] += sendRight[n];
+			}
+			break;
+
+		case ChannelOutputMode::Mono:
+			for (int n = 0; n < frameSampleCount; n++)
+				leftChannelSamples[n] += sendLeft[n] + sendRight[n];
+			break;
+		}
+
+		if (isActive)
+			return true;
+
+		//检测尾音是否结束
+		int offset = (int)(frameSampleCount * 0.02f);
+		if (offset < 1) offset = 1;
+		for (int i = 0; i < frameSampleCount; i += offset)
+		{
+			if (fabsf(sendLeft[i]) > 0.0001f ||
+				fabsf(sendRight[i]) > 0.0001f)
+				return true;
+		}
+
+		return false;
 	}
 
 	//应用效果器到乐器的声道buffer
@@ -5,6 +5,8 @@
 #include "Audio/Audio.h"
 #include "Midi/MidiTypes.h"
 #include"VentruePool.h"
+#include"SampleCompactor.h"
+#include"Midi/MidiNoteCuller.h"
 
 namespace ventrue
 {
@@ -71,13 +73,76 @@ namespace ventrue
 			return mergeMode;
 		}
 
+		//设置载入midi后是否释放事件对象只保留紧凑事件
+		//音符数量巨大的midi文件开启后可大幅减少内存占用，但MidiFile中的事件列表将为空
+		inline void SetReleaseMidiEventObjects(bool isRelease)
+		{
+			isReleaseMidiEventObjects = isRelease;
+		}
+
+		//设置载入midi后裁剪音符的规则(默认不裁剪)
+		//裁剪结果可通过GetMidiPlay(idx)->GetNoteCullReport()获取，流式播放时不裁剪
+		inline void SetMidiNoteCullOptions(const MidiNoteCullOptions& options)
+		{
+			midiNoteCullOptions = options;
+		}
+
+		//设置是否以流式方式载入midi
+		//开启后载入时不解析整个文件，播放时按需解码事件，适合音符数量巨大的midi文件
+		//流式播放时不使用轨道通道合并模式，预编译时间线和预加载乐器
+		inline void SetMidiStreaming(bool isStreaming)
+		{
+			isMidiStreaming = isStreaming;
+		}
+
+		//设置载入midi后是否预编译播放时间线
+		//开启后播放时直接按采样位置分发事件，不再逐帧换算轨道速度
+		inline void SetUseMidiTimeline(bool isUse)
+		{
+			isUseMidiTimeline = isUse;
+		}
+
 
 		//增加一个解析格式类型
 		void AddSoundFontParser(string formatName, SoundFontParser* sfParser);
 
+		//保存当前已加载的所有样本，乐器，预设为预编译音源缓存文件
+		//之后可通过ParseSoundFont("SoundFontCache", path)快速加载
+		//存在流式样本时不能保存
+		bool SaveSoundFontCache(string path);
+
 		//根据格式类型,解析soundfont文件
 		void ParseSoundFont(string formatName, string path);
 
+		//从进程内共享的音源库中加载音源
+		//路径和内容都相同的音源在进程中只加载一份，由多个Ventrue只读共享，最后一个使用者销毁后才释放
+		//共享音源的样本总是在加载时全部解码，且不使用流式播放
+		//查找预设时先查找本Ventrue自身解析的音源，再按加载顺序查找共享音源
+		bool LoadSharedSoundFont(string formatName, string path);
+
+		//在后台加载音源，加载完成后在两帧渲染之间替换当前的切换音源，播放不会中断
+		//正在发声的音符继续使用旧音源直到发声结束，之后旧音源在后台释放
+		//查找预设时优先查找切换音源
+		void SwapSoundFont(string formatName, string path);
+
+		//渐进加载音源(作为切换音源)
+		//只解析完预设，乐器，区域结构后即替换当前的切换音源，样本数据在后台按预设逐个加载,
+		//已载入midi文件中会使用的预设优先加载，每个预设的样本加载完成后调用presetReadyCallBack(在音源加载线程中调用)
+		//样本尚未加载完成的预设上的按键按presetNotReadyPolicy推迟或丢弃
+		void LoadSoundFontAsync(string formatName, string path);
+
+		//设置预设样本尚未加载完成时的按键处理方式
+		inline void SetPresetNotReadyPolicy(PresetNotReadyPolicy policy)
+		{
+			presetNotReadyPolicy = policy;
+		}
+
+		//获取预设样本尚未加载完成时的按键处理方式
+		inline PresetNotReadyPolicy GetPresetNotReadyPolicy()
+		{
+			return presetNotReadyPolicy;
+		}
+
 		//启用乐器混响处理
 		inline void EnableInstReverb()
 		{
@@ -115,6 +180,33 @@ namespace ventrue
 			return isEnableInstChorus;
 		}
 
+		//设置是否使用全局混音和声发送总线(默认关闭)
+		//开启后，所有乐器按发送量(区域发送生成器和CC91/CC93)共用一个混音和一个和声效果器，
+		//此时干声不再按效果混合量衰减，CC91/CC93最大增加20%的发送量，混音效果听感会有变化
+		//关闭后，每个乐器使用各自的混音和声效果器
+		inline void SetUseEffectSendBus(bool isUse)
+		{
+			isUseEffectSendBus = isUse;
+		}
+
+		//是否使用全局混音和声发送总线
+		inline bool IsUseEffectSendBus()
+		{
+			return isUseEffectSendBus;
+		}
+
+		//获取全局混音总线效果器
+		inline EffectFreeVerb* GetReverbBus()
+		{
+			return reverbBus;
+		}
+
+		//获取全局和声总线效果器
+		inline EffectChorus* GetChorusBus()
+		{
+			return chorusBus;
+		}
+
 
 		//设置样本处理采样率
 		void SetSampleProcessRate(int rate);
@@ -170,31 +262,123 @@ namespace ventrue
 		}
 
 
+		//以下增加和获取样本，乐器，预设的函数中，
+		//soundFont为解析的目标音源，为nullptr时对应ventrue自身
+
 		// 增加一个样本到样本列表
-		Sample* AddSample(string name, short* samples, size_t size, byte* sm24 = nullptr);
+		Sample* AddSample(string name, short* samples, size_t size, byte* sm24 = nullptr, SoundFont* soundFont = nullptr);
+
+		// 增加一个空样本到样本列表(样本数据之后通过样本存储设置)
+		Sample* AddSample(string name, SoundFont* soundFont = nullptr);
 
-		inline SampleList* GetSampleList()
+		// 增加一个已解码的样本到样本列表(pcm由外部持有，不复制)
+		Sample* AddSample(string name, float* pcm, size_t size, SoundFont* soundFont = nullptr);
+
+		//获取样本列表
+		SampleList* GetSampleList(SoundFont* soundFont = nullptr);
+
+		//获取样本存储
+		inline SampleStore* GetSampleStore()
 		{
-			return sampleList;
+			return sampleStore;
 		}
 
-		// 增加一个乐器到乐器列表
-		Instrument* AddInstrument(string name);
-		//获取乐器列表
-		InstrumentList* GetInstrumentList()
+		//获取解析音源时使用的样本存储
+		SampleStore* GetLoadSampleStore(SoundFont* soundFont = nullptr);
+
+		//设置样本缓存内存预算(单位:字节, 0:不限制，即加载时全部解码)
+		//设置后，样本将在发声时按需解码，超出预算时淘汰最久未使用且未在发声的样本
+		//需要在解析音源之前设置
+		void SetSampleCacheBudget(size_t bytes);
+
+		//预加载并固定预设所使用的样本，使其常驻内存
+		void PinPreset(int bankSelectMSB, int bankSelectLSB, int instrumentNum);
+
+		//在播放之前预加载预设，避免播放中途更换乐器时的首次发声卡顿
+		//解码并固定预设使用的样本(按需解码模式)，并预先创建发声所需的池对象
+		//预设不存在时与播放时一样使用(0, 0, 乐器号)，可直接传入MidiFile::ScanProgramUses()的结果
+		//会等待渲染线程查找预设，不能在渲染线程中调用
+		void PreloadPresets(vector<MidiProgramUse>& programs);
+
+		//预加载所有已载入的midi文件播放时会用到的预设(鼓点通道使用当前的打击乐号)
+		void PreloadMidiPresets();
+
+		//取消固定预设所使用的样本
+		void UnpinPreset(int bankSelectMSB, int bankSelectLSB, int instrumentNum);
+
+		//获取样本缓存命中次数
+		uint64_t GetSampleCacheHitCount();
+
+		//获取样本缓存未命中次数
+		uint64_t GetSampleCacheMissCount();
+
+		//获取样本流读取器
+		inline SampleStreamer* GetSampleStreamer()
 		{
-			return instList;
+			return sampleStreamer;
 		}
 
-		// 增加一个预设到预设列表
-		Preset* AddPreset(string name, int bankSelectMSB, int bankSelectLSB, int instrumentNum);
+		//获取当前已渲染的采样点个数
+		inline int64_t GetRenderSamplePos()
+		{
+			return curtSampleCount;
+		}
 
-		//获取预设列表
-		inline PresetList* GetPresetList()
+		//获取midi录制后台线程
+		inline MidiRecorder* GetMidiRecorder()
 		{
-			return presetList;
+			return midiRecorder;
 		}
 
+		/// <summary>
+		/// 输入midi原始字节流(支持running status和SysEx复位消息)
+		/// 消息写入无锁队列，在下一个渲染块开始时取出，按采样位置在子帧中处理
+		/// midi通道n的消息作用于设备通道n上的虚拟乐器(不存在时自动创建)
+		/// 只允许一个线程调用
+		/// </summary>
+		/// <param name="data">midi字节流</param>
+		/// <param name="size">字节数量</param>
+		/// <param name="sampleOffset">相对于下一个渲染块开始位置的采样点偏移</param>
+		void PushMidiBytes(const uint8_t* data, size_t size, int sampleOffset = 0);
+
+		//获取因队列已满而丢弃的midi输入消息数量
+		uint64_t GetMidiInputDroppedCount();
+
+		//设置是否对大样本使用磁盘流式播放
+		//开启后，长度超过预加载长度的样本只保留开头的preloadFrames个采样点(以及循环起始处的同样长度)在内存中，
+		//其余数据在发声时由后台I/O线程从磁盘读取
+		//需要在解析音源之前设置
+		void SetSampleStreaming(bool enable, uint32_t preloadFrames = 32768);
+
+		inline bool IsSampleStreaming()
+		{
+			return isSampleStreaming;
+		}
+
+		inline uint32_t GetSampleStreamPreloadFrames()
+		{
+			return sampleStreamPreloadFrames;
+		}
+
+		//获取流式样本数据未能及时读取的采样点数量
+		uint64_t GetSampleStreamUnderrunCount();
+
+		//整理自身解析的已解码样本: 裁剪连续循环样本在循环结束点之后的数据，
+		//内容相同的样本共用一份数据，并把所有数据紧凑到一块连续内存中
+		//需在解析音源之后，开始播放之前调用，返回节省内存的统计
+		SampleCompactReport CompactSamples(bool isTrimLoopTail = true);
+
+		// 增加一个乐器到乐器列表
+		Instrument* AddInstrument(string name, SoundFont* soundFont = nullptr);
+		//获取乐器列表
+		InstrumentList* GetInstrumentList(SoundFont* soundFont = nullptr);
+
+		// 增加一个预设到预设列表
+		Preset* AddPreset(string name, int bankSelectMSB, int bankSelectLSB, int instrumentNum, SoundFont* soundFont = nullptr);
+
+		//获取预设列表
+		PresetList* GetPresetList(SoundFont* soundFont = nullptr);
+
 		// 样本绑定到乐器上
 		Region* SampleBindToInstrument(Sample* sample, Instrument* inst);
 
@@ -306,6 +490,33 @@ namespace ventrue
 		// 获取乐器预设
 		Preset* GetInstrumentPreset(int bankSelectMSB, int bankSelectLSB, int instrumentNum);
 
+		// 在自身和共享音源的预设表中查找预设
+		Preset* FindPreset(int key);
+
+		//使用独立的解析器实例，解析soundfont文件到指定的音源中
+		void ParseSoundFont(string formatName, string path, SoundFont* soundFont);
+
+		//为新解析的乐器建立按键查找表
+		void BuildKeyRegionTables(InstrumentList& insts);
+
+		//加载切换音源(在音源加载线程中执行)
+		void LoadSwapSoundFont(string formatName, string path, bool isProgressive = false);
+
+		//按预设逐个加载渐进音源的样本(在音源加载线程中执行)
+		void LoadProgressiveSamples(SoundFont* soundFont);
+
+		//获取已载入的midi文件中会使用的预设(不能在渲染线程中调用)
+		void GetMidiUsedPresetKeys(vector<int>& keys);
+
+		//预加载预设(bankSelectMSB << 16 | bankSelectLSB << 8 | 乐器号)
+		void PreloadPresetKeys(vector<int>& keys);
+
+		//释放已没有发声使用的被替换音源(在音源加载线程中执行)
+		void ReclaimSoundFonts();
+
+		//使虚拟乐器使用当前音源中对应的预设
+		void UpdateVirInstPresets(SoundFont* oldSoundFont);
+
 
 		// 根据指定通道获取关连虚拟乐器
 		VirInstrument* GetVirInstrumentByChannel(Channel* channel);
@@ -380,7 +591,11 @@ namespace ventrue
 		/// <param name="virInst">如果为null,将录制所有乐器</param>
 		/// <param name="bpm">录制的BPM</param>
 		/// <param name="tickForQuarterNote">一个四分音符发音的tick数</param>
-		void RecordMidi(VirInstrument* virInst, float bpm, float tickForQuarterNote);
+		/// <param name="startDatas">按乐器顺序预先分配的开始录制资源，可为nullptr</param>
+		void RecordMidi(VirInstrument* virInst, float bpm, float tickForQuarterNote, vector<MidiRecordStartData>* startDatas = nullptr);
+
+		//获取开始录制指定乐器(为null时为所有乐器)需要预先分配的资源
+		void GetRecordMidiStartDatas(VirInstrument* virInst, vector<MidiRecordStartData>& startDatas);
 
 		/// 停止所有乐器midi的录制
 		void StopRecordMidi();
@@ -407,6 +622,13 @@ namespace ventrue
 		//保存midiFile到文件
 		void SaveMidiFileToDisk(MidiFile* midiFile, string diskPath);
 
+		/// <summary>
+		/// 在后台线程中把已录制的midi保存到文件
+		/// </summary>
+		/// <param name="virInst">如果为null,将保存所有乐器</param>
+		/// <param name="saveFilePath">保存路径</param>
+		void SaveRecordMidiFile(VirInstrument* virInst, string saveFilePath);
+
 		// 请求帧渲染事件     
 		void ReqFrameRender();
 
@@ -419,12 +641,37 @@ namespace ventrue
 		// 处理播放midi文件事件
 		void ProcessMidiEvents();
 
+		// 处理midi字节流输入的消息
+		void ProcessMidiInputEvents();
+
+		// 处理一个midi字节流输入的消息
+		void ProcessMidiInputEvent(MidiInputEvent& ev);
+
+		// 获取midi字节流输入通道对应的设备通道(不存在时创建)
+		Channel* GetMidiInputChannel(int channelNum);
+
+		// 复位midi字节流输入创建的设备通道
+		void ResetMidiInputChannel(Channel* channel);
+
 		//清除通道buffer
 		void ClearChannelBuffer();
 
 		//混合所有乐器中的样本到声道buffer中
 		void MixVirInstsSamplesToChannelBuffer();
 
+		//按乐器发送量累加到发送总线
+		void SendVirInstSamplesToBus(VirInstrument& virInst);
+
+		//处理发送总线效果器，并混合到声道buffer中
+		void MixEffectSendBusToChannelBuffer();
+
+		//处理一个发送总线
+		//返回总线是否还有尾音
+		bool ProcessEffectSendBus(VentrueEffect* bus, float* sendLeft, float* sendRight, bool isActive, bool isTail);
+
+		//按帧样本数量分配发送总线采样点
+		void AllocEffectSendSamples();
+
 		// 渲染虚拟乐器区域发声     
 		void RenderVirInstRegionSound();
 
@@ -457,6 +704,12 @@ namespace ventrue
 
 		//
 		static void _FrameRender(Task* ev);
+		static void _AddSharedSoundFont(Task* ev);
+		static void _LoadSwapSoundFont(Task* ev);
+		static void _SwapSoundFont(Task* ev);
+		static void _ReclaimSoundFonts(Task* ev);
+		static void _GetMidiUsedPresetKeys(Task* ev);
+		static void _FindPresets(Task* ev);
 
 		static bool SounderCountCompare(VirInstrument* a, VirInstrument* b);
 
@@ -469,6 +722,11 @@ namespace ventrue
 		//发声结束的虚拟乐器回调
 		SoundEndVirInstCallBack soundEndVirInstCallBack = nullptr;
 
+		//渐进加载音源时，预设样本加载完成的回调
+		PresetReadyCallBack presetReadyCallBack = nullptr;
+		//预设样本加载完成回调附带数据
+		void* presetReadyCallBackData = nullptr;
+
 	private:
 
 		VentrueCmd* cmd = nullptr;
@@ -489,6 +747,19 @@ namespace ventrue
 		//效果器
 		EffectList* effects;
 
+		//是否使用全局混音和声发送总线
+		bool isUseEffectSendBus = false;
+		//全局混音总线
+		EffectFreeVerb* reverbBus = nullptr;
+		//全局和声总线
+		EffectChorus* chorusBus = nullptr;
+		//发送总线当前帧是否有输入
+		bool isReverbBusActive = false;
+		bool isChorusBusActive = false;
+		//发送总线是否还有尾音
+		bool isReverbBusTail = false;
+		bool isChorusBusTail = false;
+
 		// 使用单音模式  
 		bool useMonoMode = false;
 
@@ -515,12 +786,48 @@ namespace ventrue
 		//轨道通道合并模式
 		TrackChannelMergeMode mergeMode = TrackChannelMergeMode::AutoMerge;
 
+		//载入midi后是否释放事件对象
+		bool isReleaseMidiEventObjects = false;
+
+		//载入midi后是否预编译播放时间线
+		bool isUseMidiTimeline = false;
+
+		//是否以流式方式载入midi
+		bool isMidiStreaming = false;
+
+		//载入midi后裁剪音符的规则
+		MidiNoteCullOptions midiNoteCullOptions;
+
 		//
 		SampleList* sampleList = nullptr;
+		SampleStore* sampleStore = nullptr;
+		SampleStreamer* sampleStreamer = nullptr;
+		MidiRecorder* midiRecorder = nullptr;
+		MidiInput* midiInput = nullptr;
+		//由midi字节流输入创建的设备通道(按通道号位标记)
+		uint16_t midiInputChannelMask = 0;
+		//样本整理后pcm数据所在的连续内存
+		vector<float*>* sampleArenas = nullptr;
+		bool isSampleStreaming = false;
+		uint32_t sampleStreamPreloadFrames = 32768;
 		InstrumentList* instList = nullptr;
 		PresetList* presetList = nullptr;
 		PresetMap* presetBankDict = nullptr;
 
+		//使用的共享音源
+		vector<SoundFont*>* sharedSoundFonts = nullptr;
+
+		//切换音源(只在渲染线程中读写)
+		SoundFont* swapSoundFont = nullptr;
+		//已被替换，等待发声结束后释放的音源(只在音源加载线程中读写)
+		vector<SoundFont*>* retiredSoundFonts = nullptr;
+		bool isReclaimPosted = false;
+
+		//预设样本尚未加载完成时的按键处理方式
+		PresetNotReadyPolicy presetNotReadyPolicy = PresetNotReadyPolicy::Defer;
+		//是否停止后台样本加载
+		atomic_bool isStopSoundFontLoad;
+
 		//预设乐器替换
 		unordered_map<uint32_t, uint32_t>* presetBankReplaceMap = nullptr;
 
@@ -533,6 +840,14 @@ namespace ventrue
 		float leftChannelFrameBuf[4096 * 10] = { 0 };
 		float rightChannelFrameBuf[4096 * 10] = { 0 };
 
+		//混音总线发送采样点(按帧样本数量分配)
+		float* reverbSendLeftSamples = nullptr;
+		float* reverbSendRightSamples = nullptr;
+
+		//和声总线发送采样点(按帧样本数量分配)
+		float* chorusSendLeftSamples = nullptr;
+		float* chorusSendRightSamples = nullptr;
+
 		//目前渲染子帧位置
 		uint32_t childFramePos = 0;
 
@@ -552,6 +867,8 @@ namespace ventrue
 
 		TaskProcesser* taskProcesser = nullptr;
 		TaskProcesser* realtimeKeyOpTaskProcesser = nullptr;
+		//音源加载任务处理器
+		TaskProcesser* soundFontTaskProcesser = nullptr;
 		RegionSounderThread* regionSounderThreadPool = nullptr;
 
 
@@ -597,7 +914,7 @@ namespace ventrue
 		float sec = 0;
 
 		//当前采样点个数
-		int curtSampleCount = 0;
+		int64_t curtSampleCount = 0;
 
 
 		//音源解析格式
@@ -635,6 +952,7 @@ namespace ventrue
 		friend class MidiPlay;
 		friend class RegionSounderThread;
 		friend class KeySounder;
+		friend class SoundFontRepository;
 	};
 }
 
@@ -1,4 +1,6 @@
 ﻿#include"VentrueCmd.h"
+#include"MidiRecorder.h"
+#include"MidiTrackRecord.h"
 
 namespace ventrue
 {
@@ -642,21 +644,56 @@ namespace ventrue
 	/// <param name="tickForQuarterNote">一个四分音符发音的tick数</param>
 	void VentrueCmd::RecordMidi(VirInstrument* virInst, float bpm, float tickForQuarterNote)
 	{
+		//后台线程、环形缓存和录制轨道都在调用线程中准备，渲染线程中只交换指针
+		ventrue->GetMidiRecorder()->Start();
+
+		vector<MidiRecordStartData> startDatas;
+		Semaphore waitSem;
 		VentrueEvent* ev = VentrueEvent::New();
 		ev->ventrue = ventrue;
+		ev->virInst = virInst;
+		ev->ptr = &startDatas;
+		ev->sem = &waitSem;
+		ev->processCallBack = _GetRecordMidiStartDatas;
+		ventrue->PostTask(ev);
+		waitSem.wait();
+
+		for (int i = 0; i < startDatas.size(); i++)
+			MidiTrackRecord::NewStartData(startDatas[i]);
+
+		//
+		ev = VentrueEvent::New();
+		ev->ventrue = ventrue;
 		ev->evType = VentrueEventType::RecordMidi;
 		ev->virInst = virInst;
 		ev->bpm = bpm;
 		ev->tickForQuarterNote = tickForQuarterNote;
+		ev->ptr = &startDatas;
+		ev->sem = &waitSem;
 		ev->processCallBack = _RecordMidi;
 		ventrue->PostTask(ev);
+		waitSem.wait();
+
+		//释放未使用的和被替换下来的资源
+		for (int i = 0; i < startDatas.size(); i++)
+			MidiTrackRecord::DelStartData(startDatas[i]);
+	}
+
+	void VentrueCmd::_GetRecordMidiStartDatas(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+		ventrue.GetRecordMidiStartDatas(ventrueEvent->virInst, *(vector<MidiRecordStartData>*)ventrueEvent->ptr);
+		ventrueEvent->sem->set();
 	}
 
 	void VentrueCmd::_RecordMidi(Task* ev)
 	{
 		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
 		Ventrue& ventrue = *(ventrueEvent->ventrue);
-		ventrue.RecordMidi(ventrueEvent->virInst, ventrueEvent->bpm, ventrueEvent->tickForQuarterNote);
+		ventrue.RecordMidi(ventrueEvent->virInst, ventrueEvent->bpm, ventrueEvent->tickForQuarterNote,
+			(vector<MidiRecordStartData>*)ventrueEvent->ptr);
+		ventrueEvent->sem->set();
 	}
 
 	/// <summary>
@@ -763,4 +800,27 @@ namespace ventrue
 		ventrue.SaveMidiFileToDisk(ventrueEvent->midiFile, ventrueEvent->midiFilePath);
 	}
 
+	/// <summary>
+	/// 在后台线程中把已录制的midi保存到文件
+	/// </summary>
+	/// <param name="saveFilePath">保存路径</param>
+	/// <param name="virInst">如果为null,将保存所有乐器</param>
+	void VentrueCmd::SaveRecordMidiFile(string saveFilePath, VirInstrument* virInst)
+	{
+		VentrueEvent* ev = VentrueEvent::New();
+		ev->ventrue = ventrue;
+		ev->evType = VentrueEventType::SaveRecordMidiFile;
+		ev->virInst = virInst;
+		ev->midiFilePath = saveFilePath;
+		ev->processCallBack = _SaveRecordMidiFile;
+		ventrue->PostTask(ev);
+	}
+
+	void VentrueCmd::_SaveRecordMidiFile(Task* ev)
+	{
+		VentrueEvent* ventrueEvent = (VentrueEvent*)ev;
+		Ventrue& ventrue = *(ventrueEvent->ventrue);
+		ventrue.SaveRecordMidiFile(ventrueEvent->virInst, ventrueEvent->midiFilePath);
+	}
+
 }
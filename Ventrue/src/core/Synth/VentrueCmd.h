@@ -184,6 +184,13 @@ namespace ventrue
 		//保存midiFile到文件
 		void SaveMidiFileToDisk(MidiFile* midiFile, string saveFilePath);
 
+		/// <summary>
+		/// 在后台线程中把已录制的midi保存到文件
+		/// </summary>
+		/// <param name="saveFilePath">保存路径</param>
+		/// <param name="virInst">如果为null,将保存所有乐器</param>
+		void SaveRecordMidiFile(string saveFilePath, VirInstrument* virInst = nullptr);
+
 	private:
 		/// <summary>
 		/// 删除乐器
@@ -216,10 +223,12 @@ namespace ventrue
 		static void _OnInstrument(Task* ev);
 		static void _OffInstrument(Task* ev);
 		static void _TakeVirInstrumentList(Task* ev);
+		static void _GetRecordMidiStartDatas(Task* ev);
 		static void _RecordMidi(Task* ev);
 		static void _StopRecordMidi(Task* ev);
 		static void _CreateRecordMidiFileObject(Task* ev);
 		static void _SaveMidiFileToDisk(Task* ev);
+		static void _SaveRecordMidiFile(Task* ev);
 
 	private:
 		Ventrue* ventrue = nullptr;
@@ -25,6 +25,7 @@ namespace ventrue
 		StopRecordMidi,
 		CreateRecordMidiFileObject,
 		SaveMidiFileToDisk,
+		SaveRecordMidiFile,
 	};
 
 	class VentrueEvent : public Task
@@ -57,6 +58,8 @@ namespace ventrue
 		float bpm = 0;
 		float tickForQuarterNote = 0;
 		string text;
+		string sfFormatName;
+		string sfPath;
 		float exValue[10] = { 0 };
 		void* exPtr[10] = { nullptr };
 		Semaphore* sem = nullptr;
@@ -30,6 +30,14 @@ namespace ventrue
 	class ModInputInfo;
 	class Modulator;
 	class Sample;
+	class SampleStore;
+	class SampleStreamer;
+	class SampleStreamBuffer;
+	class MidiTrackRecord;
+	class MidiRecorder;
+	class MidiInput;
+	class SoundFont;
+	class SoundFontRepository;
 	class RegionSounder;
 	class Envelope;
 	class KeySounder;
@@ -52,6 +60,8 @@ namespace ventrue
 	struct InstLinkToPresetRegionInfo;
 	struct LineEquationInfo;
 	struct RealtimeKeyEvent;
+	struct MidiInputEvent;
+	struct MidiRecordStartData;
 
 
 	using SampleList = vector<Sample*>;
@@ -89,6 +99,7 @@ namespace ventrue
 	using ModTransformCallBack = float (*)(float value);
 	using RenderTimeCallBack = void (*)(float sec, void* data);
 	using SoundEndVirInstCallBack = void (*)(Ventrue* ventrue, VirInstrument** virInst, int size);
+	using PresetReadyCallBack = void (*)(Ventrue* ventrue, Preset* preset, void* data);
 	using VirInstStateChangedCallBack = void (*)(VirInstrument* virInst);
 
 #ifdef _WIN32
@@ -140,6 +151,15 @@ namespace ventrue
 		SuperHigh,
 	};
 
+	//预设样本尚未加载完成时的按键处理方式
+	enum class PresetNotReadyPolicy
+	{
+		//推迟到样本加载完成后发声(加载完成前已松开的按键不再发声)
+		Defer,
+		//丢弃按键
+		Drop
+	};
+
 	//声道输出模式
 	enum class ChannelOutputMode
 	{
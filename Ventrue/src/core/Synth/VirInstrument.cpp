@@ -4,6 +4,12 @@
 #include"Ventrue.h"
 #include"Channel.h"
 #include"Preset.h"
+#include"Instrument.h"
+#include"Region.h"
+#include"Sample.h"
+#include"SampleStore.h"
+#include"MidiRecorder.h"
+#include"SoundFont.h"
 #include"Track.h"
 #include <random>
 #include"VentrueCmd.h"
@@ -15,7 +21,7 @@ namespace ventrue
 	{
 		this->ventrue = ventrue;
 		this->channel = channel;
-		this->preset = preset;
+		SetPreset(preset);
 		keySounders = new KeySounderList;
 		onKeySounders = new vector<KeySounder*>;
 		onkeyEventMap = new unordered_map<int, list<KeyEvent>>();
@@ -34,14 +40,17 @@ namespace ventrue
 		}
 
 		//
-		midiTrackRecord = new MidiTrackRecord();
+		midiTrackRecord = new MidiTrackRecord(ventrue);
 		channel->SetMidiRecord(midiTrackRecord);
 	}
 
 	VirInstrument::~VirInstrument()
 	{
 		DEL(effects);
-		DEL(midiTrackRecord);
+
+		//录制由MidiRecorder后台线程释放，渲染线程中不加锁等待
+		ventrue->GetMidiRecorder()->Unregister(midiTrackRecord);
+		midiTrackRecord = nullptr;
 
 		if (!FindKeySounderFromKeySounders(lastKeySounder))
 			DEL(lastKeySounder);
@@ -54,7 +63,23 @@ namespace ventrue
 		DEL(stateOps);
 
 		channel = nullptr;
-		preset = nullptr;
+		SetPreset(nullptr);
+	}
+
+	//设置预设，并持有预设所在的音源
+	//乐器还在使用某个音源的预设时，此音源不能被释放
+	void VirInstrument::SetPreset(Preset* preset)
+	{
+		if (this->preset == preset)
+			return;
+
+		if (preset != nullptr && preset->soundFont != nullptr)
+			preset->soundFont->AddVoiceRef();
+
+		if (this->preset != nullptr && this->preset->soundFont != nullptr)
+			this->preset->soundFont->ReleaseVoiceRef();
+
+		this->preset = preset;
 	}
 
 	//打开乐器
@@ -186,16 +211,16 @@ namespace ventrue
 	/// </summary>
 	/// <param name="bpm">录制的BPM</param>
 	/// <param name="tickForQuarterNote">一个四分音符发音的tick数</param>
-	void VirInstrument::RecordMidi(float bpm, float tickForQuarterNote)
+	/// <param name="startData">预先分配的开始录制资源，可为nullptr</param>
+	void VirInstrument::RecordMidi(float bpm, float tickForQuarterNote, MidiRecordStartData* startData)
 	{
 		if (midiTrackRecord->IsRecord())
 			return;
 
-		midiTrackRecord->Stop();
-		midiTrackRecord->Clear();
+		//上一次录制的轨道在开始录制时被替换
 		midiTrackRecord->SetBPM(bpm);
 		midiTrackRecord->SetTickForQuarterNote(tickForQuarterNote);
-		midiTrackRecord->Start();
+		midiTrackRecord->Start(startData);
 
 		//
 		midiTrackRecord->RecordSetController(MidiControllerType::BankSelectMSB, channel->GetBankSelectMSB(), channel->GetChannelNum());
@@ -588,7 +613,32 @@ namespace ventrue
 	{
 		//printf("乐器%s:onKeyEventCount:%d\n", preset->name.c_str(), onkeyEventMap->size());
 
-		if (!onkeyEventMap->empty())
+		//替换音源后新音源中没有对应预设时，预设被置空，在按键时重新查找
+		if (preset == nullptr && !onkeyEventMap->empty())
+		{
+			if (channel != nullptr)
+			{
+				Preset* newPreset = ventrue->GetInstrumentPreset(channel->GetBankSelectMSB(), channel->GetBankSelectLSB(), channel->GetProgramNum());
+				if (newPreset == nullptr)
+					newPreset = ventrue->GetInstrumentPreset(0, 0, channel->GetProgramNum());
+				SetPreset(newPreset);
+			}
+
+			//仍然没有可用的预设时，丢弃这些按键
+			if (preset == nullptr)
+				onkeyEventMap->clear();
+		}
+
+		bool isPresetReady = (preset == nullptr || preset->IsReady());
+
+		//按需解码的样本尚未解码时，和预设未加载完成一样处理
+		if (isPresetReady && !RequestOnKeySamples())
+			isPresetReady = false;
+
+		if (!isPresetReady)
+			ProcessNotReadyOnKeys();
+
+		if (isPresetReady && !onkeyEventMap->empty())
 		{
 			KeySounder* keySounder;
 			for (auto iter = onkeyEventMap->begin(); iter != onkeyEventMap->end(); ++iter)
@@ -630,6 +680,85 @@ namespace ventrue
 		}
 	}
 
+	//预设样本尚未加载完成时，按处理方式推迟或丢弃按下按键事件
+	void VirInstrument::ProcessNotReadyOnKeys()
+	{
+		if (onkeyEventMap->empty())
+			return;
+
+		if (ventrue->GetPresetNotReadyPolicy() == PresetNotReadyPolicy::Drop) {
+			onkeyEventMap->clear();
+			return;
+		}
+
+		//推迟发声时，按下按键事件保留到样本加载完成，
+		//但在此之前已松开的按键不再发声
+		for (auto iter = offkeyEventMap->begin(); iter != offkeyEventMap->end(); ++iter)
+		{
+			auto onIter = onkeyEventMap->find(iter->first);
+			if (onIter == onkeyEventMap->end())
+				continue;
+
+			list<KeyEvent>& onKeyEventList = onIter->second;
+			list<KeyEvent>& offKeyEventList = iter->second;
+			while (!onKeyEventList.empty() && !offKeyEventList.empty()) {
+				onKeyEventList.pop_front();
+				offKeyEventList.pop_front();
+			}
+
+			if (onKeyEventList.empty())
+				onkeyEventMap->erase(onIter);
+		}
+	}
+
+	//检查按下按键需要的样本是否都已解码，未解码的样本请求样本存储解码
+	bool VirInstrument::RequestOnKeySamples()
+	{
+		//共享音源和切换音源的样本不按需解码，由预设是否加载完成判断
+		if (preset == nullptr || onkeyEventMap->empty() ||
+			preset->soundFont != nullptr || !ventrue->GetSampleStore()->IsOnDemand())
+			return true;
+
+		bool isReady = true;
+		InstLinkToPresetRegionInfoList* presetInfos = preset->GetPresetRegionLinkInfoList();
+		for (auto iter = onkeyEventMap->begin(); iter != onkeyEventMap->end(); ++iter)
+		{
+			list<KeyEvent>& keyEventList = iter->second;
+			for (auto it = keyEventList.begin(); it != keyEventList.end(); it++)
+			{
+				int key = it->key;
+				float velocity = it->velocity;
+
+				for (int i = 0; i < presetInfos->size(); i++)
+				{
+					RangeFloat keyRange = (*presetInfos)[i].region->GetKeyRange();
+					RangeFloat velRange = (*presetInfos)[i].region->GetVelRange();
+					if (key < keyRange.min || key > keyRange.max ||
+						velocity < velRange.min || velocity > velRange.max)
+						continue;
+
+					SamplesLinkToInstRegionInfoList* instInfos = (*presetInfos)[i].linkInst->GetInstRegionLinkInfoList();
+					for (int j = 0; j < instInfos->size(); j++)
+					{
+						keyRange = (*instInfos)[j].region->GetKeyRange();
+						velRange = (*instInfos)[j].region->GetVelRange();
+						if (key < keyRange.min || key > keyRange.max ||
+							velocity < velRange.min || velocity > velRange.max)
+							continue;
+
+						//所有未解码的样本都需要请求解码，不提前返回
+						Sample* sample = (*instInfos)[j].linkSample;
+						SampleStore* store = (sample->store != nullptr ? sample->store : ventrue->GetSampleStore());
+						if (!store->Request(sample))
+							isReady = false;
+					}
+				}
+			}
+		}
+
+		return isReady;
+	}
+
 	void VirInstrument::PrintOnKeyInfo(int key, float velocity, bool isRealTime)
 	{
 		//
@@ -787,11 +916,15 @@ namespace ventrue
 		if (regionReverb != nullptr)
 			regionReverb->SetEnable(false);
 
+		//使用全局发送总线时，由ventrue按发送量处理
+		if (ventrue->IsUseEffectSendBus())
+			return;
+
 		if (regionReverbDepth != 0)
 		{
 			if (!regionReverb)
 			{
-				regionReverb = new EffectReverb();
+				regionReverb = new EffectFreeVerb();
 				effects->AppendEffect(regionReverb);
 			}
 
@@ -814,6 +947,10 @@ namespace ventrue
 		if (regionChorus != nullptr)
 			regionChorus->SetEnable(false);
 
+		//使用全局发送总线时，由ventrue按发送量处理
+		if (ventrue->IsUseEffectSendBus())
+			return;
+
 		if (regionChorusDepth != 0)
 		{
 			if (!regionChorus) {
@@ -832,6 +969,24 @@ namespace ventrue
 		}
 	}
 
+	//获取发送到全局混音总线的发送量
+	//按照SF2默认调制器，CC91最大增加20%的发送量
+	float VirInstrument::GetReverbSend()
+	{
+		float send = regionReverbDepth +
+			channel->GetControllerValue(MidiControllerType::Effects1DepthReverbSend) / 127.0f * 0.2f;
+		return send > 1 ? 1 : send;
+	}
+
+	//获取发送到全局和声总线的发送量
+	//按照SF2默认调制器，CC93最大增加20%的发送量
+	float VirInstrument::GetChorusSend()
+	{
+		float send = regionChorusDepth +
+			channel->GetControllerValue(MidiControllerType::Effects3DepthChorusSend) / 127.0f * 0.2f;
+		return send > 1 ? 1 : send;
+	}
+
 	//合并区域已处理发音样本
 	void VirInstrument::CombineRegionSounderSamples(RegionSounder* regionSounder)
 	{
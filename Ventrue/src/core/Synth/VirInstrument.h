@@ -220,10 +220,8 @@ namespace ventrue
 		void ApplyEffectsToChannelBuffer();
 
 
-		inline void SetPreset(Preset* preset)
-		{
-			this->preset = preset;
-		}
+		//设置预设，并持有预设所在的音源
+		void SetPreset(Preset* preset);
 
 		//设置滑音过渡时间
 		inline void SetPortaTime(float tm)
@@ -262,6 +260,12 @@ namespace ventrue
 		//设置和声深度
 		void SetRegionChorusDepth(float value);
 
+		//获取发送到全局混音总线的发送量(区域发送生成器加上CC91)
+		float GetReverbSend();
+
+		//获取发送到全局和声总线的发送量(区域发送生成器加上CC93)
+		float GetChorusSend();
+
 
 		//按键
 		void OnKey(int key, float velocity, int tickCount = 0, bool isRealTime = true);
@@ -295,7 +299,8 @@ namespace ventrue
 		/// </summary>
 		/// <param name="bpm">录制的BPM</param>
 		/// <param name="tickForQuarterNote">一个四分音符发音的tick数</param>
-		void RecordMidi(float bpm, float tickForQuarterNote);
+		/// <param name="startData">预先分配的开始录制资源，可为nullptr</param>
+		void RecordMidi(float bpm, float tickForQuarterNote, MidiRecordStartData* startData = nullptr);
 
 		//停止录制midi
 		void StopRecordMidi();
@@ -303,12 +308,24 @@ namespace ventrue
 		// 获取录制的midi轨道
 		MidiTrack* TakeMidiTrack(float baseTickForQuarterNote);
 
+		// 获取midi录制
+		inline MidiTrackRecord* GetMidiTrackRecord()
+		{
+			return midiTrackRecord;
+		}
+
 		//合并区域已处理发音样本
 		void CombineRegionSounderSamples(RegionSounder* regionSounder);
 
 		//生成发声keySounders
 		void CreateKeySounders();
 
+		//预设样本尚未加载完成时，按处理方式推迟或丢弃按下按键事件
+		void ProcessNotReadyOnKeys();
+
+		//检查按下按键需要的样本是否都已解码，未解码的样本请求样本存储解码
+		bool RequestOnKeySamples();
+
 		//为渲染准备所有正在发声的区域
 		int CreateRegionSounderForRender(RegionSounder** totalRegionSounder, int startSaveIdx);
 
@@ -348,7 +365,7 @@ namespace ventrue
 		// 是否激活了区域混音处理
 		bool isActiveRegionReverb = false;
 		// 区域混音处理
-		EffectReverb* regionReverb = nullptr;
+		EffectFreeVerb* regionReverb = nullptr;
 
 		//区域和声深度
 		float regionChorusDepth = 0;
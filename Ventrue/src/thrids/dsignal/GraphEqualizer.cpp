@@ -16,29 +16,26 @@ namespace dsignal
 
 
 		bandCount = 10;
-		double coeff[6];
-		int j = 0;
-
 		for (int i = 0; i < bandCount; i++)
 		{
 			freqBandEQInfo[i].centerFreq = info[i * 2];
 			freqBandEQInfo[i].bandWidth = info[i * 2 + 1];
 			freqBandEQInfo[i].gainDB = 0;
-
-			//
-			freqBandBiquad[i].setup(sampleRate, info[i * 2], 0, info[i * 2 + 1]);
-
-			j = 0;
-			coeff[j++] = freqBandBiquad[i].getB0();
-			coeff[j++] = freqBandBiquad[i].getB1();
-			coeff[j++] = freqBandBiquad[i].getB2();
-			coeff[j++] = freqBandBiquad[i].getA0();
-			coeff[j++] = freqBandBiquad[i].getA1();
-			coeff[j++] = freqBandBiquad[i].getA2();
-			bandFilter[i].SetCoefficient(coeff, 6);
+			SetupBand(i);
 		}
 	}
 
+	//设置采样率，并重新计算所有频带的系数
+	void GraphEqualizer::SetSampleRate(float sampleRate)
+	{
+		if (this->sampleRate == sampleRate)
+			return;
+
+		this->sampleRate = sampleRate;
+		for (int i = 0; i < bandCount; i++)
+			SetupBand(i);
+	}
+
 	vector<dsignal::Filter*> GraphEqualizer::GetFilters()
 	{
 		vector<dsignal::Filter*> filters;
@@ -60,22 +57,33 @@ namespace dsignal
 			return;
 
 		freqBandEQInfo[bandIdx].gainDB = gainDB;
+		SetupBand(bandIdx);
+	}
 
+	//计算频带的滤波器系数
+	void GraphEqualizer::SetupBand(int bandIdx)
+	{
 		freqBandBiquad[bandIdx].setup(
 			sampleRate,
 			freqBandEQInfo[bandIdx].centerFreq,
 			freqBandEQInfo[bandIdx].gainDB,
 			freqBandEQInfo[bandIdx].bandWidth);
 
-		int j = 0;
 		double coeff[6];
+		GetBandCoefficient(bandIdx, coeff);
+		bandFilter[bandIdx].SetCoefficient(coeff, 6);
+	}
+
+	//获取频带的双二阶滤波器系数: b0, b1, b2, a0, a1, a2
+	void GraphEqualizer::GetBandCoefficient(int bandIdx, double coeff[6])
+	{
+		int j = 0;
 		coeff[j++] = freqBandBiquad[bandIdx].getB0();
 		coeff[j++] = freqBandBiquad[bandIdx].getB1();
 		coeff[j++] = freqBandBiquad[bandIdx].getB2();
 		coeff[j++] = freqBandBiquad[bandIdx].getA0();
 		coeff[j++] = freqBandBiquad[bandIdx].getA1();
 		coeff[j++] = freqBandBiquad[bandIdx].getA2();
-		bandFilter[bandIdx].SetCoefficient(coeff, 6);
 	}
 
 
@@ -27,17 +27,34 @@ namespace dsignal
 	public:
 		GraphEqualizer();
 
-		void SetSampleRate(float sampleRate)
+		//设置采样率，并重新计算所有频带的系数
+		void SetSampleRate(float sampleRate);
+
+		void SetFreqBandGain(int bandIdx, float gainDB);
+
+		//获取频带数量
+		int GetBandCount()
 		{
-			this->sampleRate = sampleRate;
+			return bandCount;
 		}
 
-		void SetFreqBandGain(int bandIdx, float gainDB);
+		//获取频带增益(单位:db)
+		float GetFreqBandGain(int bandIdx)
+		{
+			return freqBandEQInfo[bandIdx].gainDB;
+		}
+
+		//获取频带的双二阶滤波器系数: b0, b1, b2, a0, a1, a2
+		void GetBandCoefficient(int bandIdx, double coeff[6]);
 
 		vector<dsignal::Filter*> GetFilters();
 
 		double Filtering(double input);
 
+	private:
+		//计算频带的滤波器系数
+		void SetupBand(int bandIdx);
+
 	private:
 		float sampleRate = 44100;
 		int bandCount = 10;
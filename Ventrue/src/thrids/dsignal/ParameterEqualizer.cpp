@@ -65,11 +65,33 @@ namespace dsignal
 
 	void ParameterEqualizer::Enable(int filterIdx, bool isEnable)
 	{
-		if (biquad[filterIdx].IsEnable() == isEnable)
+		if (filterIdx < 0 || filterIdx >= GetFilterCount() ||
+			biquad[filterIdx].IsEnable() == isEnable)
 			return;
 
 		biquad[filterIdx].SetEnable(isEnable);
 	}
 
+	//设置采样率，并重新计算所有滤波器的系数
+	void ParameterEqualizer::SetSampleRate(float sampleRate)
+	{
+		this->sampleRate = sampleRate;
+		for (int i = 0; i < GetFilterCount(); i++)
+		{
+			biquad[i].fs = sampleRate;
+			biquad[i].CalculateCoefficients();
+		}
+	}
 
+	//设置滤波器参数
+	void ParameterEqualizer::SetFilter(int filterIdx, float freq, float q, float gainDB)
+	{
+		if (filterIdx < 0 || filterIdx >= GetFilterCount())
+			return;
+
+		biquad[filterIdx].f0 = freq;
+		biquad[filterIdx].Q = q;
+		biquad[filterIdx].gainDB = gainDB;
+		biquad[filterIdx].CalculateCoefficients();
+	}
 }
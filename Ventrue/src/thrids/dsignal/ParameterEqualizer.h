@@ -7,6 +7,7 @@ namespace dsignal
 {
 	/**
 	* 参数均衡器
+	* 滤波器: 0:高通, 1:低架, 2-6:尖峰, 7:高架, 8:低通
 	*/
 	class ParameterEqualizer
 	{
@@ -14,6 +15,28 @@ namespace dsignal
 		ParameterEqualizer();
 		void Enable(int filterIdx, bool isEnable);
 
+		bool IsEnable(int filterIdx)
+		{
+			return biquad[filterIdx].IsEnable();
+		}
+
+		//设置采样率，并重新计算所有滤波器的系数
+		void SetSampleRate(float sampleRate);
+
+		//设置滤波器参数
+		//freq:频率(单位:HZ), q:Q值, gainDB:增益(单位:db，仅用于尖峰和架型滤波器)
+		void SetFilter(int filterIdx, float freq, float q, float gainDB);
+
+		int GetFilterCount()
+		{
+			return 9;
+		}
+
+		CascadeBiquad* GetFilter(int filterIdx)
+		{
+			return &biquad[filterIdx];
+		}
+
 	private:
 		void Init();
 
@@ -185,6 +185,17 @@ namespace dsignal
 		SetDenCoefficient(den, 3);
 	}
 
+	//获取分子分母系数: b0, b1, b2, a0, a1, a2
+	void RBJBiquad::GetNumAndDenCoefficient(double coeff[6])
+	{
+		coeff[0] = b0;
+		coeff[1] = b1;
+		coeff[2] = b2;
+		coeff[3] = a0;
+		coeff[4] = a1;
+		coeff[5] = a2;
+	}
+
 	void RBJBiquad::Filtering(float* inputs, uint32_t size)
 	{
 		if (!IsEnable())
@@ -60,6 +60,8 @@ namespace dsignal
 		virtual void CalculateCoefficients();
 		//直接设置分子分母系数
 		void SetNumAndDenCoefficient(double b0, double b1, double b2, double a0, double a1, double a2);
+		//获取分子分母系数: b0, b1, b2, a0, a1, a2
+		void GetNumAndDenCoefficient(double coeff[6]);
 		virtual void Filtering(float* inputs, uint32_t size);
 		virtual double Filtering(double input);
 
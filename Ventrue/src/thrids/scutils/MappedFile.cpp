@@ -0,0 +1,103 @@
+﻿#include"MappedFile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace scutils
+{
+	MappedFile::MappedFile()
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	//以只读方式映射文件
+	//映射完成后即关闭文件句柄(映射视图保持有效)，避免大量映射文件占用句柄
+	bool MappedFile::Open(const string& path)
+	{
+		Close();
+
+		HANDLE fileHandle = CreateFileA(
+			path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+			CloseHandle(fileHandle);
+			return false;
+		}
+
+		HANDLE mapHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(fileHandle);
+		if (mapHandle == nullptr)
+			return false;
+
+		data = (uint8_t*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapHandle);
+		if (data == nullptr)
+			return false;
+
+		size = (size_t)fileSize.QuadPart;
+		return true;
+	}
+
+	//解除映射
+	void MappedFile::Close()
+	{
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+
+		data = nullptr;
+		size = 0;
+	}
+
+#else
+
+	//以只读方式映射文件
+	//映射完成后即关闭文件描述符(映射保持有效)，避免大量映射文件超出进程的描述符上限
+	bool MappedFile::Open(const string& path)
+	{
+		Close();
+
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return false;
+		}
+
+		void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (ptr == MAP_FAILED)
+			return false;
+
+		data = (uint8_t*)ptr;
+		size = (size_t)st.st_size;
+		return true;
+	}
+
+	//解除映射
+	void MappedFile::Close()
+	{
+		if (data != nullptr)
+			munmap(data, size);
+
+		data = nullptr;
+		size = 0;
+	}
+#endif
+}
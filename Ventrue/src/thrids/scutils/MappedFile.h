@@ -0,0 +1,46 @@
+﻿#ifndef _MappedFile_h_
+#define _MappedFile_h_
+
+#include"Utils.h"
+
+namespace scutils
+{
+	/*
+	* 只读内存映射文件
+	* 映射完成后不再持有文件句柄
+	* by cymheart, 2020--2021.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		//以只读方式映射文件
+		bool Open(const string& path);
+
+		//解除映射
+		void Close();
+
+		inline bool IsOpen()
+		{
+			return data != nullptr;
+		}
+
+		inline const uint8_t* GetData()
+		{
+			return data;
+		}
+
+		inline size_t GetSize()
+		{
+			return size;
+		}
+
+	private:
+		uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+}
+
+#endif
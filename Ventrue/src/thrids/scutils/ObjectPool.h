@@ -88,6 +88,15 @@ namespace scutils
 			createCount = count;
 		}
 
+		//预先创建对象，使池中至少有count个空闲对象
+		void Reserve(int count)
+		{
+			locker.lock();
+			if (pos + 1 < count)
+				CreatePool(count - (pos + 1));
+			locker.unlock();
+		}
+
 	private:
 		vector<T*> objList;
 		int pos = -1;
@@ -0,0 +1,50 @@
+﻿#include"ParallelJobs.h"
+
+namespace scutils
+{
+	ParallelJobs::ParallelJobs(int threadCount)
+		:nextJob(0)
+	{
+		if (threadCount <= 0)
+			threadCount = ScUtils_GetCPUCount();
+
+		this->threadCount = (threadCount < 1 ? 1 : threadCount);
+	}
+
+	ParallelJobs::~ParallelJobs()
+	{
+		Wait();
+	}
+
+	// 开始异步执行任务jobFunc(0) ... jobFunc(jobCount - 1)
+	void ParallelJobs::Start(size_t jobCount, function<void(size_t)> jobFunc)
+	{
+		Wait();
+
+		this->jobCount = jobCount;
+		this->jobFunc = jobFunc;
+		nextJob = 0;
+
+		if (jobCount == 0)
+			return;
+
+		size_t count = ((size_t)threadCount < jobCount ? (size_t)threadCount : jobCount);
+		for (size_t i = 0; i < count; i++)
+			threads.push_back(thread(&ParallelJobs::Work, this));
+	}
+
+	// 等待所有任务完成
+	void ParallelJobs::Wait()
+	{
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+		threads.clear();
+	}
+
+	void ParallelJobs::Work()
+	{
+		size_t idx;
+		while ((idx = nextJob.fetch_add(1)) < jobCount)
+			jobFunc(idx);
+	}
+}
@@ -0,0 +1,44 @@
+﻿#ifndef _ParallelJobs_h_
+#define _ParallelJobs_h_
+
+#include"Utils.h"
+
+namespace scutils
+{
+	/*
+	* 并行任务组
+	* 把jobCount个相互独立的任务分配到多个工作线程上执行,
+	* Start()后立即返回，调用线程可同时处理其它工作，最后由Wait()等待全部完成
+	* by cymheart, 2020--2021.
+	*/
+	class ParallelJobs
+	{
+	public:
+		// threadCount <= 0时，使用cpu核心数
+		ParallelJobs(int threadCount = 0);
+		~ParallelJobs();
+
+		// 开始异步执行任务jobFunc(0) ... jobFunc(jobCount - 1)
+		void Start(size_t jobCount, function<void(size_t)> jobFunc);
+
+		// 等待所有任务完成
+		void Wait();
+
+		inline int GetThreadCount()
+		{
+			return threadCount;
+		}
+
+	private:
+		void Work();
+
+	private:
+		int threadCount = 1;
+		vector<thread> threads;
+		atomic<size_t> nextJob;
+		size_t jobCount = 0;
+		function<void(size_t)> jobFunc;
+	};
+}
+
+#endif
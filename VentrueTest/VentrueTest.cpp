@@ -6,6 +6,9 @@
 #include<Synth/Ventrue.h>
 #include<Synth/VentrueCmd.h>
 #include"Synth/VirInstrument.h"
+#include"Midi/MidiFile.h"
+#include"Midi/MidiTrack.h"
+#include<chrono>
 #include <Effect\EffectCmd\EffectReverbCmd.h>
 #include <Effect\EffectCmd\EffectEqualizerCmd.h>
 #include <Effect\EffectCmd\EffectCompressorCmd.h>
@@ -92,6 +95,52 @@ void art(VentrueCmd* cmd)
 
 
 
+//轨道通道合并性能测试
+//分别以不合并,自动合并和总是合并的模式解析midi文件，与不合并模式的解析耗时的差值即为合并轨道通道的耗时
+void MergeTrackChannelsBenchmark(string midiPath)
+{
+	const char* fileNames[] = {
+		"狂妄之人2.mid",
+		"狂妄之人.mid",
+		"Overwrite remix.mid",
+		"dreamsp.mid",
+		nullptr
+	};
+
+	const int modeCount = 3;
+	TrackChannelMergeMode modes[modeCount] = { NoMerge, AutoMerge, AlwaysMerge };
+
+	for (int i = 0; fileNames[i] != nullptr; i++)
+	{
+		string filePath = midiPath + fileNames[i];
+		double costMs[modeCount];
+		size_t trackCount[modeCount];
+
+		//先解析一次预热文件缓存，避免首次读文件的耗时计入不合并模式
+		MidiFile* warmup = new MidiFile();
+		warmup->Parse(filePath);
+		delete warmup;
+
+		for (int j = 0; j < modeCount; j++)
+		{
+			MidiFile* midiFile = new MidiFile();
+			midiFile->SetTrackChannelMergeMode(modes[j]);
+
+			auto start = chrono::steady_clock::now();
+			midiFile->Parse(filePath);
+			auto end = chrono::steady_clock::now();
+
+			costMs[j] = chrono::duration<double, milli>(end - start).count();
+			trackCount[j] = midiFile->GetTrackList()->size();
+			delete midiFile;
+		}
+
+		printf("%s\n  不合并 轨道数:%zu, 解析:%.1fms\n", fileNames[i], trackCount[0], costMs[0]);
+		printf("  自动合并 轨道数:%zu, 解析:%.1fms, 合并轨道通道:%.1fms\n", trackCount[1], costMs[1], costMs[1] - costMs[0]);
+		printf("  总是合并 轨道数:%zu, 解析:%.1fms, 合并轨道通道:%.1fms\n", trackCount[2], costMs[2], costMs[2] - costMs[0]);
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	//资源根路径
@@ -101,6 +150,15 @@ int main(int argc, char* argv[])
 	//soundfont音源路径
 	string sfPath = rootPath + "\\VentrueTest\\SoundFont\\";
 
+	//以--merge-benchmark参数启动时,只运行轨道通道合并性能测试
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--merge-benchmark") == 0)
+		{
+			MergeTrackChannelsBenchmark(midiPath);
+			return 0;
+		}
+	}
 
 	//建立ventrue
 	Ventrue* ventrue = new Ventrue();